@@ -1,6 +1,7 @@
 #pragma once
 
 #include "HTTPTypes.hpp"
+#include "HTTP/routing/RouteContext.hpp"
 #include "utils/Logger.hpp"
 #include "utils/Utils.hpp"
 #include <map>
@@ -39,7 +40,13 @@ struct ParseResult {
     : success(success), statusCode(statusCode), errorMessage(errorMessage) {}
 };
 
-ParseResult parseRequest(const std::string &data, Request &request, const RequestRouter *router = nullptr);
+ParseResult parseRequest(const std::string &data, Request &request,
+                         const RequestRouter *router, RouteContext &route);
+// Everything up to the body: request line, headers, route and the declared
+// Content-Length, for requests whose body is consumed while it arrives.
+ParseResult parseRequestHead(const std::string &data, Request &request,
+                             const RequestRouter *router,
+                             RouteContext &route);
 bool parseRequestLine(std::string_view line, RequestLine &requestLine);
 bool parseHeaders(std::istringstream &stream,
                   std::map<std::string, std::string> &headers);
@@ -47,10 +54,10 @@ bool parseHeader(std::string_view line,
                  std::map<std::string, std::string> &headers);
 bool parseBody(std::string_view data, size_t bodyStart, std::string &body);
 bool parseChunkedBody(std::string_view data, size_t bodyStart,
-                     std::string &body, const std::string &uri, const RequestRouter *router);
+                     std::string &body, size_t maxBodySize);
 bool parseRequestBody(const std::string &data, size_t bodyStart,
-                     Request &request, const RequestRouter *router);
-bool parseContentLengthWithRouter(Request &request, const RequestRouter *router);
+                     Request &request, const RouteContext &route);
+bool parseContentLength(Request &request, const RouteContext &route);
 bool validateHttpRequest(const Request &request);
 
 struct MultipartFile {
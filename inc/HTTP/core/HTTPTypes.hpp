@@ -24,7 +24,10 @@ enum class StatusCode {
   PAYLOAD_TOO_LARGE = 413,
   URI_TOO_LONG = 414,
   INTERNAL_SERVER_ERROR = 500,
-  NOT_IMPLEMENTED = 501
+  NOT_IMPLEMENTED = 501,
+  BAD_GATEWAY = 502,
+  SERVICE_UNAVAILABLE = 503,
+  GATEWAY_TIMEOUT = 504
 };
 
 inline Method stringToMethod(const std::string &methodStr) {
@@ -68,6 +71,9 @@ inline std::string statusToString(StatusCode status) {
           {StatusCode::URI_TOO_LONG, "URI Too Long"},
           {StatusCode::INTERNAL_SERVER_ERROR, "Internal Server Error"},
           {StatusCode::NOT_IMPLEMENTED, "Not Implemented"},
+          {StatusCode::BAD_GATEWAY, "Bad Gateway"},
+          {StatusCode::SERVICE_UNAVAILABLE, "Service Unavailable"},
+          {StatusCode::GATEWAY_TIMEOUT, "Gateway Timeout"},
           {StatusCode::REQUEST_TIMEOUT, "Request Timeout"}};
   auto it = statusToStringMap.find(status);
   if (it != statusToStringMap.end())
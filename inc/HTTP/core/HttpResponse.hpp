@@ -1,10 +1,42 @@
 #pragma once
+#include "utils/FileBuffer.hpp"
+#include "utils/OpenFileCache.hpp"
 #include "utils/Utils.hpp"
 #include <filesystem>
 #include <map>
+#include <memory>
 #include <string>
 #include <string_view>
 
+// A response ready for the socket: the serialized header block (or the whole
+// response, for generated bodies) followed by an optional body that is shared
+// with the file cache rather than copied into the string, or by an open file
+// that is too large for the cache and goes out with sendfile(). A CGI or
+// FastCGI handler instead returns the running job, whose output becomes the
+// response once the event loop has collected it.
+class CGIOutput;
+
+struct OutgoingResponse {
+  std::string head;
+  FileBufferPtr body;
+  OpenFilePtr file;
+  std::shared_ptr<CGIOutput> cgi;
+
+  OutgoingResponse() = default;
+  OutgoingResponse(std::string data) : head(std::move(data)) {}
+  OutgoingResponse(std::string headBlock, FileBufferPtr sharedBody)
+      : head(std::move(headBlock)), body(std::move(sharedBody)) {}
+  OutgoingResponse(std::string headBlock, OpenFilePtr openFile)
+      : head(std::move(headBlock)), file(std::move(openFile)) {}
+  OutgoingResponse(std::shared_ptr<CGIOutput> process)
+      : cgi(std::move(process)) {}
+
+  size_t bodySize() const {
+    return body ? body->size() : (file ? file->size : 0);
+  }
+  size_t size() const { return head.size() + bodySize(); }
+};
+
 class HttpResponse {
 public:
   HttpResponse() = default;
@@ -15,6 +47,12 @@ public:
   const std::map<std::string, std::string> &headers() const { return _headers; }
 
   std::string str() const;
+  OutgoingResponse build() const;
+
+  // Header block without the per-response Date and Connection lines and
+  // without the terminating blank line, for storing in ResponseCache.
+  std::string cacheableHeaderBlock() const;
+  static std::string completeHeaderBlock(std::string_view cacheable);
 
   operator std::string() const { return str(); }
 
@@ -22,6 +60,7 @@ public:
   HttpResponse &header(std::string_view name, std::string_view value);
   HttpResponse &body(std::string_view content,
                      std::string_view contentType = "text/plain");
+  HttpResponse &body(FileBufferPtr content, std::string_view contentType);
 
   template <typename... Headers> HttpResponse &headers(Headers &&...headers) {
     (setHeader(std::forward<Headers>(headers)), ...);
@@ -42,10 +81,13 @@ public:
 
 private:
   static std::string formatDate();
+  std::string headerBlock() const;
+  size_t bodySize() const;
   void setHeader(const std::pair<std::string_view, std::string_view> &header);
 
   int _statusCode{200};
   std::string _statusText{"OK"};
   std::string _body;
+  FileBufferPtr _sharedBody;
   std::map<std::string, std::string> _headers;
 };
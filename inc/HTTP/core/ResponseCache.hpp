@@ -0,0 +1,54 @@
+#pragma once
+#include "HTTP/core/HTTPParser.hpp"
+#include "HTTP/core/HttpResponse.hpp"
+#include "utils/FileCache.ipp"
+#include <ctime>
+#include <string>
+
+// Fully rendered responses for hot static GETs, keyed by server, host,
+// matched location and normalized path. The location is part of the key
+// because routing runs on the raw URI: //old.html and /old.html may land in
+// different locations, and a hit must never stand in for another location's
+// redirect or method rules. A hit skips path resolution, the static handler,
+// MIME lookup and header serialization: the stored header block only gets
+// Date and Connection appended before it goes out next to the shared body.
+//
+// Entries are revalidated against the file's stamp like FileCache entries,
+// answer If-None-Match / If-Modified-Since with 304 themselves, and are
+// bypassed for Range requests.
+//
+// Bodies pinned here stay alive after FileCache evicts them, so the cache
+// is held to the file cache's budget as well: bodies over its per-entry
+// cap are not kept, and the bodies kept add up to at most its size.
+class ResponseCache {
+public:
+  struct Stats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t notModified = 0;
+    size_t invalidations = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+  };
+
+  struct Entry {
+    std::string filePath;
+    std::string headers;
+    std::string notModifiedHeaders;
+    std::string etag;
+    time_t lastModified = 0;
+    FileBufferPtr body;
+    FileCache::FileStamp stamp;
+  };
+
+  static void configure(size_t maxEntries, size_t maxBytes,
+                        size_t maxEntryBytes, size_t revalidateMs);
+  static std::string makeKey(const RouteContext &route,
+                             const HTTP::Request &request);
+  static bool lookup(const std::string &key, const HTTP::Request &request,
+                     OutgoingResponse &response);
+  static void store(const std::string &key, Entry entry);
+  static void invalidateFile(const std::string &filePath);
+  static void clear();
+  static Stats stats();
+};
@@ -12,19 +12,22 @@ using HTTP::Request;
 
 class MethodHandler {
 public:
-  static std::string handleRequest(const Request &request,
-                                   std::string_view root = "./www",
-                                   const RequestRouter *router = nullptr);
+  static OutgoingResponse handleRequest(const Request &request,
+                                        const RouteContext &route);
+  // Whether the request goes to a CGI script or FastCGI backend, which can
+  // be started before its body has arrived and fed the rest as it comes in.
+  static bool streamsBody(const Request &request, const RouteContext &route);
+  // Whether the request runs a CGI script, the work cgi_max_concurrent
+  // bounds (FastCGI backends keep their own limits).
+  static bool runsScript(const Request &request, const RouteContext &route);
 private:
-  static std::pair<std::string, std::string>
-  resolvePaths(const Request &request, std::string_view root,
-               const RequestRouter *router = nullptr);
-  static std::string handleGet(const Request &request, std::string_view root,
-                               const RequestRouter *router = nullptr);
-  static std::string handlePost(const Request &request, std::string_view root,
-                                const RequestRouter *router = nullptr);
-  static std::string handleDelete(const Request &request, std::string_view root,
-                                  const RequestRouter *router = nullptr);
-  static std::string handleFileUpload(const Request &request, const std::string &effectiveRoot,
-                                     std::string_view contentType, const RequestRouter *router);
+  static OutgoingResponse handleGet(const Request &request,
+                                    const RouteContext &route);
+  static OutgoingResponse handlePost(const Request &request,
+                                     const RouteContext &route);
+  static std::string handleDelete(const Request &request,
+                                  const RouteContext &route);
+  static std::string handleFileUpload(const Request &request,
+                                      const RouteContext &route,
+                                      std::string_view contentType);
 };
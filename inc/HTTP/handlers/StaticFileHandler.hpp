@@ -1,23 +1,24 @@
 #pragma once
+#include "HTTP/core/HTTPParser.hpp"
+#include "HTTP/core/HttpResponse.hpp"
 #include "utils/Utils.hpp"
 #include <memory>
 #include <string>
 #include <string_view>
 
-// Forward declaration
-class RequestRouter;
-
 class StaticFileHandler {
 public:
-  static std::string handleRequest(std::string_view root, std::string_view uri,
-                                   const RequestRouter *router = nullptr);
+  static OutgoingResponse handleRequest(const HTTP::Request &request,
+                                        const RouteContext &route);
 private:
-  static std::string serveFile(std::string_view filePath);
-  static std::string serveDirectory(std::string_view dirPath,
-                                    std::string_view requestUri,
-                                    const RequestRouter *router = nullptr);
+  static OutgoingResponse serveFile(std::string_view filePath,
+                                    const OpenFilePtr &target,
+                                    const HTTP::Request &request,
+                                    const RouteContext &route);
+  static OutgoingResponse serveDirectory(std::string_view dirPath,
+                                         const HTTP::Request &request,
+                                         const RouteContext &route);
   static std::string findIndexFile(std::string_view dirPath,
-                                   std::string_view requestUri,
-                                   const RequestRouter *router = nullptr);
+                                   const RouteContext &route);
   static std::string generateWelcomePage();
 };
@@ -3,6 +3,8 @@
 #include "HTTP/core/HTTPParser.hpp"
 #include "HTTP/core/HTTPTypes.hpp"
 #include "HTTP/core/HttpResponse.hpp"
+#include "HTTP/routing/RouteContext.hpp"
+#include "HTTP/routing/RouteTable.hpp"
 #include "config/LocationBlock.hpp"
 #include "config/ServerBlock.hpp"
 #include <string>
@@ -14,17 +16,15 @@ using HTTP::Request;
 class RequestRouter {
 private:
   const ServerBlock *_config;
+  RouteTable _routes;
+
+  std::string relativePath(std::string_view uri, const Route &route) const;
 
 public:
   explicit RequestRouter(const ServerBlock *config);
-  const LocationBlock *findLocation(const std::string &uri) const;
-  std::string resolveRoot(const LocationBlock *location) const;
-  bool isMethodAllowed(const Request &request,
-                       const LocationBlock *location) const;
-  bool hasRedirection(const LocationBlock *location) const;
-  std::string getRedirectionTarget(const LocationBlock *location) const;
-  std::string handleRedirection(const LocationBlock *location) const;
-  std::string getIndexFile(const LocationBlock *location) const;
-  std::string getRelativePath(const std::string &uri, const LocationBlock *location) const;
+  static const RequestRouter &fallback();
+
+  const Route *findLocation(std::string_view uri) const;
+  RouteContext resolve(std::string_view uri) const;
   const ServerBlock *getConfig() const { return _config; }
 };
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "HTTP/routing/RouteTable.hpp"
+#include <string>
+#include <string_view>
+
+// Everything routing decides about one request, resolved once right after
+// the headers are parsed and passed by reference to the parser, dispatcher
+// and handlers. The views point into the request URI and the server's route
+// table, so a context must not outlive either.
+struct RouteContext {
+  const ServerBlock *server = nullptr;
+  const Route *route = nullptr;
+  std::string_view uri;     // request path without the query string
+  std::string_view root;    // effective document root
+  std::string relativePath; // uri below the location prefix
+  std::string filePath;     // root + relativePath
+  size_t maxBodySize = 0;
+};
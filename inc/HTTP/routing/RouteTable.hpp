@@ -0,0 +1,101 @@
+#pragma once
+
+#include "HTTP/core/HTTPTypes.hpp"
+#include "config/ServerBlock.hpp"
+#include "utils/Constants.hpp"
+#include <cstdint>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// A location with everything a request needs already resolved: inherited
+// root, index and body limit, the method set as a bitmask and the parsed
+// `return` directive. Built once per server; requests only read it.
+struct Route {
+  const LocationBlock *block = nullptr; // nullptr for the default route
+  std::string path;
+  LocationMatch match = LocationMatch::Prefix;
+  std::string root;
+  std::string index;
+  std::string redirectUrl;
+  std::string uploadStore; // empty unless upload_enable is on
+  std::vector<CgiHandler> cgiHandlers; // scripts run only where listed
+  std::string fastcgiPass; // "unix:/path" or "host:port"
+  // CGI meta-variables that are the same for every request here.
+  std::vector<std::string> cgiEnvironment;
+  size_t maxBodySize = 0;
+  size_t cgiTimeoutMs = Constants::DEFAULT_CGI_TIMEOUT_MS;
+  size_t cgiMaxConcurrent = 0; // 0: only the global limit
+  size_t cgiCacheValidMs = 0;
+  int redirectCode = 0; // 0: no redirection
+  uint8_t methods = 0;
+  bool autoindex = false;
+  bool stubStatus = false;
+  bool cgiCache = false;
+
+  static uint8_t methodBit(HTTP::Method method) {
+    return static_cast<uint8_t>(1u << static_cast<unsigned>(method));
+  }
+  bool allows(HTTP::Method method) const { return methods & methodBit(method); }
+  bool hasRedirection() const { return redirectCode != 0; }
+  bool passesToFastCGI() const {
+    return !fastcgiPass.empty() && !hasRedirection();
+  }
+  // The interpreter for a file with one of the location's cgi_extension
+  // suffixes, nullptr for anything else.
+  const std::string *cgiInterpreter(std::string_view filePath) const {
+    size_t dot = filePath.find_last_of("./");
+    if (dot == std::string_view::npos || filePath[dot] != '.')
+      return nullptr;
+    std::string_view extension = filePath.substr(dot);
+    for (const CgiHandler &handler : cgiHandlers)
+      if (handler.extension == extension)
+        return &handler.interpreter;
+    return nullptr;
+  }
+  // Only prefix locations map the rest of the URI below their root; exact
+  // and regex locations resolve the whole URI.
+  bool stripsPrefix() const {
+    return match == LocationMatch::Prefix ||
+           match == LocationMatch::PreferentialPrefix;
+  }
+};
+
+// Location lookup in nginx order: exact ("=") locations through a hash map,
+// then the longest prefix from a radix trie of the prefix locations; a "^~"
+// winner ends the search, otherwise the regex locations (compiled once, here)
+// are tried in config order and the first hit beats the prefix. Matching
+// stops at the query string; a URI no location covers gets the default route.
+// Not copyable: _exact's keys and the Route pointers handed out (CGIQueue
+// keys on them) point into _routes; a move keeps its storage.
+class RouteTable {
+public:
+  RouteTable() = default;
+  explicit RouteTable(const ServerBlock *config);
+  RouteTable(const RouteTable &) = delete;
+  RouteTable &operator=(const RouteTable &) = delete;
+  RouteTable(RouteTable &&) = default;
+  RouteTable &operator=(RouteTable &&) = default;
+
+  const Route &match(std::string_view uri) const;
+
+private:
+  struct Node {
+    std::string label;
+    std::vector<size_t> children;
+    int route = -1;
+  };
+
+  const Route *longestPrefix(std::string_view uri) const;
+  void insert(std::string_view path, int route);
+  Route compile(const LocationBlock *location,
+                const ServerBlock *config) const;
+
+  std::vector<Node> _nodes;
+  std::vector<Route> _routes;
+  std::unordered_map<std::string_view, int> _exact; // keys view Route::path
+  std::vector<std::pair<std::regex, int>> _regexes;
+  Route _default;
+};
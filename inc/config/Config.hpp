@@ -6,9 +6,11 @@
 #include <unordered_map>
 #include <vector>
 
+struct GlobalBlock;
 struct LocationBlock;
 struct ServerBlock;
 
+#include "config/GlobalBlock.hpp"
 #include "config/LocationBlock.hpp"
 #include "config/ServerBlock.hpp"
 
@@ -16,19 +18,25 @@ class Config {
 private:
   std::string _fileName;
   std::unordered_map<std::string, ServerBlock> _servers;
+  GlobalBlock _global;
 
+  using GlobalDirectiveHandler = void (Config::*)(const std::string &,
+                                                  GlobalBlock &);
   using ServerDirectiveHandler = void (Config::*)(const std::string &,
                                                   ServerBlock &);
   using LocationDirectiveHandler = void (Config::*)(const std::string &,
                                                     LocationBlock &);
 
+  std::unordered_map<std::string, GlobalDirectiveHandler> _globalHandlers;
   std::unordered_map<std::string, ServerDirectiveHandler> _serverHandlers;
   std::unordered_map<std::string, LocationDirectiveHandler> _locationHandlers;
 
   void initializeHandlers();
+  void initializeGlobalHandlers();
   void initializeServerHandlers();
   void initializeLocationHandlers();
 
+  void parseGlobalDirectives(const std::string &content);
   void parseServerBlock(const std::string &content, ServerBlock &server);
   void parseLocationBlock(const std::string &content, LocationBlock &location);
 
@@ -39,8 +47,43 @@ public:
 
   const std::unordered_map<std::string, ServerBlock> &getServers() const;
   const ServerBlock *getServer(const std::string &host, int port) const;
+  const GlobalBlock &getGlobal() const;
 
 private:
+  void handleFileCacheSize(const std::string &value, GlobalBlock &global);
+  void handleFileCacheMaxEntrySize(const std::string &value,
+                                   GlobalBlock &global);
+  void handleFileCacheValid(const std::string &value, GlobalBlock &global);
+  void handleOpenFileCache(const std::string &value, GlobalBlock &global);
+  void handleOpenFileCacheValid(const std::string &value, GlobalBlock &global);
+  void handleOpenFileCacheErrors(const std::string &value,
+                                 GlobalBlock &global);
+  void handleResponseCacheEntries(const std::string &value,
+                                  GlobalBlock &global);
+  void handleNegativeCacheEntries(const std::string &value,
+                                  GlobalBlock &global);
+  void handleNegativeCacheValid(const std::string &value, GlobalBlock &global);
+  void handleWarmup(const std::string &value, GlobalBlock &global);
+  void handleWarmupBackground(const std::string &value, GlobalBlock &global);
+  void handleWarmupThreads(const std::string &value, GlobalBlock &global);
+  void handleWarmupMaxFileSize(const std::string &value, GlobalBlock &global);
+  void handleWarmupBudget(const std::string &value, GlobalBlock &global);
+  void handleLogAsync(const std::string &value, GlobalBlock &global);
+  void handleLogBuffer(const std::string &value, GlobalBlock &global);
+  void handleLogFlushInterval(const std::string &value, GlobalBlock &global);
+  void handleLogOverflow(const std::string &value, GlobalBlock &global);
+  void handleAccessLog(const std::string &value, GlobalBlock &global);
+  void handleAccessLogBuffer(const std::string &value, GlobalBlock &global);
+  void handleAccessLogFlush(const std::string &value, GlobalBlock &global);
+  void handleAccessLogSample(const std::string &value, GlobalBlock &global);
+  void handleServerTiming(const std::string &value, GlobalBlock &global);
+  void handleSlowRequestLog(const std::string &value, GlobalBlock &global);
+  void handleTraceClock(const std::string &value, GlobalBlock &global);
+  void handleCgiMaxConcurrent(const std::string &value, GlobalBlock &global);
+  void handleCgiQueueSize(const std::string &value, GlobalBlock &global);
+  void handleCgiQueueTimeout(const std::string &value, GlobalBlock &global);
+  void handleCgiCacheEntries(const std::string &value, GlobalBlock &global);
+
   void handleListen(const std::string &value, ServerBlock &server);
   void handleHost(const std::string &value, ServerBlock &server);
   void handleServerName(const std::string &value, ServerBlock &server);
@@ -53,11 +96,23 @@ private:
   void handleLocationIndex(const std::string &value, LocationBlock &location);
   void handleMethods(const std::string &value, LocationBlock &location);
   void handleAutoindex(const std::string &value, LocationBlock &location);
+  void handleStubStatus(const std::string &value, LocationBlock &location);
   void handleUploadStore(const std::string &value, LocationBlock &location);
   void handleUploadEnable(const std::string &value, LocationBlock &location);
   void handleReturn(const std::string &value, LocationBlock &location);
   void handleCgiExt(const std::string &value, LocationBlock &location);
   void handleCgiPath(const std::string &value, LocationBlock &location);
+  void handleCgiTimeout(const std::string &value, LocationBlock &location);
+  void handleCgiWorkers(const std::string &value, LocationBlock &location);
+  void handleCgiWorkerMaxRequests(const std::string &value,
+                                  LocationBlock &location);
+  void handleCgiWorkerIdleTimeout(const std::string &value,
+                                  LocationBlock &location);
+  void handleLocationCgiMaxConcurrent(const std::string &value,
+                                      LocationBlock &location);
+  void handleCgiCache(const std::string &value, LocationBlock &location);
+  void handleCgiCacheValid(const std::string &value, LocationBlock &location);
+  void handleFastCGIPass(const std::string &value, LocationBlock &location);
   void handleLocationClientMaxBodySize(const std::string &value,
                                        LocationBlock &location);
 };
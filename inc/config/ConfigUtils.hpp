@@ -1,5 +1,6 @@
 #pragma once
 
+#include "config/LocationBlock.hpp"
 #include <map>
 #include <string>
 #include <vector>
@@ -10,6 +11,8 @@ public:
 
   static std::vector<std::string>
   extractServerBlocks(const std::string &content);
+  static std::vector<std::string>
+  extractGlobalDirectives(const std::string &content);
 
   static std::pair<std::string, std::string>
   parseDirective(const std::string &line);
@@ -19,10 +22,23 @@ public:
   static bool isValidMethod(const std::string &method);
   static bool isValidServerName(const std::string &name);
   static bool isValidPath(const std::string &path);
+  // Splits "[modifier] path" from a location line.
+  static void parseLocationSpec(const std::string &spec, LocationMatch &match,
+                                std::string &path);
 
   static size_t parseSize(const std::string &value);
+  static size_t parseDuration(const std::string &value);
   static bool parseBooleanValue(const std::string &value);
   static std::pair<std::string, int>
   parseListenDirective(const std::string &value);
   static std::map<int, std::string> parseErrorPages(const std::string &value);
+  // "unix:/path" or "host:port" with a numeric IPv4 host or localhost,
+  // returned with localhost as 127.0.0.1.
+  static std::string parseFastCGIAddress(const std::string &value);
+  // Pairs cgi_extension with cgi_path, position by position or with a
+  // single path for every extension. Extensions start with a dot and
+  // interpreters must be absolute paths to executables.
+  static std::vector<CgiHandler>
+  parseCgiHandlers(const std::vector<std::string> &extensions,
+                   const std::vector<std::string> &paths);
 };
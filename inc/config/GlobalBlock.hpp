@@ -0,0 +1,63 @@
+#pragma once
+#include "utils/Constants.hpp"
+#include <cstddef>
+#include <string>
+
+// Settings declared at the top level of the config file, outside of any
+// server block. They apply to the whole process.
+struct GlobalBlock {
+  size_t fileCacheSize;
+  size_t fileCacheMaxEntrySize;
+  size_t fileCacheValidMs;
+  size_t openFileCacheEntries;
+  size_t openFileCacheValidMs;
+  bool openFileCacheErrors;
+  size_t responseCacheEntries;
+  size_t negativeCacheEntries;
+  size_t negativeCacheValidMs;
+  bool warmup;
+  bool warmupBackground;
+  size_t warmupThreads;
+  size_t warmupMaxFileSize; // 0: file_cache_max_entry_size
+  size_t warmupBudget;      // 0: file_cache_size
+  bool logAsync;
+  size_t logBufferRecords;
+  size_t logFlushIntervalMs;
+  bool logBlockWhenFull;
+  std::string accessLog; // empty: off
+  size_t accessLogBuffer;
+  size_t accessLogFlushMs;
+  size_t accessLogSample;
+  bool serverTiming;
+  size_t slowRequestMs; // 0: off
+  bool traceTsc;
+  size_t cgiMaxConcurrent; // 0: no limit
+  size_t cgiQueueSize;     // 0: turn away at once when full
+  size_t cgiQueueTimeoutMs;
+  size_t cgiCacheEntries;
+
+  GlobalBlock()
+      : fileCacheSize(Constants::DEFAULT_CACHE_BYTES),
+        fileCacheMaxEntrySize(Constants::DEFAULT_CACHE_MAX_ENTRY),
+        fileCacheValidMs(Constants::DEFAULT_CACHE_REVALIDATE_MS),
+        openFileCacheEntries(Constants::DEFAULT_OPEN_FILE_CACHE_ENTRIES),
+        openFileCacheValidMs(Constants::DEFAULT_CACHE_REVALIDATE_MS),
+        openFileCacheErrors(true),
+        responseCacheEntries(Constants::DEFAULT_RESPONSE_CACHE_ENTRIES),
+        negativeCacheEntries(Constants::DEFAULT_NEGATIVE_CACHE_ENTRIES),
+        negativeCacheValidMs(Constants::DEFAULT_NEGATIVE_CACHE_VALID_MS),
+        warmup(false), warmupBackground(false),
+        warmupThreads(Constants::DEFAULT_WARMUP_THREADS), warmupMaxFileSize(0),
+        warmupBudget(0), logAsync(false),
+        logBufferRecords(Constants::DEFAULT_LOG_BUFFER_RECORDS),
+        logFlushIntervalMs(Constants::DEFAULT_LOG_FLUSH_INTERVAL_MS),
+        logBlockWhenFull(false),
+        accessLogBuffer(Constants::DEFAULT_ACCESS_LOG_BUFFER),
+        accessLogFlushMs(Constants::DEFAULT_ACCESS_LOG_FLUSH_MS),
+        accessLogSample(1), serverTiming(false), slowRequestMs(0),
+        traceTsc(false),
+        cgiMaxConcurrent(Constants::DEFAULT_CGI_MAX_CONCURRENT),
+        cgiQueueSize(Constants::DEFAULT_CGI_QUEUE_SIZE),
+        cgiQueueTimeoutMs(Constants::DEFAULT_CGI_QUEUE_TIMEOUT_MS),
+        cgiCacheEntries(Constants::DEFAULT_CGI_CACHE_ENTRIES) {}
+};
@@ -1,9 +1,30 @@
 #pragma once
+#include "utils/Constants.hpp"
 #include <set>
 #include <string>
+#include <vector>
+
+// nginx location modifiers: none (prefix), "=" (exact), "^~" (prefix that
+// suppresses regex checks), "~" and "~*" (case-sensitive and -insensitive
+// regular expressions, tried in config order).
+enum class LocationMatch {
+  Prefix,
+  Exact,
+  PreferentialPrefix,
+  Regex,
+  RegexCaseless
+};
+
+// A script extension (".py") and the interpreter that runs it.
+struct CgiHandler {
+  std::string extension;
+  std::string interpreter; // absolute path to an executable
+};
 
 struct LocationBlock {
-  std::string path;
+  std::string path; // the pattern for regex locations
+  LocationMatch match;
+  size_t order; // position in the server block
   std::string root;
   std::string index;
   std::set<std::string> allowedMethods;
@@ -11,16 +32,37 @@ struct LocationBlock {
   std::string uploadStore;
   bool uploadEnable;
   std::string redirection;
-  std::string cgiExtension;
-  std::string cgiPath;
+  std::vector<std::string> cgiExtensions;
+  std::vector<std::string> cgiPaths; // one per extension, or one for all
+  std::vector<CgiHandler> cgiHandlers; // paired and checked at block end
+  size_t cgiTimeoutMs; // 0: the default
+  size_t cgiWorkers;   // pre-started interpreters; 0: fork per request
+  size_t cgiWorkerMaxRequests;   // 0: no limit
+  size_t cgiWorkerIdleTimeoutMs; // 0: never reaped
+  size_t cgiMaxConcurrent;       // 0: only the global limit
+  bool cgiCache;
+  size_t cgiCacheValidMs; // for responses that set no lifetime; 0: skip
+  std::string fastcgiPass; // backend address; empty: no FastCGI
   size_t clientMaxBodySize;
+  bool stubStatus; // serve the metrics page instead of files
 
   LocationBlock()
-      : autoindex(false), uploadEnable(false), clientMaxBodySize(0) {
+      : match(LocationMatch::Prefix), order(0), autoindex(false),
+        uploadEnable(false), cgiTimeoutMs(0), cgiWorkers(0),
+        cgiWorkerMaxRequests(0),
+        cgiWorkerIdleTimeoutMs(Constants::DEFAULT_CGI_WORKER_IDLE_TIMEOUT_MS),
+        cgiMaxConcurrent(0), cgiCache(false), cgiCacheValidMs(0),
+        clientMaxBodySize(0),
+        stubStatus(false) {
     allowedMethods.insert("GET");
   }
 
   bool matchesPath(const std::string &requestPath) const {
     return requestPath.find(path) == 0;
   }
+
+  bool isRegex() const {
+    return match == LocationMatch::Regex ||
+           match == LocationMatch::RegexCaseless;
+  }
 };
@@ -33,9 +33,4 @@ struct ServerBlock {
     }
     return false;
   }
-
-  const LocationBlock *getLocation(const std::string &path) const;
-
-private:
-  const LocationBlock *findBestLocationMatch(const std::string &path) const;
 };
@@ -0,0 +1,60 @@
+#pragma once
+#include "HTTP/core/HTTPParser.hpp"
+#include "HTTP/core/HttpResponse.hpp"
+#include <map>
+#include <string>
+#include <string_view>
+
+// Micro-cache for the output of CGI scripts in locations with
+// `cgi_cache on`, keyed by server, method, host, path and query string.
+// Only GET responses with status 200 are kept, for as long as the script's
+// Cache-Control max-age (s-maxage first) or Expires allows, or
+// cgi_cache_valid if it gives neither; no-store, no-cache, private,
+// Set-Cookie and Vary keep a response out. A stale entry is still served
+// for the stale-while-revalidate seconds the script allowed, while the
+// server refreshes it.
+//
+// The key holds nothing of who is asking, so requests with a Cookie never
+// use the cache, and requests with Authorization only see and store
+// responses marked public or s-maxage (RFC 9111 3.5). A request's
+// Cache-Control: no-cache is a miss that refreshes the entry.
+//
+// Concurrent misses on one key are collapsed by the server, which runs
+// the script once and has the other requests wait for the result.
+class CGICache {
+public:
+  struct Stats {
+    size_t hits = 0;
+    size_t stale = 0;  // served stale while being refreshed
+    size_t misses = 0;
+    size_t collapsed = 0; // misses that waited for another's script
+    size_t stores = 0;
+    size_t uncacheable = 0; // finished, but not allowed to be kept
+    size_t entries = 0;
+  };
+
+  enum Result { MISS, HIT, STALE };
+
+  // How a request may use the cache.
+  struct Policy {
+    bool usable = true;      // false: neither looked up nor stored
+    bool lookup = true;      // false: a miss whatever is stored
+    bool sharedOnly = false; // only public or s-maxage responses
+  };
+
+  static void configure(size_t maxEntries);
+  static bool enabled();
+  static Policy policy(const HTTP::Request &request);
+  static std::string makeKey(const RouteContext &route,
+                             const HTTP::Request &request);
+  // A hit or stale entry fills `response`, with an Age header.
+  static Result lookup(const std::string &key, OutgoingResponse &response,
+                       bool sharedOnly = false);
+  // Keeps a finished response if its headers allow; false if not.
+  static bool store(const std::string &key, int status,
+                    const std::map<std::string, std::string> &headers,
+                    std::string_view body, size_t defaultValidMs,
+                    bool sharedOnly = false);
+  static void noteCollapsed();
+  static Stats stats();
+};
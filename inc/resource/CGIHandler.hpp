@@ -1,31 +1,45 @@
 #pragma once
 #include "HTTP/core/HTTPParser.hpp"
 #include "HTTP/core/HTTPTypes.hpp"
+#include "HTTP/core/HttpResponse.hpp"
+#include <chrono>
 #include <iostream>
 #include <map>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <vector>
 
 using HTTP::Request;
 
+// Runs CGI scripts. Which files are scripts, and for which interpreter, is
+// decided per location by Route::cgiInterpreter() from the cgi_extension
+// and cgi_path table built at config load.
 class CGIHandler {
 private:
-  std::string _root_directory;
-  std::map<std::string, std::string> _cgi_handlers;
-  std::string executeScript(const std::string &script_path,
-                            const std::string &handler_path,
-                            const Request &request);
+  static OutgoingResponse executeScript(const std::string &script_path,
+                                        const std::string &handler_path,
+                                        const Request &request,
+                                        const Route &route);
 
 public:
-  CGIHandler(const std::string &root = "./www");
-  ~CGIHandler();
-  std::string executeCGI(const std::string &uri, const Request &request);
-  void registerHandler(const std::string &extension,
-                       const std::string &handlerPath);
-  bool canHandle(const std::string &filePath) const;
-  void setRootDirectory(const std::string &root);
-  std::string parseCGIOutput(const std::string &output);
+  static OutgoingResponse executeCGI(const RouteContext &route,
+                                     const Request &request,
+                                     const std::string &interpreter);
+  static std::vector<std::string>
+  requestEnvironment(const std::string &script_path, const Request &request,
+                     size_t contentLength);
+  // The whole environment: the location's fixed part, then the request's.
+  static std::vector<std::string>
+  buildEnvironment(const std::string &script_path, const Request &request,
+                   size_t contentLength, const Route &route);
+  static std::string parseCGIOutput(const std::string &output);
+  // Helpers for output that arrives in pieces: where the header block ends
+  // (npos until it is complete) and its Status and other fields.
+  static size_t findHeaderEnd(std::string_view output,
+                              size_t &separatorLength);
+  static bool parseCGIHeaders(std::string_view section, int &status,
+                              std::map<std::string, std::string> &headers);
 };
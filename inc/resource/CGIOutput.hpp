@@ -0,0 +1,153 @@
+#pragma once
+#include "HTTP/core/HttpResponse.hpp"
+#include <chrono>
+#include <map>
+#include <poll.h>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+
+// A response being produced by a CGI-style application, whether a child
+// process on pipes (CGIProcess) or a request on a FastCGI connection
+// (FastCGIRequest). The server drives it through this interface: events on
+// the descriptors it exposes, request body that arrives after the start,
+// and the output, which the subclass feeds in with receiveOutput() as it
+// comes.
+//
+// Output is either collected whole, for an application that ends before
+// its response starts, or streamed: once the header block is in,
+// beginStream() yields the response head and later body bytes are framed
+// (chunked unless the application set Content-Length) into a bounded buffer
+// the server drains to the socket. A full buffer stops reading until the
+// client catches up. Destroying an unfinished job cancels it.
+class CGIOutput {
+public:
+  CGIOutput(std::string name, std::chrono::milliseconds timeout);
+  virtual ~CGIOutput() = default;
+  CGIOutput(const CGIOutput &) = delete;
+  CGIOutput &operator=(const CGIOutput &) = delete;
+
+  // Descriptors of its own for the server to poll, -1 if there is none.
+  // Events on them go to handleEvent(), which returns false once that
+  // descriptor is done and closed.
+  virtual int stdinFd() const { return -1; }
+  virtual int stdoutFd() const { return -1; }
+  virtual int pidFd() const { return -1; }
+  virtual bool handleEvent(const struct pollfd &pfd) {
+    (void)pfd;
+    return false;
+  }
+  // Called from the server's timer; true if there is progress to pump.
+  virtual bool onTimer() { return false; }
+  // Called after the server drained output or input, for jobs whose
+  // descriptors the server does not poll itself.
+  virtual void updateFlow() {}
+
+  // Body bytes received after the start, and whether enough are buffered
+  // that the server should stop reading them from the client.
+  virtual void appendInput(const char *data, size_t size) = 0;
+  // The client stopped sending: the body ends with what was appended.
+  virtual void endInput() = 0;
+  virtual bool inputFull() const = 0;
+  virtual bool inputWaiting() const { return false; }
+
+  // No more output will come.
+  virtual bool outputEnded() const = 0;
+  // Output ended and the outcome is known.
+  virtual bool finished() const = 0;
+  virtual bool succeeded() const = 0;
+
+  bool expired(std::chrono::steady_clock::time_point now) const {
+    return now >= _deadline;
+  }
+  size_t timeoutMs() const { return static_cast<size_t>(_timeout.count()); }
+  const std::string &name() const { return _name; }
+
+  bool headerReady() const { return _headerEnd != std::string::npos; }
+  bool headerInvalid() const { return _headerInvalid; }
+
+  // The whole response once finished(); an error if the application failed
+  // or wrote no valid header block.
+  OutgoingResponse response() const;
+
+  // Starts streaming: returns the response head and moves the body read so
+  // far into the stream. Without `chunked` (HTTP/1.0 clients) a body of
+  // unknown length is delimited by closing the connection.
+  std::string beginStream(bool chunked);
+  // After finished(): ends the stream, with the last chunk only if the
+  // application succeeded so that a failure shows up as a truncated
+  // response.
+  void endStream();
+  bool streaming() const { return _streaming; }
+  bool streamDone() const { return _streamEnded && pending().empty(); }
+  int statusCode() const { return _statusCode; }
+  std::string_view pending() const {
+    return std::string_view(_stream).substr(_streamSent);
+  }
+  void consume(size_t bytes);
+  bool outputBlocked() const;
+
+  // Zero-copy path for output read raw from a pipe: once a streamed
+  // response with a Content-Length has nothing buffered left to send, the
+  // rest of its body goes from the pipe to the client socket with splice(2)
+  // instead of through the stream buffer, and stdout readiness drives
+  // spliceTo() rather than handleEvent().
+  bool splicing() const {
+    return _bodyLeft && _streaming && !_chunked && !_streamEnded &&
+           !_captureLimit && splicePipe() >= 0 && pending().empty();
+  }
+  // Moves what the pipe holds now, up to the end of the body; the bytes
+  // moved, or -1 if the socket failed. Afterwards spliceBlocked() tells
+  // whether the socket is full with output still waiting in the pipe, in
+  // which case outputBlocked() holds too.
+  ssize_t spliceTo(int socketFd);
+  bool spliceBlocked() const { return _spliceBlocked; }
+
+  // For the CGI cache: keeps a copy of a streamed body, up to `limit`
+  // bytes, and after a successful finish yields the whole body (always
+  // available if the response never streamed) and the script's headers.
+  void captureBody(size_t limit) { _captureLimit = limit; }
+  bool completeBody(std::string_view &body) const;
+  const std::map<std::string, std::string> &headers() const {
+    return _headers;
+  }
+
+protected:
+  // Output bytes in the order they arrive.
+  void receiveOutput(const char *data, size_t size);
+
+  int _status = 0;          // exit or application status, for the log
+  int _errorStatus = 500;   // sent when the application fails
+
+  // The pipe unframed output arrives on, -1 if it cannot be spliced; and
+  // the pipe's EOF reached by spliceTo(), ending the output.
+  virtual int splicePipe() const { return -1; }
+  virtual void spliceEnded() {}
+
+private:
+  void findHeader();
+  void appendBody(const char *data, size_t size);
+
+  std::string _name; // "CGI pid 42", for the log
+  std::chrono::milliseconds _timeout;
+  std::chrono::steady_clock::time_point _deadline;
+
+  std::string _output; // everything read before the response starts
+  size_t _headerEnd = std::string::npos;
+  size_t _bodyStart = 0;
+  bool _headerInvalid = false;
+  int _statusCode = 200;
+  std::map<std::string, std::string> _headers;
+
+  bool _streaming = false;
+  bool _chunked = false;
+  bool _streamEnded = false;
+  std::string _stream; // framed body bytes not yet sent
+  size_t _streamSent = 0;
+  size_t _captureLimit = 0; // 0: not capturing, or gave up past the limit
+  size_t _bodyLeft = 0; // of the Content-Length, not yet streamed or spliced
+  bool _bodySized = false;   // the streamed body has a Content-Length
+  bool _bodyOverrun = false; // ... and output past it was dropped
+  bool _spliceBlocked = false;
+  std::string _captured;
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include "resource/CGIOutput.hpp"
+#include "utils/Constants.hpp"
+#include <chrono>
+#include <string>
+#include <sys/types.h>
+
+// A CGI child driven by the event loop instead of being waited for. The
+// server polls the descriptors it exposes: the script's stdin while request
+// body is waiting to be written, its stdout until EOF, and a pidfd that
+// becomes readable when the child exits. The process is finished when its
+// output has ended and the child is reaped. Destroying an unfinished
+// process kills and reaps the child.
+//
+// The request body need not be there at the start: `inputLength` is the
+// whole body, `input` what has arrived so far, and appendInput() adds the
+// rest as the server receives it. stdin is closed once all of it has been
+// written, or as soon as the script stops reading.
+class CGIProcess : public CGIOutput {
+public:
+  CGIProcess(pid_t pid, int stdoutFd, int stdinFd, std::string input,
+             size_t inputLength, std::chrono::milliseconds timeout);
+  ~CGIProcess() override;
+
+  pid_t pid() const { return _pid; }
+  int stdinFd() const override { return _stdinFd; }
+  int stdoutFd() const override { return _stdoutFd; }
+  int pidFd() const override { return _pidFd; } // -1 without pidfd support
+  bool handleEvent(const struct pollfd &pfd) override;
+  // Without a pidfd the child is reaped from the timer.
+  bool onTimer() override;
+
+  void appendInput(const char *data, size_t size) override;
+  void endInput() override { _inputLeft = 0; }
+  // Also once the body is cut short, so that writeInput() closes stdin.
+  bool inputWaiting() const override {
+    return _stdinFd >= 0 && (_inputSent < _input.size() || _inputLeft == 0);
+  }
+  bool inputFull() const override {
+    return _input.size() - _inputSent >= Constants::CGI_STREAM_BUFFER;
+  }
+
+  bool outputEnded() const override { return _stdoutFd < 0; }
+  bool finished() const override { return _stdoutFd < 0 && _exited; }
+  bool succeeded() const override;
+
+protected:
+  int splicePipe() const override { return _stdoutFd; }
+  void spliceEnded() override;
+
+private:
+  void closeFd(int &fd);
+  bool writeInput();
+  void closeInput();
+  bool readOutput();
+  // Collects the exit status if the child has exited.
+  bool reap();
+
+  pid_t _pid;
+  int _pidFd = -1;
+  int _stdoutFd;
+  int _stdinFd;
+  std::string _input; // body bytes not yet written, from _inputSent
+  size_t _inputSent = 0;
+  size_t _inputLeft; // bytes of the body still to be written
+  bool _exited = false;
+};
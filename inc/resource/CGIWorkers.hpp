@@ -0,0 +1,113 @@
+#pragma once
+#include "config/LocationBlock.hpp"
+#include "resource/CGIOutput.hpp"
+#include "utils/Constants.hpp"
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <vector>
+
+// A pre-started interpreter that runs CGI scripts one after another. The
+// server talks to it over a socketpair in frames of a type byte and a
+// 32-bit big-endian length: 'B' starts a request (the script path, then
+// "NAME=value" environment entries, all NUL-terminated), 'I' carries
+// request body and an empty 'I' ends it; the worker answers with 'O'
+// frames of script output and an 'X' frame holding the exit status.
+struct CGIWorker {
+  pid_t pid = -1;
+  int fd = -1; // the server's end of the socketpair
+  size_t served = 0;
+  std::chrono::steady_clock::time_point idleSince;
+};
+
+struct CGIWorkerPool;
+
+// One request on a leased worker. The worker's socket is polled as its
+// stdout, and a duplicate of it as its stdin while frames are queued. When
+// the request ends cleanly the worker goes back to its pool; a request that
+// is cancelled or ends before its body was sent takes the worker with it.
+class CGIWorkerRequest : public CGIOutput {
+public:
+  CGIWorkerRequest(CGIWorkerPool &pool, CGIWorker worker, int inputFd,
+                   std::string begin, std::string_view input,
+                   size_t inputLength, std::chrono::milliseconds timeout);
+  ~CGIWorkerRequest() override;
+
+  int stdinFd() const override { return _inputFd; }
+  int stdoutFd() const override { return _ended ? -1 : _worker.fd; }
+  bool handleEvent(const struct pollfd &pfd) override;
+
+  void appendInput(const char *data, size_t size) override;
+  void endInput() override;
+  bool inputWaiting() const override {
+    return _inputFd >= 0 && _outSent < _out.size();
+  }
+  bool inputFull() const override {
+    return _out.size() - _outSent >= Constants::CGI_STREAM_BUFFER;
+  }
+
+  bool outputEnded() const override { return _ended; }
+  bool finished() const override { return _ended; }
+  bool succeeded() const override { return _ended && _status == 0; }
+
+private:
+  void queueFrame(char type, const char *data, size_t size);
+  bool writeInput();
+  void closeInput();
+  bool readOutput();
+  // Splits what the worker sent into frames; 'O' content is passed on as
+  // it arrives rather than once its frame is complete.
+  void receive(const char *data, size_t size);
+  void fail();
+
+  CGIWorkerPool &_pool;
+  CGIWorker _worker;
+  int _inputFd;     // duplicate of the socket for writing, until sent
+  std::string _out; // frames not yet written, from _outSent
+  size_t _outSent = 0;
+  size_t _inputLeft;        // body bytes still to be queued
+  bool _inputQueued = false; // the closing empty 'I' frame is queued
+  bool _inputDone = false;   // ... and written
+  std::string _in;           // header or 'X' content received so far
+  char _frameType = 0;       // of the frame being received, 0 between
+  size_t _frameLeft = 0;
+  bool _ended = false;
+  bool _usable = true; // the worker may serve another request
+};
+
+// Worker pools, one per location with cgi_workers and interpreter. A pool
+// holds up to cgi_workers interpreters; a worker is retired after
+// cgi_worker_max_requests requests (and replaced at once) or after sitting
+// idle for cgi_worker_idle_timeout (and started again on demand). Only
+// Python has a worker bootstrap; scripts for other interpreters, and
+// requests that find every worker busy, are forked as before.
+class CGIWorkers {
+public:
+  struct Stats {
+    size_t spawned = 0;
+    size_t requests = 0;
+    size_t retired = 0; // reached cgi_worker_max_requests
+    size_t reaped = 0;  // idle past cgi_worker_idle_timeout
+    size_t lost = 0;    // died, timed out or were cancelled mid-request
+  };
+
+  static bool supports(const std::string &interpreter);
+  // Starts the location's workers ahead of its first request, for each of
+  // its cgi_path interpreters with worker support.
+  static void prestart(const LocationBlock &location);
+  // nullptr if the location has no workers for the interpreter or they
+  // are all busy.
+  static std::shared_ptr<CGIOutput>
+  start(const LocationBlock *location, const std::string &interpreter,
+        const std::string &script, const std::vector<std::string> &fixedEnv,
+        const std::vector<std::string> &env, std::string_view input,
+        size_t inputLength, std::chrono::milliseconds timeout);
+  static void reapIdle(std::chrono::steady_clock::time_point now);
+  static void stop();
+  static Stats stats();
+
+  // Used by CGIWorkerRequest when it lets go of its worker.
+  static void release(CGIWorkerPool &pool, CGIWorker worker, bool usable);
+};
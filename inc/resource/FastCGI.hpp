@@ -0,0 +1,140 @@
+#pragma once
+#include "resource/CGIOutput.hpp"
+#include "server/Poller.hpp"
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class FastCGIConnection;
+class FastCGIPool;
+
+// One request on a FastCGI connection (fastcgi_pass). STDOUT records feed
+// its output; END_REQUEST or the loss of the connection finishes it. A
+// failed backend yields 502. Destroying a request that is still running
+// sends FCGI_ABORT_REQUEST.
+class FastCGIRequest : public CGIOutput {
+public:
+  FastCGIRequest(std::string name, size_t inputLength,
+                 std::chrono::milliseconds timeout, int owner);
+  ~FastCGIRequest() override;
+
+  // The server's handle for the client this request answers.
+  int owner() const { return _owner; }
+
+  void updateFlow() override;
+  void appendInput(const char *data, size_t size) override;
+  void endInput() override;
+  bool inputFull() const override;
+
+  bool outputEnded() const override { return _ended; }
+  bool finished() const override { return _ended; }
+  bool succeeded() const override { return _ended && _status == 0; }
+
+private:
+  friend class FastCGIConnection;
+
+  FastCGIConnection *_connection = nullptr; // until the request has ended
+  uint16_t _id = 0;
+  size_t _inputLeft;
+  bool _inputDone = false; // the empty STDIN record is queued
+  bool _ended = false;
+  int _owner;
+};
+
+// A kept-alive connection to one backend. Requests are multiplexed on it if
+// the backend reports FCGI_MPXS_CONNS in its reply to the FCGI_GET_VALUES
+// sent on connect; until then, and for backends such as php-fpm that do not
+// multiplex, it carries one request at a time.
+class FastCGIConnection {
+public:
+  FastCGIConnection(FastCGIPool &pool, std::string backend, int fd,
+                    bool connecting);
+  ~FastCGIConnection();
+  FastCGIConnection(const FastCGIConnection &) = delete;
+  FastCGIConnection &operator=(const FastCGIConnection &) = delete;
+
+  int fd() const { return _fd; }
+  const std::string &backend() const { return _backend; }
+  bool hasRoom() const { return _requests.size() < _maxRequests; }
+  bool idle() const { return _requests.empty(); }
+  std::chrono::steady_clock::time_point idleSince() const {
+    return _idleSince;
+  }
+  size_t queued() const { return _out.size() - _outSent; }
+
+  // Queues BEGIN_REQUEST, the parameters ("NAME=value") and the body so far;
+  // an empty STDIN record follows once the whole body has been queued.
+  void begin(FastCGIRequest &request, const std::vector<std::string> &params,
+             std::string_view input);
+  void sendInput(FastCGIRequest &request, const char *data, size_t size);
+  void abort(FastCGIRequest &request);
+
+  // Handles readiness; the owners of requests that made progress are added
+  // to `progressed`. Returns false once the connection is unusable, after
+  // failing the requests it carried.
+  bool handleEvent(short revents, std::vector<int> &progressed);
+  // Polls for writing while records are queued, and for reading unless a
+  // request's output buffer is full.
+  void updateEvents();
+
+private:
+  void appendRecord(uint8_t type, uint16_t id, const char *data,
+                    size_t size);
+  bool flush();
+  bool receive(std::vector<int> &progressed);
+  void dispatch(uint8_t type, uint16_t id, std::string_view content,
+                std::vector<int> &progressed);
+  void readValues(std::string_view content);
+  bool outputBlocked() const;
+  void fail(std::vector<int> &progressed);
+
+  FastCGIPool &_pool;
+  std::string _backend;
+  int _fd;
+  bool _connecting;
+  std::string _out; // records not yet written, from _outSent
+  size_t _outSent = 0;
+  std::string _in; // bytes of incomplete records
+  std::map<uint16_t, FastCGIRequest *> _requests; // nullptr: aborted
+  size_t _maxRequests = 1;
+  uint16_t _nextId = 1;
+  std::chrono::steady_clock::time_point _idleSince;
+};
+
+// The FastCGI connections of one server, per backend address ("unix:/path"
+// or "host:port"). A request goes to a connection with room for it, or a
+// new one; connections left idle stay open for later requests, up to
+// FASTCGI_KEEPALIVE per backend, until FASTCGI_IDLE_TIMEOUT_MS passes.
+class FastCGIPool {
+public:
+  explicit FastCGIPool(Poller *poller) : _poller(poller) {}
+  ~FastCGIPool();
+  FastCGIPool(const FastCGIPool &) = delete;
+  FastCGIPool &operator=(const FastCGIPool &) = delete;
+
+  // nullptr if no connection to the backend can be made.
+  std::shared_ptr<FastCGIRequest>
+  start(const std::string &backend, const std::vector<std::string> &params,
+        std::string_view input, size_t inputLength,
+        std::chrono::milliseconds timeout, int owner);
+
+  bool owns(int fd) const { return _connections.count(fd) != 0; }
+  // Handles readiness on one of the pool's connections and returns the
+  // owners of the requests that made progress.
+  std::vector<int> handleEvent(const struct pollfd &pfd);
+  void closeIdle(std::chrono::steady_clock::time_point now);
+
+private:
+  friend class FastCGIConnection;
+
+  FastCGIConnection *connect(const std::string &backend);
+  void close(int fd);
+  size_t idleCount(const std::string &backend) const;
+
+  Poller *_poller;
+  std::map<int, std::unique_ptr<FastCGIConnection>> _connections;
+};
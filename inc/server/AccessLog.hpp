@@ -0,0 +1,36 @@
+#pragma once
+#include "server/AccessLogFormat.hpp"
+#include <cstddef>
+#include <string>
+
+// Per-request access log in the binary format of AccessLogFormat. Records are
+// encoded into an in-memory batch that is written with a single write() once
+// it reaches the buffer size or the flush interval has passed, so a busy
+// server pays one syscall per few hundred requests. With a sample rate N,
+// only every Nth request is recorded.
+class AccessLog {
+public:
+  struct Settings {
+    std::string path;
+    size_t bufferSize = 0;
+    size_t flushIntervalMs = 0;
+    size_t sampleRate = 1;
+  };
+  struct Stats {
+    size_t records = 0;
+    size_t skipped = 0; // not sampled
+    size_t writes = 0;
+    size_t bytes = 0;
+  };
+
+  static bool open(const Settings &settings);
+  static void close();
+  static bool enabled();
+  // Counts a finished request; true if it should be recorded.
+  static bool sample();
+  static void write(const AccessLogFormat::Record &record);
+  // Writes the pending batch once the flush interval has passed.
+  static void tick();
+  static void flush();
+  static Stats stats();
+};
@@ -0,0 +1,108 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// On-disk layout of the binary access log, shared by the server and the
+// webserv-logcat decoder. A file is a sequence of blocks, each starting with
+// a type byte; integers are little-endian.
+//
+// File header ('H', 16 bytes), written every time the log is opened:
+//   0 u8 'H'   1 u8 version   2 u16 reserved   4 u32 sample rate (1 in N)
+//   8 "WSAL"  12 u32 reserved
+//
+// Request record ('R', 48 bytes followed by the request target):
+//   0 u8 'R'          1 u8 method         2 u16 status
+//   4 u16 server port 6 u16 target length 8 u64 start time (us since epoch)
+//  16 u64 bytes sent 24 u8[4] client IPv4 28 u16 client port 30 u16 reserved
+//  32 u32 parse us   36 u32 handle us    40 u32 send us      44 u32 reserved
+namespace AccessLogFormat {
+
+constexpr uint8_t VERSION = 1;
+constexpr char MAGIC[4] = {'W', 'S', 'A', 'L'};
+constexpr uint8_t HEADER_TYPE = 'H';
+constexpr uint8_t RECORD_TYPE = 'R';
+constexpr size_t HEADER_SIZE = 16;
+constexpr size_t RECORD_SIZE = 48;
+constexpr size_t MAX_TARGET = 2048;
+
+struct Record {
+  int64_t timeUs = 0;
+  uint64_t bytes = 0;
+  uint8_t clientAddr[4] = {0, 0, 0, 0};
+  uint16_t clientPort = 0;
+  uint16_t serverPort = 0;
+  uint16_t status = 0;
+  uint8_t method = 0;
+  uint32_t parseUs = 0;
+  uint32_t handleUs = 0;
+  uint32_t sendUs = 0;
+  std::string_view target;
+};
+
+template <typename T> inline void put(char *out, T value) {
+  for (size_t i = 0; i < sizeof(T); ++i)
+    out[i] = static_cast<char>(static_cast<uint64_t>(value) >> (8 * i));
+}
+
+template <typename T> inline T get(const char *in) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < sizeof(T); ++i)
+    value |= static_cast<uint64_t>(static_cast<unsigned char>(in[i]))
+             << (8 * i);
+  return static_cast<T>(value);
+}
+
+inline void appendHeader(std::string &out, uint32_t sampleRate) {
+  char block[HEADER_SIZE] = {};
+  block[0] = static_cast<char>(HEADER_TYPE);
+  block[1] = static_cast<char>(VERSION);
+  put<uint32_t>(block + 4, sampleRate);
+  std::memcpy(block + 8, MAGIC, sizeof(MAGIC));
+  out.append(block, sizeof(block));
+}
+
+inline void appendRecord(std::string &out, const Record &record) {
+  std::string_view target = record.target.substr(0, MAX_TARGET);
+  char block[RECORD_SIZE] = {};
+  block[0] = static_cast<char>(RECORD_TYPE);
+  block[1] = static_cast<char>(record.method);
+  put<uint16_t>(block + 2, record.status);
+  put<uint16_t>(block + 4, record.serverPort);
+  put<uint16_t>(block + 6, static_cast<uint16_t>(target.size()));
+  put<uint64_t>(block + 8, static_cast<uint64_t>(record.timeUs));
+  put<uint64_t>(block + 16, record.bytes);
+  std::memcpy(block + 24, record.clientAddr, 4);
+  put<uint16_t>(block + 28, record.clientPort);
+  put<uint32_t>(block + 32, record.parseUs);
+  put<uint32_t>(block + 36, record.handleUs);
+  put<uint32_t>(block + 40, record.sendUs);
+  out.append(block, sizeof(block));
+  out.append(target.data(), target.size());
+}
+
+// Decodes the record at `in` (type byte already checked). Returns the bytes
+// consumed, or 0 if `size` does not hold the whole record.
+inline size_t readRecord(const char *in, size_t size, Record &record) {
+  if (size < RECORD_SIZE)
+    return 0;
+  size_t targetLength = get<uint16_t>(in + 6);
+  if (size < RECORD_SIZE + targetLength)
+    return 0;
+  record.method = static_cast<uint8_t>(in[1]);
+  record.status = get<uint16_t>(in + 2);
+  record.serverPort = get<uint16_t>(in + 4);
+  record.timeUs = static_cast<int64_t>(get<uint64_t>(in + 8));
+  record.bytes = get<uint64_t>(in + 16);
+  std::memcpy(record.clientAddr, in + 24, 4);
+  record.clientPort = get<uint16_t>(in + 28);
+  record.parseUs = get<uint32_t>(in + 32);
+  record.handleUs = get<uint32_t>(in + 36);
+  record.sendUs = get<uint32_t>(in + 40);
+  record.target = std::string_view(in + RECORD_SIZE, targetLength);
+  return RECORD_SIZE + targetLength;
+}
+
+} // namespace AccessLogFormat
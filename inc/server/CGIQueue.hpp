@@ -0,0 +1,57 @@
+#pragma once
+#include "HTTP/routing/RouteTable.hpp"
+#include <chrono>
+#include <cstddef>
+
+class Server;
+
+// Admission control for CGI scripts. At most cgi_max_concurrent scripts
+// run in the whole process, and at most a location's own
+// cgi_max_concurrent in that location. A request over either limit waits
+// in a FIFO queue of cgi_queue_size clients; one that is still waiting
+// after cgi_queue_timeout, or finds the queue full, gets 503 with a
+// Retry-After. A waiter whose location is full does not hold up those
+// behind it for other locations.
+//
+// A slot is taken for the client, not the process: it is held from the
+// start of the script until its output has ended (or the client is gone)
+// and must be given back with release().
+class CGIQueue {
+public:
+  struct Settings {
+    size_t maxConcurrent = 0; // 0: no limit
+    size_t queueSize = 0;
+    size_t queueTimeoutMs = 0;
+  };
+
+  struct Stats {
+    size_t running = 0;
+    size_t waiting = 0;
+    size_t admitted = 0; // started at once or after waiting
+    size_t queued = 0;
+    size_t rejected = 0; // queue full
+    size_t timedOut = 0; // waited past cgi_queue_timeout
+  };
+
+  enum Admission { ADMITTED, QUEUED, REJECTED };
+
+  static void configure(const Settings &settings);
+
+  // Takes a slot for a script in `route`, or queues the client; a queued
+  // client is later handed to Server::resumeCgi() holding its slot, or to
+  // Server::shedCgi().
+  static Admission acquire(Server *server, int fd, const Route *route);
+  // A slot only if one is free now and no waiter wants it; never queues.
+  static bool tryAcquire(const Route *route);
+  static void release(const Route *route);
+  // Forgets a queued client that went away.
+  static void cancel(Server *server, int fd);
+  // Starts the waiters that fit now and turns away those that waited too
+  // long. Called from the event loop, after each round of events.
+  static void dispatch(std::chrono::steady_clock::time_point now);
+
+  // Seconds for Retry-After: by then everyone queued now has started or
+  // been turned away.
+  static size_t retryAfterSeconds();
+  static Stats stats();
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "utils/Utils.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Preloads document roots into the file cache at startup. A bounded pool of
+// threads walks the roots directory by directory and reads every file under
+// the size threshold until the memory budget is used up, computing MIME type
+// and validators along the way. Loaded files are handed to the event loop
+// thread through drain(), so the file cache itself stays single-threaded.
+class CacheWarmer {
+public:
+  struct Settings {
+    size_t threads = 1;
+    size_t maxFileSize = 0;
+    size_t budget = 0;
+  };
+
+  CacheWarmer();
+  ~CacheWarmer();
+  CacheWarmer(const CacheWarmer &) = delete;
+  CacheWarmer &operator=(const CacheWarmer &) = delete;
+
+  void start(const std::vector<std::string> &roots, const Settings &settings);
+  // Moves finished files into the cache, waiting up to `wait` for the workers
+  // to complete first. Returns false once warm-up is over.
+  bool drain(std::chrono::milliseconds wait = std::chrono::milliseconds(0));
+  void stop();
+  bool active() const { return _active; }
+
+private:
+  struct Loaded {
+    std::string path;
+    FileCache::CachedFile file;
+    int mapError = 0; // logged by drain(), not by the worker thread
+  };
+
+  void work();
+  void scanDirectory(const std::string &dir, std::vector<std::string> &subdirs,
+                     std::vector<Loaded> &loaded);
+  bool reserve(size_t bytes);
+  void finish();
+
+  Settings _settings;
+  std::vector<std::thread> _threads;
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  std::deque<std::string> _dirs;
+  size_t _pendingDirs;
+  size_t _runningThreads;
+  std::vector<Loaded> _loaded;
+  std::atomic<size_t> _reserved;
+  std::atomic<size_t> _overBudget;
+  std::atomic<bool> _stop;
+
+  bool _active;
+  size_t _files;
+  size_t _bytes;
+  std::chrono::steady_clock::time_point _startedAt;
+  std::chrono::steady_clock::time_point _lastProgress;
+};
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Process-wide request metrics. Every thread that records something gets its
+// own shard of counters and latency histograms, written without locks or
+// atomic read-modify-write instructions; the status endpoint sums the shards
+// when it is asked. Histograms are HDR-style: values in microseconds fall
+// into log-linear buckets (8 per power of two, ~12% relative error), so
+// recording is an index computation and one increment.
+class Metrics {
+public:
+  enum Counter {
+    REQUESTS,
+    RESPONSES_1XX,
+    RESPONSES_2XX,
+    RESPONSES_3XX,
+    RESPONSES_4XX,
+    RESPONSES_5XX,
+    BYTES_RECEIVED,
+    BYTES_SENT,
+    CONNECTIONS_ACCEPTED,
+    CONNECTIONS_CLOSED,
+    CGI_EXECUTIONS,
+    CGI_FAILURES,
+    COUNTER_COUNT
+  };
+
+  // CGI_QUEUE: time a CGI request waited for a slot under
+  // cgi_max_concurrent.
+  enum Phase { FIRST_BYTE, PARSE, HANDLER, SEND, CGI_QUEUE, PHASE_COUNT };
+
+  static constexpr size_t SUB_BUCKETS = 8;
+  static constexpr size_t BUCKETS = 62 * SUB_BUCKETS;
+
+  static void add(Counter counter, uint64_t value = 1);
+  static void observe(Phase phase, uint64_t micros);
+  static void response(int status, uint64_t bytes);
+
+  static size_t bucketIndex(uint64_t micros);
+  static uint64_t bucketUpperBound(size_t index);
+
+  // Snapshot of every shard, in Prometheus text exposition format or JSON.
+  static std::string prometheus();
+  static std::string json();
+};
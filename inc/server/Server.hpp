@@ -5,6 +5,11 @@
 #include "Poller.hpp"
 #include "ServerBlock.hpp"
 #include "resource/CGIHandler.hpp"
+#include "resource/CGIProcess.hpp"
+#include "resource/FastCGI.hpp"
+#include "utils/Trace.hpp"
+#include <chrono>
+#include <cstdint>
 #include <ctime>
 #include <map>
 #include <string>
@@ -12,31 +17,142 @@
 
 class Server {
 private:
+  struct Client {
+    time_t lastActivity = 0;
+    std::string buffer;
+    OutgoingResponse response;
+    size_t sent = 0;
+    bool responding = false;
+
+    // Access log and metrics fields for the request in flight.
+    uint8_t addr[4] = {0, 0, 0, 0};
+    uint16_t port = 0;
+    HTTP::Method method = HTTP::Method::UNKNOWN;
+    std::string target;
+    std::chrono::steady_clock::time_point acceptedAt; // reset at first byte
+    std::chrono::steady_clock::time_point startedAt;
+    std::chrono::steady_clock::time_point parsedAt;
+    std::chrono::steady_clock::time_point queuedAt;
+    Trace::Request trace;
+    uint64_t sendStartTick = 0;
+
+    // The CGI script producing this client's response, while it runs or
+    // its output is still being streamed.
+    std::shared_ptr<CGIOutput> cgi;
+    uint64_t cgiStartTick = 0;
+    bool acceptsChunked = true; // false for HTTP/1.0 requests
+    // Request body bytes not yet received when the script was started on
+    // the head alone; they are read into its stdin as they arrive.
+    size_t bodyRemaining = 0;
+    bool streamChecked = false; // the head has been tried for that
+    // The location whose cgi_max_concurrent slot the client holds, from
+    // admission until its script's output has ended, and whether it is
+    // waiting in CGIQueue for one instead.
+    const Route *cgiSlot = nullptr;
+    bool cgiQueued = false;
+    // CGI cache: the key this client fills by running the script, or waits
+    // on while another runs it, its location's cgi_cache_valid and whether
+    // the request carried Authorization. After a fill that could not be
+    // stored, waiters bypass the cache.
+    std::string cacheKey;
+    size_t cacheValidMs = 0;
+    bool cacheSharedOnly = false;
+    bool cacheWaiting = false;
+    bool cacheBypass = false;
+  };
+
+  // A script refreshing a stale CGI cache entry with no client to answer;
+  // its descriptors map to a negative id in _cgiToClient.
+  struct CacheRefresh {
+    std::string key;
+    size_t validMs = 0;
+    bool sharedOnly = false;
+    const Route *slot = nullptr;
+    std::shared_ptr<CGIOutput> cgi;
+  };
+
   int _serverFd;
   bool _running;
-  Poller _poller;
-  std::map<int, time_t> _clients;
-  std::map<int, std::string> _clientBuffers;
-  std::map<int, int> _cgiToClient;
+  Poller *_poller;
+  std::map<int, Client> _clients;
+  std::map<int, int> _cgiToClient; // CGI pipe or pidfd -> client fd
+  // CGI cache keys being filled, by a client or a refresh, with the clients
+  // waiting for them; and waiters to wake after this round of events.
+  std::map<std::string, std::vector<int>> _cacheFills;
+  std::vector<std::pair<int, bool>> _cacheWoken; // fd, bypass the cache
+  std::map<int, CacheRefresh> _refreshes;
+  int _nextRefreshId = -1;
   const ServerBlock *_config;
   RequestRouter _router;
+  // After _clients, so that it goes first and requests outlive no
+  // connection.
+  FastCGIPool _fastcgi;
 
 public:
-  explicit Server(const ServerBlock *config);
+  Server(const ServerBlock *config, Poller *poller);
   ~Server();
 
   int setupSocket();
   void stop() { _running = false; }
 
   int acceptConnection();
+  void handleEvent(const struct pollfd &pfd);
   void handleClient(int fd);
   void checkTimeouts();
 
   bool hasClient(int fd) const { return _clients.find(fd) != _clients.end(); }
+  bool hasCgi(int fd) const {
+    return _cgiToClient.find(fd) != _cgiToClient.end() || _fastcgi.owns(fd);
+  }
   void closeClient(int fd) { removeClient(fd); }
 
+  // From CGIQueue: a waiting client got its slot, or waited too long.
+  void resumeCgi(int fd, const Route *slot);
+  void shedCgi(int fd);
+
 private:
   void removeClient(int fd);
   void sendErrorToClient(int fd, int statusCode);
-  void sendResponseToClient(int clientFd, const std::string& response);
+  void processRequest(int fd);
+  void completeHead(const Client &client, std::string &head);
+  void respond(int fd, OutgoingResponse response);
+  void queueResponse(int fd, OutgoingResponse response);
+  void flushResponse(int fd);
+  OutgoingResponse statusPage(const Client &client, const Request &request);
+  void finishRequest(const Client &client, int status, size_t bytes);
+  void noteRequest(Client &client, const Request &request);
+  OutgoingResponse handle(int fd, const Request &request,
+                          const RouteContext &route);
+  OutgoingResponse passFastCgi(int fd, const Request &request,
+                               const RouteContext &route);
+  void startBodyStream(int fd);
+  bool admitCgi(int fd, const Request &request, const RouteContext &route);
+  void releaseCgiSlot(Client &client);
+  bool serveCgiCache(int fd, const Request &request,
+                     const RouteContext &route);
+  void fillCgiCache(Client &client);
+  void leaveCgiCache(int fd);
+  void endCacheFill(const std::string &key, bool bypass);
+  void wakeCacheWaiters();
+  void refreshCgiCache(const std::string &key, const Request &request,
+                       const RouteContext &route, bool sharedOnly);
+  void handleRefreshEvent(int id, const struct pollfd &pfd);
+  void pumpRefresh(int id);
+  void endRefresh(int id);
+
+  void startCgi(int fd, std::shared_ptr<CGIOutput> cgi);
+  void readCgiBody(int fd);
+  void updateCgiEvents(int fd);
+  void updateCgiFds(CGIOutput &cgi);
+  void handleCgiEvent(int clientFd, const struct pollfd &pfd);
+  void watchCgiFd(int cgiFd, short events, int clientFd);
+  void watchCgi(const CGIOutput &cgi, int clientFd);
+  void unwatchCgiFd(int cgiFd);
+  void unwatchCgi(const CGIOutput &cgi);
+  void detachCgi(Client &client);
+  void pumpCgi(int fd);
+  void completeCgi(int fd);
+  void startCgiStream(int fd);
+  void flushCgi(int fd);
+  void timeoutCgi(int fd);
 };
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../config/Config.hpp"
+#include "CacheWarmer.hpp"
 #include "Server.hpp"
 #include <map>
 #include <memory>
@@ -13,6 +14,7 @@ private:
   std::map<int, size_t> _socketToServerMap;
   bool _running;
   Poller _poller;
+  CacheWarmer _warmer;
 
 public:
   ServerManager();
@@ -25,6 +27,7 @@ public:
   size_t getServerCount() const { return _servers.size(); }
 
 private:
+  void startWarmup(const Config &config);
   void setupServerSockets();
   bool processEvents(int timeout);
   void dispatchEvent(const struct pollfd &pfd);
@@ -13,7 +13,36 @@ constexpr size_t MAX_HEADERS = 100;
 
 constexpr int DEFAULT_PORT = 8080;
 constexpr int CLIENT_TIMEOUT = 30;
-constexpr size_t DEFAULT_CACHE_SIZE = 100;
+constexpr size_t DEFAULT_CACHE_BYTES = 64 * 1024 * 1024;
+constexpr size_t DEFAULT_CACHE_MAX_ENTRY = 1024 * 1024;
+constexpr size_t CACHE_ENTRY_OVERHEAD = 128;
+constexpr size_t DEFAULT_CACHE_REVALIDATE_MS = 1000;
+constexpr size_t MMAP_THRESHOLD = 64 * 1024;
+constexpr size_t DEFAULT_RESPONSE_CACHE_ENTRIES = 4096;
+constexpr size_t DEFAULT_OPEN_FILE_CACHE_ENTRIES = 512;
+constexpr size_t DEFAULT_WARMUP_THREADS = 4;
+constexpr size_t DEFAULT_NEGATIVE_CACHE_ENTRIES = 4096;
+constexpr size_t DEFAULT_NEGATIVE_CACHE_VALID_MS = 5000;
+constexpr size_t DEFAULT_LOG_BUFFER_RECORDS = 8192;
+constexpr size_t DEFAULT_LOG_FLUSH_INTERVAL_MS = 100;
+constexpr size_t LOG_RECORD_TEXT = 488; // keeps a ring slot at 512 bytes
+constexpr size_t LOG_WRITE_BATCH = 64 * 1024;
+constexpr size_t DEFAULT_ACCESS_LOG_BUFFER = 64 * 1024;
+constexpr size_t DEFAULT_ACCESS_LOG_FLUSH_MS = 1000;
+constexpr size_t DEFAULT_CGI_TIMEOUT_MS = 30000;
+constexpr size_t CGI_STREAM_BUFFER = 64 * 1024; // output held per script
+constexpr size_t DEFAULT_CGI_WORKER_IDLE_TIMEOUT_MS = 60000;
+constexpr size_t MAX_CGI_WORKERS = 256; // per location
+constexpr size_t DEFAULT_CGI_MAX_CONCURRENT = 64; // scripts, process-wide
+constexpr size_t DEFAULT_CGI_QUEUE_SIZE = 256;
+constexpr size_t DEFAULT_CGI_QUEUE_TIMEOUT_MS = 10000;
+constexpr size_t DEFAULT_CGI_CACHE_ENTRIES = 1024;
+constexpr size_t CGI_CACHE_MAX_ENTRY = 1024 * 1024; // body bytes
+// For script output without a Content-Type of its own.
+constexpr char CGI_DEFAULT_CONTENT_TYPE[] = "application/octet-stream";
+constexpr size_t FASTCGI_KEEPALIVE = 8; // idle connections kept per backend
+constexpr size_t FASTCGI_IDLE_TIMEOUT_MS = 60000;
+constexpr size_t FASTCGI_MAX_MULTIPLEX = 32; // requests per connection
 constexpr int LISTEN_BACKLOG = 128;
 
 constexpr size_t MAX_PATH_LENGTH = 4096;
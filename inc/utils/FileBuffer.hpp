@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+class FileBuffer;
+using FileBufferPtr = std::shared_ptr<const FileBuffer>;
+
+// Immutable file contents shared between the file cache and every response
+// that is currently sending them. Large files are mmap'ed read-only, small
+// ones are read into a heap buffer; either way the bytes exist once no matter
+// how many clients download the file concurrently.
+//
+// Files that are mapped must be replaced by rename() rather than rewritten
+// in place: truncating a mapped file under a running send raises SIGBUS.
+class FileBuffer {
+public:
+  ~FileBuffer();
+
+  FileBuffer(const FileBuffer &) = delete;
+  FileBuffer &operator=(const FileBuffer &) = delete;
+
+  // Does not log, since the cache warm-up calls it from its own threads: a
+  // failed mmap falls back to reading and leaves its errno in *mapError.
+  static FileBufferPtr fromFd(int fd, size_t size, int *mapError = nullptr);
+  static FileBufferPtr fromString(std::string content);
+
+  const char *data() const { return _data; }
+  size_t size() const { return _size; }
+  std::string_view view() const { return std::string_view(_data, _size); }
+  bool isMapped() const { return _mapped; }
+
+private:
+  FileBuffer() = default;
+
+  const char *_data = nullptr;
+  size_t _size = 0;
+  bool _mapped = false;
+  std::string _heap;
+};
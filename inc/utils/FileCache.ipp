@@ -1,40 +1,195 @@
 #pragma once
 
+#include "utils/Constants.hpp"
+#include "utils/FileBuffer.hpp"
+#include <chrono>
+#include <iterator>
+#include <list>
 #include <string>
+#include <string_view>
+#include <sys/stat.h>
 #include <unordered_map>
 
+// Byte-budgeted LRU cache for static file contents. Contents are held as
+// shared FileBuffers, so a hit hands out a reference instead of a copy.
+// Entries larger than maxEntrySize are never admitted, so one big file cannot
+// flush everything else; when a new entry does not fit, least recently used
+// entries go first.
+//
+// Entries remember the inode, size and mtime the content was read from. A
+// hit older than the revalidation interval is checked with one stat() and
+// dropped if the file changed on disk, so deploys become visible without a
+// restart.
 class FileCache {
+public:
+  struct FileStamp {
+    ino_t inode = 0;
+    off_t size = 0;
+    time_t mtimeSec = 0;
+    long mtimeNsec = 0;
+
+    static FileStamp fromStat(const struct stat &st) {
+      FileStamp stamp;
+      stamp.inode = st.st_ino;
+      stamp.size = st.st_size;
+      stamp.mtimeSec = st.st_mtim.tv_sec;
+      stamp.mtimeNsec = st.st_mtim.tv_nsec;
+      return stamp;
+    }
+
+    bool operator==(const FileStamp &other) const {
+      return inode == other.inode && size == other.size &&
+             mtimeSec == other.mtimeSec && mtimeNsec == other.mtimeNsec;
+    }
+  };
+
+  struct CachedFile {
+    FileBufferPtr content;
+    std::string mimeType;
+    FileStamp stamp;
+  };
+
+  struct Stats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+    size_t rejected = 0;
+    size_t invalidations = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+  };
+
 private:
+  using Clock = std::chrono::steady_clock;
+
   struct CacheEntry {
-    std::string content;
+    std::string path;
+    FileBufferPtr content;
     std::string mimeType;
+    FileStamp stamp;
+    Clock::time_point validatedAt;
+
+    size_t cost() const {
+      return content->size() + path.size() + mimeType.size() +
+             Constants::CACHE_ENTRY_OVERHEAD;
+    }
   };
+  using EntryList = std::list<CacheEntry>;
 
-  std::unordered_map<std::string, CacheEntry> cache;
-  size_t maxEntries;
+  // Front of the list is the most recently used entry. The index keys are
+  // views into CacheEntry::path, which list nodes keep stable.
+  EntryList lru;
+  std::unordered_map<std::string_view, EntryList::iterator> index;
+  size_t maxBytes;
+  size_t maxEntrySize;
+  size_t usedBytes;
+  std::chrono::milliseconds revalidateInterval;
+  Stats stats;
 
-public:
-  FileCache(size_t maxEntries = 100) : maxEntries(maxEntries) {}
-
-  bool getFile(const std::string &path, std::string &content,
-               std::string &mimeType) {
-    auto it = cache.find(path);
-    if (it != cache.end()) {
-      content = it->second.content;
-      mimeType = it->second.mimeType;
+  void eraseEntry(EntryList::iterator it) {
+    usedBytes -= it->cost();
+    index.erase(it->path);
+    lru.erase(it);
+  }
+
+  bool isFresh(CacheEntry &entry) {
+    Clock::time_point now = Clock::now();
+    if (now - entry.validatedAt < revalidateInterval)
       return true;
+    struct stat st;
+    if (stat(entry.path.c_str(), &st) != 0 ||
+        !(FileStamp::fromStat(st) == entry.stamp))
+      return false;
+    entry.validatedAt = now;
+    return true;
+  }
+
+  void evictUntilFits(size_t incoming) {
+    while (!lru.empty() && usedBytes + incoming > maxBytes) {
+      eraseEntry(std::prev(lru.end()));
+      ++stats.evictions;
     }
-    return false;
   }
 
-  void cacheFile(const std::string &path, const std::string &content,
-                 const std::string &mimeType) {
+public:
+  FileCache(size_t maxBytes = Constants::DEFAULT_CACHE_BYTES,
+            size_t maxEntrySize = Constants::DEFAULT_CACHE_MAX_ENTRY)
+      : maxBytes(maxBytes), maxEntrySize(maxEntrySize), usedBytes(0),
+        revalidateInterval(Constants::DEFAULT_CACHE_REVALIDATE_MS) {}
+
+  FileCache(const FileCache &) = delete;
+  FileCache &operator=(const FileCache &) = delete;
+
+  void configure(size_t newMaxBytes, size_t newMaxEntrySize) {
+    maxBytes = newMaxBytes;
+    maxEntrySize = newMaxEntrySize;
+    evictUntilFits(0);
+  }
+
+  void setRevalidateInterval(std::chrono::milliseconds interval) {
+    revalidateInterval = interval;
+  }
+
+  bool getFile(const std::string &path, CachedFile &file) {
+    auto it = index.find(path);
+    if (it == index.end()) {
+      ++stats.misses;
+      return false;
+    }
+    if (!isFresh(*it->second)) {
+      eraseEntry(it->second);
+      ++stats.invalidations;
+      ++stats.misses;
+      return false;
+    }
+    lru.splice(lru.begin(), lru, it->second);
+    file.content = it->second->content;
+    file.mimeType = it->second->mimeType;
+    file.stamp = it->second->stamp;
+    ++stats.hits;
+    return true;
+  }
 
-    if (cache.size() >= maxEntries && cache.find(path) == cache.end()) {
-      auto it = cache.begin();
-      cache.erase(it);
+  void cacheFile(const std::string &path, const FileBufferPtr &content,
+                 const std::string &mimeType, const FileStamp &stamp) {
+    auto existing = index.find(path);
+    if (existing != index.end())
+      eraseEntry(existing->second);
+
+    CacheEntry entry{path, content, mimeType, stamp, Clock::now()};
+    size_t cost = entry.cost();
+    if (maxBytes == 0 || content->size() > maxEntrySize || cost > maxBytes) {
+      ++stats.rejected;
+      return;
     }
-    cache[path] = {content, mimeType};
+    evictUntilFits(cost);
+    lru.push_front(std::move(entry));
+    index[lru.front().path] = lru.begin();
+    usedBytes += cost;
+  }
+
+  void removeFile(const std::string &path) {
+    auto it = index.find(path);
+    if (it != index.end()) {
+      eraseEntry(it->second);
+      ++stats.invalidations;
+    }
+  }
+
+  void clearCache() {
+    index.clear();
+    lru.clear();
+    usedBytes = 0;
+  }
+
+  size_t getMaxEntrySize() const {
+    return maxBytes == 0 ? 0 : maxEntrySize;
+  }
+
+  Stats getStats() const {
+    Stats current = stats;
+    current.entries = lru.size();
+    current.bytes = usedBytes;
+    return current;
   }
-  void clearCache() { cache.clear(); }
 };
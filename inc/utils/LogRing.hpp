@@ -0,0 +1,46 @@
+#pragma once
+#include "utils/Constants.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+enum class LogLevel;
+
+// One preformatted log line. Text beyond the inline buffer is truncated so a
+// record never allocates.
+struct LogRecord {
+  int64_t timeUs = 0; // system clock, microseconds since the epoch
+  LogLevel level;
+  uint16_t length = 0;
+  bool truncated = false;
+  char text[Constants::LOG_RECORD_TEXT];
+};
+
+// Bounded multi-producer, single-consumer queue of log records (Vyukov's
+// array queue). Producers claim a slot with one CAS on the tail and publish
+// it through the slot's sequence number; the consumer never writes shared
+// counters other than the slot it frees, so neither side takes a lock.
+class LogRing {
+public:
+  explicit LogRing(size_t capacity); // rounded up to a power of two
+  LogRing(const LogRing &) = delete;
+  LogRing &operator=(const LogRing &) = delete;
+
+  // Returns false when the ring is full.
+  bool push(LogLevel level, int64_t timeUs, std::string_view text);
+  // Consumer side only.
+  bool pop(LogRecord &record);
+  size_t capacity() const { return _mask + 1; }
+
+private:
+  struct alignas(64) Slot {
+    std::atomic<size_t> sequence;
+    LogRecord record;
+  };
+
+  std::unique_ptr<Slot[]> _slots;
+  size_t _mask;
+  alignas(64) std::atomic<size_t> _tail;
+  alignas(64) size_t _head;
+};
@@ -1,4 +1,5 @@
 #pragma once
+#include "utils/Constants.hpp"
 #include <chrono>
 #include <fstream>
 #include <iomanip>
@@ -6,12 +7,41 @@
 #include <memory>
 #include <sstream>
 #include <string>
-#include <vector>
+#include <type_traits>
 
 enum class LogLevel { DEBUG = 0, INFO = 1, WARN = 2, ERROR = 3 };
 
+// Levels below LOG_MIN_LEVEL are compiled out of logf(): the call, its
+// arguments' formatting and the runtime level check all disappear. Debug
+// builds (make DEBUG=1) keep everything; `make LOG_LEVEL=2` keeps WARN+.
+#ifndef LOG_MIN_LEVEL
+#ifdef DEBUG_LOGGING
+#define LOG_MIN_LEVEL 0
+#else
+#define LOG_MIN_LEVEL 1
+#endif
+#endif
+
 class Logger {
+public:
+  // Async mode: logf() only copies the message into a lock-free ring and a
+  // background thread formats timestamps and writes whole batches, at the
+  // latest flushInterval after a record was queued. A full ring either drops
+  // the record (counted) or makes the caller wait for space.
+  struct AsyncSettings {
+    size_t bufferRecords = Constants::DEFAULT_LOG_BUFFER_RECORDS;
+    size_t flushIntervalMs = Constants::DEFAULT_LOG_FLUSH_INTERVAL_MS;
+    bool blockWhenFull = false;
+  };
+  struct AsyncStats {
+    size_t written = 0;
+    size_t dropped = 0;
+    size_t blocked = 0;
+  };
+
 private:
+  struct AsyncState;
+
   static LogLevel _currentLevel;
   static std::ofstream _logFile;
   static bool _logToFile;
@@ -24,15 +54,26 @@ private:
   static const std::string COLOR_WARN;
   static const std::string COLOR_ERROR;
 
+  static std::unique_ptr<AsyncState> _async;
+
   static std::string getCurrentTime();
   static std::string levelToString(LogLevel level);
   static std::string getColorForLevel(LogLevel level);
   static void writeLog(LogLevel level, std::string_view message);
+  static void appendLine(std::string &console, std::string &file,
+                         LogLevel level, std::string_view timestamp,
+                         std::string_view message);
+  static void writeOut(std::string &console, std::string &file);
+  static void runWriter(AsyncState &state);
 
 public:
   static void setLevel(LogLevel level) noexcept;
   static void enableFileLogging(std::string_view filename);
   static void disableFileLogging() noexcept;
+  static void startAsync(const AsyncSettings &settings);
+  // Drains and joins the writer; call once no other thread is logging.
+  static void stopAsync();
+  static AsyncStats asyncStats();
 
 #ifdef DEBUG_LOGGING
   static void debug(std::string_view message);
@@ -45,41 +86,68 @@ public:
   static void warn(std::string_view message);
   static void error(std::string_view message);
 
+  static constexpr LogLevel minLevel = static_cast<LogLevel>(LOG_MIN_LEVEL);
+
+  static bool enabled(LogLevel level) noexcept {
+    return level >= minLevel && _currentLevel <= level;
+  }
+
+  // Arguments are only formatted once the level is known to be enabled. An
+  // argument may also be a callable, which is invoked at that point, so an
+  // expensive value costs nothing when the message is filtered out:
+  //   logf<LogLevel::DEBUG>("state: %s", [&] { return dump(); });
   template <LogLevel Level, typename... Args>
   static void logf(std::string_view format, Args &&...args) {
-    if (_currentLevel <= Level) {
-      writeLog(Level, simpleFormat(format, std::forward<Args>(args)...));
+    if constexpr (Level >= minLevel) {
+      if (_currentLevel <= Level)
+        writeLog(Level, simpleFormat(format, std::forward<Args>(args)...));
     }
   }
 
 private:
-  template <typename T> static std::string toString(T &&value) {
-    std::ostringstream ss;
-    ss << value;
-    return ss.str();
+  template <typename T> static void put(std::ostream &out, T &&value) {
+    if constexpr (std::is_invocable_v<T>)
+      out << value();
+    else
+      out << value;
+  }
+
+  // Copies format text up to the next conversion ("%s", "%zu", ...) and
+  // returns the position just past it, or npos when none is left.
+  static size_t copyUntilConversion(std::ostream &out, std::string_view format,
+                                    size_t pos) {
+    for (; pos < format.size(); ++pos) {
+      if (format[pos] != '%') {
+        out << format[pos];
+        continue;
+      }
+      while (pos + 1 < format.size() &&
+             (std::isalpha(format[pos + 1]) || std::isdigit(format[pos + 1])))
+        ++pos;
+      return pos + 1;
+    }
+    return std::string_view::npos;
   }
 
+  // Single pass: each argument is streamed straight into the message where
+  // its conversion appears. Surplus arguments and conversions are dropped.
   template <typename... Args>
   static std::string simpleFormat(std::string_view format, Args &&...args) {
     if constexpr (sizeof...(args) == 0) {
       return std::string(format);
     } else {
       std::ostringstream result;
-      std::vector<std::string> values = {toString(std::forward<Args>(args))...};
-
-      size_t argIndex = 0;
-      for (size_t i = 0; i < format.size(); ++i) {
-        if (format[i] == '%' && argIndex < values.size()) {
-          result << values[argIndex++];
-
-          while (i + 1 < format.size() &&
-                 (std::isalpha(format[i + 1]) || std::isdigit(format[i + 1]))) {
-            ++i;
-          }
-        } else if (format[i] != '%') {
-          result << format[i];
-        }
-      }
+      size_t pos = 0;
+      auto next = [&](auto &&value) {
+        if (pos == std::string_view::npos)
+          return;
+        pos = copyUntilConversion(result, format, pos);
+        if (pos != std::string_view::npos)
+          put(result, std::forward<decltype(value)>(value));
+      };
+      (next(std::forward<Args>(args)), ...);
+      while (pos != std::string_view::npos)
+        pos = copyUntilConversion(result, format, pos);
       return result.str();
     }
   }
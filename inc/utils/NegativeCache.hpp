@@ -0,0 +1,26 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Known-missing paths, grouped by document root. Scanners and broken links
+// ask for the same nonexistent paths over and over; a hit here answers 404
+// without touching the filesystem. Entries expire after the validity interval
+// and a root's whole set is dropped whenever something is written below it.
+class NegativeCache {
+public:
+  struct Stats {
+    size_t hits = 0;
+    size_t misses = 0; // lookups that found no live entry
+    size_t inserts = 0;
+    size_t evictions = 0;
+    size_t invalidations = 0;
+    size_t entries = 0;
+  };
+
+  static void configure(size_t maxEntriesPerRoot, size_t validMs);
+  static bool contains(const std::string &root, const std::string &path);
+  static void insert(const std::string &root, const std::string &path);
+  static void invalidatePath(const std::string &path);
+  static void clear();
+  static Stats stats();
+};
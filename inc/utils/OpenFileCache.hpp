@@ -0,0 +1,48 @@
+#pragma once
+#include "utils/FileCache.ipp"
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+
+// An open descriptor together with the fstat() result it was opened with.
+// Directories and failed lookups carry no descriptor; failures keep the
+// errno so repeated misses can be answered from the cache (only lasting
+// ones such as ENOENT are cached, never EMFILE and other transient ones).
+struct OpenFile {
+  int fd = -1;
+  int error = 0;
+  bool isDirectory = false;
+  size_t size = 0;
+  FileCache::FileStamp stamp;
+
+  OpenFile() = default;
+  OpenFile(const OpenFile &) = delete;
+  OpenFile &operator=(const OpenFile &) = delete;
+  ~OpenFile();
+
+  bool ok() const { return error == 0; }
+  bool isRegular() const { return ok() && !isDirectory; }
+};
+using OpenFilePtr = std::shared_ptr<const OpenFile>;
+
+// nginx-style open file cache for the static path. One lookup replaces the
+// stat()/is_directory()/open() sequence; entries are re-checked with a single
+// stat() once older than the validity interval and evicted LRU beyond
+// maxEntries. Descriptors are shared, so an evicted file that is still being
+// sent stays open until the response finishes.
+class OpenFileCache {
+public:
+  struct Stats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t errorHits = 0;
+    size_t evictions = 0;
+    size_t entries = 0;
+  };
+
+  static void configure(size_t maxEntries, size_t validMs, bool cacheErrors);
+  static OpenFilePtr lookup(const std::string &path);
+  static void invalidate(const std::string &path);
+  static void clear();
+  static Stats stats();
+};
@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Per-request phase timing. Each request owns a Trace::Request that adds up
+// the clock ticks spent in every phase; while the event loop works on a
+// request it is made current, and Trace::Span objects in the layers below
+// (parser, file handler, CGI) charge their scope to it without any state
+// being passed around. With no current request a span costs one branch.
+//
+// Ticks come from the monotonic clock, or from the TSC (rdtsc) calibrated
+// against it at startup when that mode is selected and available.
+class Trace {
+public:
+  enum Phase {
+    RECV,
+    PARSE,
+    ROUTE,
+    CACHE,
+    FILE,
+    CGI_SPAWN,
+    CGI_WAIT,
+    HANDLER,
+    SEND,
+    PHASE_COUNT
+  };
+
+  struct Request {
+    uint64_t ticks[PHASE_COUNT] = {};
+    uint64_t startedAt = 0;
+  };
+
+  struct Settings {
+    bool useTsc = false;
+    bool serverTiming = false;
+    size_t slowRequestMs = 0; // 0: no slow-request log
+  };
+
+  class Span {
+  public:
+    explicit Span(Phase phase);
+    ~Span() { finish(); }
+    // Ends the span before the end of its scope.
+    void finish();
+    Span(const Span &) = delete;
+    Span &operator=(const Span &) = delete;
+
+  private:
+    Request *_request;
+    Phase _phase;
+    uint64_t _start;
+  };
+
+  // Makes `request` current for the lifetime of the scope.
+  class Scope {
+  public:
+    explicit Scope(Request *request);
+    ~Scope();
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    Request *_previous;
+  };
+
+  // Returns false if rdtsc was requested but is not usable here; the
+  // monotonic clock is used instead.
+  static bool configure(const Settings &settings);
+  static bool usingTsc();
+  // Whether requests should be traced at all.
+  static bool enabled();
+  static bool serverTimingEnabled();
+  static size_t slowRequestMs();
+  static uint64_t now();
+  static double toMillis(uint64_t ticks);
+
+  // "recv;dur=0.012, parse;dur=0.034, ..." for the Server-Timing header,
+  // listing only phases that ran, plus the total since the request started.
+  static std::string serverTiming(const Request &request);
+  // "total=12.3ms recv=0.01ms ..." for the slow-request log.
+  static std::string summary(const Request &request);
+};
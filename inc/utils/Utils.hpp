@@ -1,7 +1,10 @@
 #pragma once
 #include "Constants.hpp"
+#include "FileCache.ipp"
 #include "HTTP/core/HTTPTypes.hpp"
+#include <ctime>
 #include <filesystem>
+#include <map>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -24,12 +27,26 @@ public:
   static std::filesystem::path canonicalizePath(std::string_view path);
   static std::string extractQueryParams(std::string_view uri);
   static std::string cleanUri(std::string_view uri);
+  static std::string formatHttpDate(time_t time);
+  static const std::string &currentHttpDate();
+  static bool parseHttpDate(std::string_view date, time_t &result);
+  static std::string makeETag(const FileCache::FileStamp &stamp);
+  static bool isNotModified(const std::map<std::string, std::string> &headers,
+                            std::string_view etag, time_t lastModified);
+  // Header names are case-insensitive; nullptr if `name` is absent.
+  static const std::string *
+  findHeader(const std::map<std::string, std::string> &headers,
+             std::string_view name);
 };
 
 class FileUtils {
 public:
   static std::string readFile(std::string_view rootDir, std::string_view uri,
                               StatusCode &status);
+  static FileBufferPtr readFileBuffer(std::string_view rootDir,
+                                      std::string_view uri, StatusCode &status);
+  static bool loadFile(std::string_view filePath, FileCache::CachedFile &file,
+                       StatusCode &status);
   static bool writeFile(std::string_view rootDir, std::string_view uri,
                         std::string_view content, StatusCode &status);
   static bool deleteFile(std::string_view rootDir, std::string_view uri,
@@ -43,4 +60,12 @@ public:
   static bool createDirectories(std::string_view path);
   static bool exists(std::string_view path);
   static std::string getMimeType(std::string_view filePath);
+  static void configureCache(size_t maxBytes, size_t maxEntrySize,
+                             size_t revalidateMs);
+  static void invalidateCache(std::string_view filePath);
+  static void preloadFile(std::string_view filePath,
+                          const FileCache::CachedFile &file);
+  static std::string normalizePath(std::string_view filePath);
+  static FileCache::Stats cacheStats();
+  static size_t cacheMaxEntrySize();
 };
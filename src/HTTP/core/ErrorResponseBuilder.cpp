@@ -2,7 +2,6 @@
 #include "HTTP/core/HTTPTypes.hpp"
 #include "HTTP/core/HttpResponse.hpp"
 #include "utils/Utils.hpp"
-#include <fstream>
 #include <sstream>
 
 const ServerBlock *ErrorResponseBuilder::_currentConfig = nullptr;
@@ -25,12 +24,10 @@ std::string ErrorResponseBuilder::loadCustomErrorPage(int statusCode) {
     return "";
   std::string errorPagePath =
       _currentConfig->root + "/" + _currentConfig->errorPages.at(statusCode);
-  std::ifstream file(errorPagePath);
-  if (!file.is_open())
-    return "";
-  std::ostringstream buffer;
-  buffer << file.rdbuf();
-  return buffer.str();
+  // Served from the file cache: error bursts should not re-read the page.
+  HTTP::StatusCode status;
+  FileBufferPtr page = FileUtils::readFileBuffer("", errorPagePath, status);
+  return page ? std::string(page->view()) : "";
 }
 
 std::string ErrorResponseBuilder::buildDefaultError(int statusCode) {
@@ -9,6 +9,7 @@
 #include "HTTP/core/HTTPTypes.hpp"
 #include "HTTP/routing/RequestRouter.hpp"
 #include "Logger.hpp"
+#include "utils/Trace.hpp"
 #include "utils/Utils.hpp"
 #include "utils/ValidationUtils.hpp"
 
@@ -29,7 +30,24 @@ static bool isValidHttpVersion(const std::string &version) {
   return version == "HTTP/1.1" || version == "HTTP/1.0";
 }
 
-ParseResult parseRequest(const std::string &data, Request &request, const RequestRouter *router) {
+ParseResult parseRequest(const std::string &data, Request &request,
+                         const RequestRouter *router, RouteContext &route) {
+  ParseResult result = parseRequestHead(data, request, router, route);
+  if (!result.success)
+    return result;
+
+  if (!parseRequestBody(data, data.find("\r\n\r\n") + 4, request, route)) {
+    if (request.body.length() > route.maxBodySize)
+      return ParseResult(false, 413, "Payload Too Large");
+    return ParseResult(false, 400, "Bad Request");
+  }
+  
+  return ParseResult(true, 200, "OK");
+}
+
+ParseResult parseRequestHead(const std::string &data, Request &request,
+                             const RequestRouter *router,
+                             RouteContext &route) {
   if (data.empty()) {
     Logger::error("Empty HTTP request");
     return ParseResult(false, 400, "Bad Request");
@@ -72,23 +90,18 @@ ParseResult parseRequest(const std::string &data, Request &request, const Reques
   if (!validateHttpRequest(request))
     return ParseResult(false, 400, "Bad Request");
   
-  if (router) {
-    const LocationBlock *location = router->findLocation(request.requestLine.uri);
-    if (location && !router->isMethodAllowed(request, location)) {
-      return ParseResult(false, 405, "Method Not Allowed");
-    }
+  {
+    Trace::Span span(Trace::ROUTE);
+    route = (router ? *router : RequestRouter::fallback())
+                .resolve(request.requestLine.uri);
   }
+  if (!route.route->allows(request.requestLine.method))
+    return ParseResult(false, 405, "Method Not Allowed");
   
-  if (!parseContentLengthWithRouter(request, router))
+  if (!parseContentLength(request, route))
     return ParseResult(false, 413, "Payload Too Large");
-
-  if (!parseRequestBody(data, headerEnd + 4, request, router)) {
-    size_t maxBodySize = ValidationUtils::getMaxBodySize(request.requestLine.uri, router);
-    if (request.body.length() > maxBodySize)
-      return ParseResult(false, 413, "Payload Too Large");
-    return ParseResult(false, 400, "Bad Request");
-  }
-  
+  request.chunkedTransfer =
+      getHeader(request.headers, "Transfer-Encoding") == "chunked";
   return ParseResult(true, 200, "OK");
 }
 
@@ -163,19 +176,12 @@ bool parseHeader(std::string_view line,
   return true;
 }
 
-bool parseContentLengthWithRouter(Request &request, const RequestRouter *router) {
-  if (router) {
-    const LocationBlock *location = router->findLocation(request.requestLine.uri);
-    if (location && !router->isMethodAllowed(request, location)) {
-      return true;
-    }
-  }
-  
+bool parseContentLength(Request &request, const RouteContext &route) {
   std::string contentLength = getHeader(request.headers, "Content-Length");
   if (contentLength.empty())
     return true;
   
-  if (!ValidationUtils::validateContentLengthWithRouter(contentLength, request.requestLine.uri, request.contentLength, router)) {
+  if (!ValidationUtils::validateContentLength(contentLength, request.contentLength, route.maxBodySize)) {
     Logger::error("Invalid Content-Length or body size exceeds limit");
     return false;
   }
@@ -195,17 +201,17 @@ bool validateHttpRequest(const Request &request) {
 }
 
 bool parseRequestBody(const std::string &data, size_t bodyStart,
-                     Request &request, const RequestRouter *router) {
+                     Request &request, const RouteContext &route) {
   if (bodyStart >= data.length()) {
     request.body.clear();
     return true;
   }
-  size_t maxBodySize = ValidationUtils::getMaxBodySize(request.requestLine.uri, router);
+  size_t maxBodySize = route.maxBodySize;
 
   std::string transferEncoding = getHeader(request.headers, "Transfer-Encoding");
   if (!transferEncoding.empty() && transferEncoding == "chunked") {
     request.chunkedTransfer = true;
-    return parseChunkedBody(data, bodyStart, request.body, request.requestLine.uri, router);
+    return parseChunkedBody(data, bodyStart, request.body, maxBodySize);
   }
 
   if (!parseBody(data, bodyStart, request.body)) {
@@ -221,10 +227,9 @@ bool parseRequestBody(const std::string &data, size_t bodyStart,
 }
 
 bool parseChunkedBody(std::string_view data, size_t bodyStart,
-                     std::string &body, const std::string &uri, const RequestRouter *router) {
+                     std::string &body, size_t maxBodySize) {
   body.clear();
   size_t pos = bodyStart, chunkCount = 0;
-  size_t maxBodySize = ValidationUtils::getMaxBodySize(uri, router);
 
   while (pos < data.length()) {
     size_t chunkSize;
@@ -301,7 +306,7 @@ std::vector<MultipartFile> parseMultipartData(const std::string &body,
       break;
     MultipartFile file;
     size_t headerStart = body.rfind("filename=\"", pos);
-    if (headerStart != std::string::npos && headerStart > pos - 200) {
+    if (headerStart != std::string::npos && headerStart + 200 > pos) {
       headerStart += 10;
       size_t headerEnd = body.find("\"", headerStart);
       if (headerEnd != std::string::npos)
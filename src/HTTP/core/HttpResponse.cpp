@@ -7,14 +7,13 @@
 #include <map>
 #include <sstream>
 
-std::string HttpResponse::formatDate() {
-  auto now = std::time(nullptr);
-  std::ostringstream ss;
-  ss << std::put_time(std::gmtime(&now), "%a, %d %b %Y %H:%M:%S GMT");
-  return ss.str();
+std::string HttpResponse::formatDate() { return HttpUtils::currentHttpDate(); }
+
+size_t HttpResponse::bodySize() const {
+  return _sharedBody ? _sharedBody->size() : _body.size();
 }
 
-std::string HttpResponse::str() const {
+std::string HttpResponse::headerBlock() const {
   std::ostringstream response;
 
   response << "HTTP/1.1 " << _statusCode << " " << _statusText << "\r\n";
@@ -22,18 +21,55 @@ std::string HttpResponse::str() const {
     response << "Date: " << formatDate() << "\r\n";
   if (_headers.find("Server") == _headers.end())
     response << "Server: webserv/1.0\r\n";
-  if (!_body.empty() && _headers.find("Content-Length") == _headers.end())
-    response << "Content-Length: " << _body.length() << "\r\n";
+  if (bodySize() != 0 && _headers.find("Content-Length") == _headers.end())
+    response << "Content-Length: " << bodySize() << "\r\n";
   if (_headers.find("Connection") == _headers.end())
     response << "Connection: close\r\n";
+  for (const auto &[name, value] : _headers)
+    response << name << ": " << value << "\r\n";
+  response << "\r\n";
+  return response.str();
+}
+
+std::string HttpResponse::cacheableHeaderBlock() const {
+  std::ostringstream response;
+
+  response << "HTTP/1.1 " << _statusCode << " " << _statusText << "\r\n";
+  if (_headers.find("Server") == _headers.end())
+    response << "Server: webserv/1.0\r\n";
+  if (bodySize() != 0 && _headers.find("Content-Length") == _headers.end())
+    response << "Content-Length: " << bodySize() << "\r\n";
   for (const auto &[name, value] : _headers) {
-    if (name != "Content-Length")
+    if (name != "Date" && name != "Connection")
       response << name << ": " << value << "\r\n";
   }
-  response << "\r\n" << _body;
   return response.str();
 }
 
+std::string HttpResponse::completeHeaderBlock(std::string_view cacheable) {
+  std::string head;
+  head.reserve(cacheable.size() + 64);
+  head.append(cacheable);
+  head.append("Date: ").append(formatDate()).append("\r\n");
+  head.append("Connection: close\r\n\r\n");
+  return head;
+}
+
+std::string HttpResponse::str() const {
+  std::string response = headerBlock();
+  if (_sharedBody)
+    response.append(_sharedBody->view());
+  else
+    response += _body;
+  return response;
+}
+
+OutgoingResponse HttpResponse::build() const {
+  if (!_sharedBody)
+    return OutgoingResponse(str());
+  return OutgoingResponse(headerBlock(), _sharedBody);
+}
+
 HttpResponse &HttpResponse::status(int code, std::string_view text) {
   _statusCode = code;
   _statusText = text.empty() ? HTTP::statusToString(code) : std::string(text);
@@ -55,6 +91,14 @@ HttpResponse &HttpResponse::body(std::string_view content,
   return *this;
 }
 
+HttpResponse &HttpResponse::body(FileBufferPtr content,
+                                 std::string_view contentType) {
+  _body.clear();
+  _sharedBody = std::move(content);
+  header("Content-Type", contentType);
+  return *this;
+}
+
 void HttpResponse::setHeader(
     const std::pair<std::string_view, std::string_view> &header) {
   _headers[std::string(header.first)] = header.second;
@@ -0,0 +1,161 @@
+#include "HTTP/core/ResponseCache.hpp"
+#include "utils/Constants.hpp"
+#include "utils/Utils.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <list>
+#include <sstream>
+#include <sys/stat.h>
+#include <unordered_map>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+struct CacheSlot {
+  std::string key;
+  ResponseCache::Entry entry;
+  Clock::time_point validatedAt;
+};
+
+static std::list<CacheSlot> lru;
+static std::unordered_map<std::string_view, std::list<CacheSlot>::iterator>
+    slots;
+// The slots serving each file, so that a write drops only those.
+static std::unordered_multimap<std::string_view,
+                               std::list<CacheSlot>::iterator>
+    byFile;
+static size_t maxEntries = Constants::DEFAULT_RESPONSE_CACHE_ENTRIES;
+static size_t maxBytes = Constants::DEFAULT_CACHE_BYTES;
+static size_t maxEntryBytes = Constants::DEFAULT_CACHE_MAX_ENTRY;
+static size_t bytes = 0; // body bytes held by the entries
+static std::chrono::milliseconds
+    revalidateInterval(Constants::DEFAULT_CACHE_REVALIDATE_MS);
+static ResponseCache::Stats counters;
+
+static size_t bodySize(const ResponseCache::Entry &entry) {
+  return entry.body ? entry.body->size() : 0;
+}
+
+static void eraseSlot(std::list<CacheSlot>::iterator it) {
+  bytes -= bodySize(it->entry);
+  auto range = byFile.equal_range(it->entry.filePath);
+  for (auto file = range.first; file != range.second; ++file)
+    if (file->second == it) {
+      byFile.erase(file);
+      break;
+    }
+  slots.erase(it->key);
+  lru.erase(it);
+}
+
+static bool isFresh(CacheSlot &slot) {
+  Clock::time_point now = Clock::now();
+  if (now - slot.validatedAt < revalidateInterval)
+    return true;
+  struct stat st;
+  if (stat(slot.entry.filePath.c_str(), &st) != 0 ||
+      !(FileCache::FileStamp::fromStat(st) == slot.entry.stamp))
+    return false;
+  slot.validatedAt = now;
+  return true;
+}
+
+void ResponseCache::configure(size_t newMaxEntries, size_t newMaxBytes,
+                              size_t newMaxEntryBytes, size_t revalidateMs) {
+  maxEntries = newMaxEntries;
+  maxBytes = newMaxBytes;
+  maxEntryBytes = newMaxEntryBytes;
+  revalidateInterval = std::chrono::milliseconds(revalidateMs);
+  while (!lru.empty() && (lru.size() > maxEntries || bytes > maxBytes))
+    eraseSlot(std::prev(lru.end()));
+}
+
+std::string ResponseCache::makeKey(const RouteContext &route,
+                                   const HTTP::Request &request) {
+  std::ostringstream key;
+  key << route.server << '\n' << route.route << '\n';
+  auto host = request.headers.find("Host");
+  if (host != request.headers.end()) {
+    std::string lowered = host->second;
+    std::transform(lowered.begin(), lowered.end(), lowered.begin(), ::tolower);
+    key << lowered;
+  }
+  key << '\n' << FileUtils::normalizePath(route.uri);
+  return key.str();
+}
+
+bool ResponseCache::lookup(const std::string &key,
+                           const HTTP::Request &request,
+                           OutgoingResponse &response) {
+  if (maxEntries == 0 || request.headers.count("Range"))
+    return false;
+
+  auto it = slots.find(key);
+  if (it == slots.end()) {
+    ++counters.misses;
+    return false;
+  }
+  if (!isFresh(*it->second)) {
+    eraseSlot(it->second);
+    ++counters.invalidations;
+    ++counters.misses;
+    return false;
+  }
+  lru.splice(lru.begin(), lru, it->second);
+
+  const Entry &entry = it->second->entry;
+  ++counters.hits;
+  if (HttpUtils::isNotModified(request.headers, entry.etag,
+                               entry.lastModified)) {
+    ++counters.notModified;
+    response = OutgoingResponse(
+        HttpResponse::completeHeaderBlock(entry.notModifiedHeaders));
+    return true;
+  }
+  response = OutgoingResponse(HttpResponse::completeHeaderBlock(entry.headers),
+                              entry.body);
+  return true;
+}
+
+void ResponseCache::store(const std::string &key, Entry entry) {
+  size_t size = bodySize(entry);
+  if (maxEntries == 0 || size > maxEntryBytes || size > maxBytes)
+    return;
+  auto existing = slots.find(key);
+  if (existing != slots.end())
+    eraseSlot(existing->second);
+  while (!lru.empty() &&
+         (lru.size() >= maxEntries || bytes + size > maxBytes))
+    eraseSlot(std::prev(lru.end()));
+
+  bytes += size;
+  lru.push_front(CacheSlot{key, std::move(entry), Clock::now()});
+  slots[lru.front().key] = lru.begin();
+  byFile.emplace(lru.front().entry.filePath, lru.begin());
+}
+
+void ResponseCache::invalidateFile(const std::string &filePath) {
+  auto range = byFile.equal_range(filePath);
+  std::vector<std::list<CacheSlot>::iterator> stale;
+  for (auto file = range.first; file != range.second; ++file)
+    stale.push_back(file->second);
+  for (auto it : stale) {
+    eraseSlot(it);
+    ++counters.invalidations;
+  }
+}
+
+void ResponseCache::clear() {
+  byFile.clear();
+  slots.clear();
+  lru.clear();
+  bytes = 0;
+}
+
+ResponseCache::Stats ResponseCache::stats() {
+  Stats current = counters;
+  current.entries = lru.size();
+  current.bytes = bytes;
+  return current;
+}
@@ -8,38 +8,32 @@
 #include <chrono>
 #include <ctime>
 #include <filesystem>
-#include <fstream>
 
 using HTTP::Method;
 using HTTP::methodToString;
 using HTTP::Request;
 using HTTP::StatusCode;
 
-std::string MethodHandler::handleRequest(const Request &request,
-                                         std::string_view root,
-                                         const RequestRouter *router) {
-
-  if (router) {
-    const LocationBlock *location = router->findLocation(request.requestLine.uri);
-    if (location) {
-      if (!router->isMethodAllowed(request, location)) {
-        return ErrorResponseBuilder::buildResponse(405);
-      }
-      if (router->hasRedirection(location)) {
-        return router->handleRedirection(location);
-      }
-      std::string resolvedRoot = router->resolveRoot(location);
-      root = resolvedRoot;
-    }
+OutgoingResponse MethodHandler::handleRequest(const Request &request,
+                                              const RouteContext &route) {
+  if (!route.route->allows(request.requestLine.method))
+    return ErrorResponseBuilder::buildResponse(405);
+  if (route.route->hasRedirection()) {
+    Logger::logf<LogLevel::DEBUG>("Performing redirection to %s with code %d",
+                                  route.route->redirectUrl.c_str(),
+                                  route.route->redirectCode);
+    return HttpResponse::redirect(route.route->redirectUrl,
+                                  route.route->redirectCode)
+        .str();
   }
 
   switch (request.requestLine.method) {
   case Method::GET:
-    return handleGet(request, root, router);
+    return handleGet(request, route);
   case Method::POST:
-    return handlePost(request, root, router);
+    return handlePost(request, route);
   case Method::DELETE:
-    return handleDelete(request, root, router);
+    return handleDelete(request, route);
   default:
     Logger::logf<LogLevel::WARN>("Unsupported method: %s",
                                 methodToString(request.requestLine.method).c_str());
@@ -47,90 +41,63 @@ std::string MethodHandler::handleRequest(const Request &request,
   }
 }
 
-std::pair<std::string, std::string>
-MethodHandler::resolvePaths(const Request &request, std::string_view root,
-                            const RequestRouter *router) {
-  std::string effectiveRoot = HttpUtils::getEffectiveRoot(root);
-  std::string cleanUri = HttpUtils::cleanUri(request.requestLine.uri);
-  std::string uriToUse = cleanUri;
-
-  if (router) {
-    const LocationBlock *location = router->findLocation(cleanUri);
-    uriToUse = router->getRelativePath(cleanUri, location);
-  }
-
-  std::string filePath = HttpUtils::buildPath(effectiveRoot, uriToUse);
-  return {effectiveRoot, filePath};
+bool MethodHandler::streamsBody(const Request &request,
+                                const RouteContext &route) {
+  if (request.requestLine.method != Method::POST)
+    return false;
+  if (route.route->passesToFastCGI())
+    return route.route->allows(Method::POST);
+  return runsScript(request, route);
 }
 
-std::string
-MethodHandler::handleGet(const Request &request, std::string_view root,
-                         const RequestRouter *router) {
-  auto [effectiveRoot, filePath] = resolvePaths(request, root, router);
-
-  CGIHandler cgiHandler(effectiveRoot);
-  if (cgiHandler.canHandle(filePath)) {
-    std::string relativeUri = HttpUtils::cleanUri(request.requestLine.uri);
-    if (router) {
-      const LocationBlock *location = router->findLocation(request.requestLine.uri);
-      relativeUri = router->getRelativePath(request.requestLine.uri, location);
-    }
-    return cgiHandler.executeCGI(relativeUri, request);
+bool MethodHandler::runsScript(const Request &request,
+                               const RouteContext &route) {
+  Method method = request.requestLine.method;
+  if ((method != Method::GET && method != Method::POST) ||
+      !route.route->allows(method) || route.route->hasRedirection() ||
+      route.route->passesToFastCGI())
+    return false;
+  if (method == Method::POST) {
+    auto contentTypeIt = request.headers.find("Content-Type");
+    if (contentTypeIt != request.headers.end() &&
+        contentTypeIt->second.find("multipart/form-data") != std::string::npos)
+      return false;
   }
-  std::string relativeUri = HttpUtils::cleanUri(request.requestLine.uri);
-  if (router) {
-    const LocationBlock *location = router->findLocation(request.requestLine.uri);
-    relativeUri = router->getRelativePath(request.requestLine.uri, location);
-  }
-  return StaticFileHandler::handleRequest(effectiveRoot, request.requestLine.uri, router);
+  return route.route->cgiInterpreter(route.filePath) != nullptr;
 }
 
-std::string
-MethodHandler::handlePost(const Request &request, std::string_view root,
-                          const RequestRouter *router) {
-  auto [effectiveRoot, filePath] = resolvePaths(request, root, router);
+OutgoingResponse MethodHandler::handleGet(const Request &request,
+                                          const RouteContext &route) {
+  if (const std::string *interpreter =
+          route.route->cgiInterpreter(route.filePath))
+    return CGIHandler::executeCGI(route, request, *interpreter);
+  return StaticFileHandler::handleRequest(request, route);
+}
 
+OutgoingResponse MethodHandler::handlePost(const Request &request,
+                                           const RouteContext &route) {
   auto contentTypeIt = request.headers.find("Content-Type");
   if (contentTypeIt != request.headers.end()) {
     std::string_view contentType = contentTypeIt->second;
 
     if (contentType.find("multipart/form-data") != std::string_view::npos)
-      return handleFileUpload(request, effectiveRoot, contentType, router);
-    CGIHandler cgiHandler(effectiveRoot);
-    if (cgiHandler.canHandle(filePath)) {
-      std::string relativeUri = HttpUtils::cleanUri(request.requestLine.uri);
-      if (router) {
-        const LocationBlock *location = router->findLocation(request.requestLine.uri);
-        relativeUri = router->getRelativePath(request.requestLine.uri, location);
-      }
-      return cgiHandler.executeCGI(relativeUri, request);
-    }
-  }
-  CGIHandler cgiHandler(effectiveRoot);
-  if (cgiHandler.canHandle(filePath)) {
-    std::string relativeUri = HttpUtils::cleanUri(request.requestLine.uri);
-    if (router) {
-      const LocationBlock *location = router->findLocation(request.requestLine.uri);
-      relativeUri = router->getRelativePath(request.requestLine.uri, location);
-    }
-    return cgiHandler.executeCGI(relativeUri, request);
+      return handleFileUpload(request, route, contentType);
   }
-  Logger::logf<LogLevel::INFO>("POST request to static resource: %s", filePath.c_str());
+  if (const std::string *interpreter =
+          route.route->cgiInterpreter(route.filePath))
+    return CGIHandler::executeCGI(route, request, *interpreter);
+  Logger::logf<LogLevel::DEBUG>("POST request to static resource: %s",
+                                route.filePath.c_str());
   return HttpResponse::ok("POST request processed successfully", "text/plain");
 }
 
 std::string
-MethodHandler::handleFileUpload(const Request &request, const std::string &effectiveRoot,
-                               std::string_view contentType, const RequestRouter *router) {
+MethodHandler::handleFileUpload(const Request &request, const RouteContext &route,
+                               std::string_view contentType) {
 
-  std::string uploadPath;
-  if (router) {
-    const LocationBlock *location = router->findLocation(request.requestLine.uri);
-    if (location && location->uploadEnable && !location->uploadStore.empty())
-      uploadPath = location->uploadStore;
-  }
+  std::string uploadPath = route.route->uploadStore;
   if (uploadPath.empty())
-    uploadPath = HttpUtils::buildPath(effectiveRoot, "uploads");
+    uploadPath = HttpUtils::buildPath(route.root, "uploads");
   if (!FileUtils::exists(uploadPath)) {
     if (!FileUtils::createDirectories(uploadPath)) {
       Logger::error("Failed to create upload directory");
@@ -154,42 +121,27 @@ MethodHandler::handleFileUpload(const Request &request, const std::string &effec
     if (!uploadedFiles.empty()) uploadedFiles += ", ";
     uploadedFiles += filename;
 
-    std::ofstream outFile(fullPath, std::ios::binary);
-    if (!outFile.is_open()) {
-      Logger::logf<LogLevel::ERROR>("Failed to open file for writing: %s", fullPath.c_str());
-      return ErrorResponseBuilder::buildResponse(500);
-    }
-
-    outFile.write(file.content.data(), file.content.size());
-    outFile.close();
-
-    if (!outFile.good()) {
+    if (!FileUtils::writeFileContent(fullPath, file.content)) {
       Logger::logf<LogLevel::ERROR>("Failed to write uploaded file: %s", fullPath.c_str());
       return ErrorResponseBuilder::buildResponse(500);
     }
+    FileUtils::invalidateCache(fullPath);
     Logger::logf<LogLevel::INFO>("File uploaded successfully: %s (%zu bytes)",
                                 fullPath.c_str(), file.content.size());
   }
   return HttpResponse::ok("Files uploaded successfully: " + uploadedFiles, "text/plain");
 }
 
-std::string
-MethodHandler::handleDelete(const Request &request, std::string_view root,
-                            const RequestRouter *router) {
-  auto [effectiveRoot, filePath] = resolvePaths(request, root, router);
-
-  std::string relativeUri = HttpUtils::cleanUri(request.requestLine.uri);
-  if (router) {
-    const LocationBlock *location = router->findLocation(request.requestLine.uri);
-    relativeUri = router->getRelativePath(request.requestLine.uri, location);
-  }
-
+std::string MethodHandler::handleDelete(const Request &,
+                                        const RouteContext &route) {
   StatusCode status;
-  bool deleteResult = FileUtils::deleteFile(effectiveRoot, relativeUri, status);
+  bool deleteResult =
+      FileUtils::deleteFile(route.root, route.relativePath, status);
   
   if (!deleteResult)
     return ErrorResponseBuilder::buildResponse(static_cast<int>(status));
   
-  Logger::logf<LogLevel::INFO>("File deleted successfully: %s", filePath.c_str());
+  Logger::logf<LogLevel::INFO>("File deleted successfully: %s",
+                               route.filePath.c_str());
   return HttpResponse::ok("File deleted successfully", "text/plain");
 }
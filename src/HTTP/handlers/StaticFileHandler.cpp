@@ -1,28 +1,41 @@
 #include "HTTP/handlers/StaticFileHandler.hpp"
 #include "HTTP/core/ErrorResponseBuilder.hpp"
 #include "HTTP/core/HttpResponse.hpp"
+#include "HTTP/core/ResponseCache.hpp"
 #include "HTTP/routing/RequestRouter.hpp"
 #include "utils/Logger.hpp"
+#include "utils/NegativeCache.hpp"
+#include "utils/Trace.hpp"
 #include "utils/Utils.hpp"
 #include "utils/ValidationUtils.hpp"
-#include <filesystem>
+
+#include <cerrno>
 
 using HTTP::StatusCode;
 
-std::string StaticFileHandler::handleRequest(std::string_view root,
-                                             std::string_view uri,
-                                             const RequestRouter *router) {
-
-  std::string effectiveRoot = HttpUtils::getEffectiveRoot(root);
-  std::string cleanUri = HttpUtils::cleanUri(uri);
-  std::string originalUri = cleanUri;
-  std::string relativeUri = cleanUri;
-  if (router) {
-    const LocationBlock *location = router->findLocation(cleanUri);
-    relativeUri = router->getRelativePath(cleanUri, location);
+// Only a path that does not exist is a 404 worth remembering; a forbidden
+// file is 403, and running out of descriptors is a passing 503 that must
+// not leave existing files answered as missing.
+static int openErrorStatus(int error) {
+  switch (error) {
+  case ENOENT:
+  case ENOTDIR:
+    return 404;
+  case EACCES:
+    return 403;
+  case EMFILE:
+  case ENFILE:
+    return 503;
+  default:
+    return 500;
   }
+}
 
-  std::string normalizedUri = relativeUri.empty() ? "/" : relativeUri;
+OutgoingResponse StaticFileHandler::handleRequest(const HTTP::Request &request,
+                                                  const RouteContext &route) {
+  std::string_view normalizedUri = route.relativePath;
+  if (normalizedUri.empty())
+    normalizedUri = "/";
   if (normalizedUri.find("../") != std::string::npos ||
       normalizedUri.find("..\\") != std::string::npos ||
       normalizedUri.find("%2e%2e%2f") != std::string::npos ||
@@ -30,66 +43,124 @@ std::string StaticFileHandler::handleRequest(std::string_view root,
       normalizedUri.find("..%2f") != std::string::npos)
     return ErrorResponseBuilder::buildResponse(403);
 
-  std::string filePath = HttpUtils::buildPath(effectiveRoot, normalizedUri);
+  const std::string &filePath = route.filePath;
 
   if (!ValidationUtils::isPathSafe(normalizedUri))
     return ErrorResponseBuilder::buildResponse(403);
-  if (!FileUtils::exists(filePath))
+  Trace::Span span(Trace::FILE);
+  std::string rootKey = FileUtils::normalizePath(route.root);
+  std::string pathKey = FileUtils::normalizePath(filePath);
+  if (NegativeCache::contains(rootKey, pathKey))
     return ErrorResponseBuilder::buildResponse(404);
-  if (std::filesystem::is_directory(filePath))
-    return serveDirectory(filePath, originalUri, router);
-  return serveFile(filePath);
+  OpenFilePtr target = OpenFileCache::lookup(pathKey);
+  if (!target->ok()) {
+    int status = openErrorStatus(target->error);
+    if (status == 404)
+      NegativeCache::insert(rootKey, pathKey);
+    return ErrorResponseBuilder::buildResponse(status);
+  }
+  if (target->isDirectory)
+    return serveDirectory(filePath, request, route);
+  return serveFile(filePath, target, request, route);
 }
 
-std::string StaticFileHandler::serveFile(std::string_view filePath) {
+OutgoingResponse StaticFileHandler::serveFile(std::string_view filePath,
+                                              const OpenFilePtr &target,
+                                              const HTTP::Request &request,
+                                              const RouteContext &route) {
+  std::string etag = HttpUtils::makeETag(target->stamp);
+  std::string lastModified = HttpUtils::formatHttpDate(target->stamp.mtimeSec);
+  std::string notModifiedHeaders = HttpResponse()
+                                       .status(304, "Not Modified")
+                                       .header("ETag", etag)
+                                       .header("Last-Modified", lastModified)
+                                       .cacheableHeaderBlock();
+  bool notModified =
+      HttpUtils::isNotModified(request.headers, etag, target->stamp.mtimeSec);
+
+  // Too big for the content cache: stream it from the cached descriptor.
+  if (target->size > FileUtils::cacheMaxEntrySize()) {
+    if (notModified)
+      return HttpResponse::completeHeaderBlock(notModifiedHeaders);
+    std::string headers = HttpResponse()
+                              .status(200, "OK")
+                              .header("Content-Type",
+                                      FileUtils::getMimeType(filePath))
+                              .header("Content-Length",
+                                      std::to_string(target->size))
+                              .header("ETag", etag)
+                              .header("Last-Modified", lastModified)
+                              .cacheableHeaderBlock();
+    return OutgoingResponse(HttpResponse::completeHeaderBlock(headers), target);
+  }
+
   StatusCode status;
-  std::string content = FileUtils::readFile("", filePath, status);
-  if (status != StatusCode::OK)
+  FileCache::CachedFile file;
+  if (!FileUtils::loadFile(filePath, file, status))
     return ErrorResponseBuilder::buildResponse(static_cast<int>(status));
-  std::string contentType = FileUtils::getMimeType(filePath);
-  return HttpResponse::ok(content, contentType);
-}
-
-std::string StaticFileHandler::serveDirectory(std::string_view dirPath,
-                                              std::string_view requestUri,
-                                              const RequestRouter *router) {
-
-  std::string indexPath = findIndexFile(dirPath, requestUri, router);
 
-  if (!indexPath.empty() && FileUtils::exists(indexPath) && !std::filesystem::is_directory(indexPath))
-    return serveFile(indexPath);
-  if (router) {
-    const LocationBlock *location = router->findLocation(std::string(requestUri));
-    if (location->autoindex)
-      return HttpResponse::directory(dirPath, requestUri);
+  ResponseCache::Entry entry;
+  entry.filePath = FileUtils::normalizePath(filePath);
+  entry.etag = HttpUtils::makeETag(file.stamp);
+  entry.lastModified = file.stamp.mtimeSec;
+  entry.body = file.content;
+  entry.stamp = file.stamp;
+  if (entry.etag != etag) {
+    lastModified = HttpUtils::formatHttpDate(entry.lastModified);
+    notModifiedHeaders = HttpResponse()
+                             .status(304, "Not Modified")
+                             .header("ETag", entry.etag)
+                             .header("Last-Modified", lastModified)
+                             .cacheableHeaderBlock();
+    notModified = HttpUtils::isNotModified(request.headers, entry.etag,
+                                           entry.lastModified);
   }
+  entry.notModifiedHeaders = std::move(notModifiedHeaders);
+  entry.headers = HttpResponse()
+                      .status(200, "OK")
+                      .body(file.content, file.mimeType)
+                      .header("ETag", entry.etag)
+                      .header("Last-Modified", lastModified)
+                      .cacheableHeaderBlock();
+
+  std::string head = HttpResponse::completeHeaderBlock(
+      notModified ? entry.notModifiedHeaders : entry.headers);
+  if (route.server)
+    ResponseCache::store(ResponseCache::makeKey(route, request),
+                         std::move(entry));
+  if (notModified)
+    return OutgoingResponse(std::move(head));
+  return OutgoingResponse(std::move(head), file.content);
+}
+
+OutgoingResponse
+StaticFileHandler::serveDirectory(std::string_view dirPath,
+                                  const HTTP::Request &request,
+                                  const RouteContext &route) {
+  std::string indexPath = findIndexFile(dirPath, route);
+
+  if (!indexPath.empty())
+    return serveFile(indexPath,
+                     OpenFileCache::lookup(FileUtils::normalizePath(indexPath)),
+                     request, route);
+  if (route.route->autoindex)
+    return HttpResponse::directory(dirPath, route.uri).build();
   return ErrorResponseBuilder::buildResponse(404);
 }
 
 std::string StaticFileHandler::findIndexFile(std::string_view dirPath,
-                                             std::string_view requestUri,
-                                             const RequestRouter *router) {
-
-  if (router) {
-    const LocationBlock *location = router->findLocation(std::string(requestUri));
-    std::string configuredIndex = router->getIndexFile(location);
-
-    std::string indexPath = std::string(dirPath) + "/" + configuredIndex;
-
-    if (FileUtils::exists(indexPath) &&
-        !std::filesystem::is_directory(indexPath)) {
-      return indexPath;
-    }
-  }
+                                             const RouteContext &route) {
+  std::string indexPath = std::string(dirPath) + "/" + route.route->index;
+  if (OpenFileCache::lookup(FileUtils::normalizePath(indexPath))->isRegular())
+    return indexPath;
 
   const char *indexFiles[] = {"index.html", "index.htm", nullptr};
   for (const char **indexFile = indexFiles; *indexFile; ++indexFile) {
-    std::string indexPath = std::string(dirPath) + "/" + *indexFile;
+    indexPath = std::string(dirPath) + "/" + *indexFile;
 
-    if (FileUtils::exists(indexPath) &&
-        !std::filesystem::is_directory(indexPath)) {
+    if (OpenFileCache::lookup(FileUtils::normalizePath(indexPath))
+            ->isRegular())
       return indexPath;
-    }
   }
 
   return "";
@@ -0,0 +1,241 @@
+#include "HTTP/routing/RouteTable.hpp"
+#include "utils/Constants.hpp"
+#include "utils/Logger.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+static const std::string DEFAULT_ROOT = "./www";
+static const std::string DEFAULT_INDEX = "index.html";
+
+static uint8_t allMethods() {
+  return Route::methodBit(HTTP::Method::GET) |
+         Route::methodBit(HTTP::Method::POST) |
+         Route::methodBit(HTTP::Method::DELETE);
+}
+
+static void parseRedirection(const std::string &value, Route &route) {
+  route.redirectCode = 302;
+  route.redirectUrl = value;
+
+  size_t spacePos = value.find(' ');
+  if (spacePos == std::string::npos)
+    return;
+  try {
+    int parsedCode = std::stoi(value.substr(0, spacePos));
+    if (parsedCode == 301 || parsedCode == 302 || parsedCode == 303 ||
+        parsedCode == 307 || parsedCode == 308) {
+      route.redirectCode = parsedCode;
+      route.redirectUrl = value.substr(spacePos + 1);
+    }
+  } catch (const std::exception &e) {
+    Logger::logf<LogLevel::ERROR>("Failed to parse redirection code: %s",
+                                  e.what());
+  }
+}
+
+RouteTable::RouteTable(const ServerBlock *config) {
+  _nodes.emplace_back();
+  _default = compile(nullptr, config);
+  if (!config)
+    return;
+
+  std::vector<const LocationBlock *> ordered;
+  for (const auto &entry : config->locations)
+    ordered.push_back(&entry.second);
+  std::sort(ordered.begin(), ordered.end(),
+            [](const LocationBlock *a, const LocationBlock *b) {
+              return a->order < b->order;
+            });
+
+  // Reserved up front: _exact keys point into the stored routes.
+  _routes.reserve(ordered.size());
+  for (const LocationBlock *location : ordered) {
+    _routes.push_back(compile(location, config));
+    int index = static_cast<int>(_routes.size() - 1);
+    const Route &route = _routes.back();
+    switch (route.match) {
+    case LocationMatch::Exact:
+      _exact.emplace(route.path, index);
+      break;
+    case LocationMatch::Regex:
+    case LocationMatch::RegexCaseless: {
+      auto flags = std::regex::ECMAScript | std::regex::optimize;
+      if (route.match == LocationMatch::RegexCaseless)
+        flags |= std::regex::icase;
+      try {
+        _regexes.emplace_back(std::regex(route.path, flags), index);
+      } catch (const std::regex_error &e) {
+        throw std::invalid_argument("Invalid location regex: " + route.path +
+                                    " (" + e.what() + ")");
+      }
+      break;
+    }
+    default:
+      insert(route.path, index);
+    }
+  }
+}
+
+Route RouteTable::compile(const LocationBlock *location,
+                          const ServerBlock *config) const {
+  Route route;
+  route.block = location;
+  route.path = location ? location->path : "/";
+  if (location)
+    route.match = location->match;
+
+  if (location && !location->root.empty())
+    route.root = location->root;
+  else if (config && !config->root.empty())
+    route.root = config->root;
+  else
+    route.root = DEFAULT_ROOT;
+
+  if (location && !location->index.empty())
+    route.index = location->index;
+  else if (config && !config->index.empty())
+    route.index = config->index;
+  else
+    route.index = DEFAULT_INDEX;
+
+  if (location && location->clientMaxBodySize > 0)
+    route.maxBodySize = location->clientMaxBodySize;
+  else if (config && config->clientMaxBodySize > 0)
+    route.maxBodySize = config->clientMaxBodySize;
+  else
+    route.maxBodySize = Constants::MAX_TOTAL_SIZE;
+
+  if (!location || location->allowedMethods.empty()) {
+    route.methods = allMethods();
+  } else {
+    for (const auto &method : location->allowedMethods)
+      route.methods |= Route::methodBit(HTTP::stringToMethod(method));
+  }
+
+  int port = config && !config->listenDirectives.empty()
+                 ? config->listenDirectives.front().second
+                 : 8080;
+  route.cgiEnvironment = {"GATEWAY_INTERFACE=CGI/1.1",
+                          "SERVER_SOFTWARE=webserv/1.0",
+                          "SERVER_PORT=" + std::to_string(port),
+                          // Scripts are addressed by their own path, so
+                          // nothing follows their name.
+                          "PATH_INFO="};
+
+  if (location) {
+    if (!location->redirection.empty())
+      parseRedirection(location->redirection, route);
+    if (location->uploadEnable)
+      route.uploadStore = location->uploadStore;
+    route.cgiHandlers = location->cgiHandlers;
+    if (location->cgiTimeoutMs)
+      route.cgiTimeoutMs = location->cgiTimeoutMs;
+    route.cgiMaxConcurrent = location->cgiMaxConcurrent;
+    route.cgiCache = location->cgiCache;
+    route.cgiCacheValidMs = location->cgiCacheValidMs;
+    route.fastcgiPass = location->fastcgiPass;
+    route.autoindex = location->autoindex;
+    route.stubStatus = location->stubStatus;
+  }
+  return route;
+}
+
+void RouteTable::insert(std::string_view path, int route) {
+  size_t node = 0;
+  while (true) {
+    if (path.empty()) {
+      _nodes[node].route = route;
+      return;
+    }
+
+    size_t next = 0;
+    for (size_t child : _nodes[node].children) {
+      if (_nodes[child].label[0] == path[0]) {
+        next = child;
+        break;
+      }
+    }
+    if (next == 0) {
+      Node leaf;
+      leaf.label = std::string(path);
+      leaf.route = route;
+      _nodes.push_back(std::move(leaf));
+      _nodes[node].children.push_back(_nodes.size() - 1);
+      return;
+    }
+
+    const std::string &label = _nodes[next].label;
+    size_t common = 0;
+    while (common < label.size() && common < path.size() &&
+           label[common] == path[common])
+      ++common;
+
+    if (common < label.size()) {
+      // Split the edge: the shared prefix becomes a new inner node.
+      Node tail;
+      tail.label = label.substr(common);
+      tail.children = std::move(_nodes[next].children);
+      tail.route = _nodes[next].route;
+      _nodes.push_back(std::move(tail));
+      _nodes[next].label.resize(common);
+      _nodes[next].children = {_nodes.size() - 1};
+      _nodes[next].route = -1;
+    }
+    path.remove_prefix(common);
+    node = next;
+  }
+}
+
+const Route &RouteTable::match(std::string_view uri) const {
+  uri = uri.substr(0, uri.find('?'));
+  if (_nodes.empty())
+    return _default;
+
+  if (!_exact.empty()) {
+    auto exact = _exact.find(uri);
+    if (exact != _exact.end())
+      return _routes[exact->second];
+  }
+
+  const Route *prefix = longestPrefix(uri);
+  if (prefix && prefix->match == LocationMatch::PreferentialPrefix)
+    return *prefix;
+  for (const auto &[pattern, route] : _regexes) {
+    if (std::regex_search(uri.begin(), uri.end(), pattern))
+      return _routes[route];
+  }
+  return prefix ? *prefix : _default;
+}
+
+const Route *RouteTable::longestPrefix(std::string_view uri) const {
+  const Route *best = nullptr;
+  size_t node = 0;
+  size_t consumed = 0;
+  while (true) {
+    int route = _nodes[node].route;
+    // A location matches on a segment boundary: "/api" covers "/api" and
+    // "/api/x" but not "/apix"; a path ending in '/' covers anything below.
+    if (route >= 0 &&
+        (consumed == uri.size() || uri[consumed] == '/' ||
+         (consumed > 0 && uri[consumed - 1] == '/')))
+      best = &_routes[route];
+    if (consumed == uri.size())
+      break;
+
+    size_t next = 0;
+    for (size_t child : _nodes[node].children) {
+      if (_nodes[child].label[0] == uri[consumed]) {
+        next = child;
+        break;
+      }
+    }
+    if (next == 0)
+      break;
+    const std::string &label = _nodes[next].label;
+    if (uri.compare(consumed, label.size(), label) != 0)
+      break;
+    consumed += label.size();
+    node = next;
+  }
+  return best;
+}
@@ -25,6 +25,8 @@ void Config::parseFromFile() {
                       std::istreambuf_iterator<char>());
   file.close();
 
+  parseGlobalDirectives(content);
+
   std::vector<std::string> serverBlocks =
       ConfigUtils::extractServerBlocks(content);
   if (serverBlocks.empty()) {
@@ -53,6 +55,21 @@ void Config::parseFromFile() {
       _servers.size());
 }
 
+void Config::parseGlobalDirectives(const std::string &content) {
+  for (const auto &line : ConfigUtils::extractGlobalDirectives(content)) {
+    auto [directive, value] = ConfigUtils::parseDirective(line);
+    if (directive.empty())
+      continue;
+    auto it = _globalHandlers.find(directive);
+    if (it != _globalHandlers.end()) {
+      (this->*(it->second))(value, _global);
+    } else {
+      Logger::logf<LogLevel::WARN>("Unknown global directive: %s",
+                                   directive.c_str());
+    }
+  }
+}
+
 void Config::parseServerBlock(const std::string &content, ServerBlock &server) {
   std::istringstream iss(content);
   std::string line;
@@ -63,18 +80,25 @@ void Config::parseServerBlock(const std::string &content, ServerBlock &server) {
       continue;
 
     if (directive == "location") {
-      std::string locationPath = value;
-      size_t bracePos = locationPath.find('{');
+      // The opening brace is the last one on the line, so a pattern may
+      // not be cut short by a quantifier such as "\d{3}".
+      std::string locationSpec = value;
+      size_t bracePos = locationSpec.rfind('{');
       if (bracePos != std::string::npos)
-        locationPath = locationPath.substr(0, bracePos);
-      locationPath = std::string(HttpUtils::trimWhitespace(locationPath));
+        locationSpec = locationSpec.substr(0, bracePos);
+      locationSpec = std::string(HttpUtils::trimWhitespace(locationSpec));
 
-      if (locationPath.empty() || !ConfigUtils::isValidPath(locationPath))
-        throw std::invalid_argument("Invalid location path: " + locationPath);
+      LocationBlock location;
+      ConfigUtils::parseLocationSpec(locationSpec, location.match,
+                                     location.path);
+      if (location.path.empty() ||
+          (!location.isRegex() && !ConfigUtils::isValidPath(location.path)))
+        throw std::invalid_argument("Invalid location path: " + locationSpec);
+      location.order = server.locations.size();
 
       std::string locationContent = line + "\n";
       int braceCount = 1;
-      while (std::getline(iss, line) && braceCount > 0) {
+      while (braceCount > 0 && std::getline(iss, line)) {
         for (char c : line) {
           if (c == '{')
             braceCount++;
@@ -84,10 +108,9 @@ void Config::parseServerBlock(const std::string &content, ServerBlock &server) {
         if (braceCount > 0)
           locationContent += line + "\n";
       }
-      LocationBlock location;
-      location.path = locationPath;
       parseLocationBlock(locationContent, location);
-      server.locations[locationPath] = location;
+      // Keyed by the full spec so "= /" and "/" can coexist.
+      server.locations[locationSpec] = location;
       continue;
     }
     auto it = _serverHandlers.find(directive);
@@ -117,12 +140,16 @@ void Config::parseLocationBlock(const std::string &content,
     if (it != _locationHandlers.end())
       (this->*(it->second))(value, location);
   }
+  location.cgiHandlers = ConfigUtils::parseCgiHandlers(location.cgiExtensions,
+                                                       location.cgiPaths);
 }
 
 const std::unordered_map<std::string, ServerBlock> &Config::getServers() const {
   return _servers;
 }
 
+const GlobalBlock &Config::getGlobal() const { return _global; }
+
 const ServerBlock *Config::getServer(const std::string &host, int port) const {
   std::string key = host + ":" + std::to_string(port);
   auto it = _servers.find(key);
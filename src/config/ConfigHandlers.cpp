@@ -3,10 +3,44 @@
 #include "utils/ValidationUtils.hpp"
 
 void Config::initializeHandlers() {
+  initializeGlobalHandlers();
   initializeServerHandlers();
   initializeLocationHandlers();
 }
 
+void Config::initializeGlobalHandlers() {
+  _globalHandlers = {
+      {"file_cache_size", &Config::handleFileCacheSize},
+      {"file_cache_max_entry_size", &Config::handleFileCacheMaxEntrySize},
+      {"file_cache_valid", &Config::handleFileCacheValid},
+      {"open_file_cache", &Config::handleOpenFileCache},
+      {"open_file_cache_valid", &Config::handleOpenFileCacheValid},
+      {"open_file_cache_errors", &Config::handleOpenFileCacheErrors},
+      {"response_cache_entries", &Config::handleResponseCacheEntries},
+      {"negative_cache_entries", &Config::handleNegativeCacheEntries},
+      {"negative_cache_valid", &Config::handleNegativeCacheValid},
+      {"warmup", &Config::handleWarmup},
+      {"warmup_background", &Config::handleWarmupBackground},
+      {"warmup_threads", &Config::handleWarmupThreads},
+      {"warmup_max_file_size", &Config::handleWarmupMaxFileSize},
+      {"warmup_budget", &Config::handleWarmupBudget},
+      {"log_async", &Config::handleLogAsync},
+      {"log_buffer", &Config::handleLogBuffer},
+      {"log_flush_interval", &Config::handleLogFlushInterval},
+      {"log_overflow", &Config::handleLogOverflow},
+      {"access_log", &Config::handleAccessLog},
+      {"access_log_buffer", &Config::handleAccessLogBuffer},
+      {"access_log_flush", &Config::handleAccessLogFlush},
+      {"access_log_sample", &Config::handleAccessLogSample},
+      {"server_timing", &Config::handleServerTiming},
+      {"slow_request_log", &Config::handleSlowRequestLog},
+      {"trace_clock", &Config::handleTraceClock},
+      {"cgi_max_concurrent", &Config::handleCgiMaxConcurrent},
+      {"cgi_queue_size", &Config::handleCgiQueueSize},
+      {"cgi_queue_timeout", &Config::handleCgiQueueTimeout},
+      {"cgi_cache_entries", &Config::handleCgiCacheEntries}};
+}
+
 void Config::initializeServerHandlers() {
   _serverHandlers = {
       {"listen", &Config::handleListen},
@@ -24,14 +58,222 @@ void Config::initializeLocationHandlers() {
       {"index", &Config::handleLocationIndex},
       {"methods", &Config::handleMethods},
       {"autoindex", &Config::handleAutoindex},
+      {"stub_status", &Config::handleStubStatus},
       {"upload_store", &Config::handleUploadStore},
       {"upload_enable", &Config::handleUploadEnable},
       {"return", &Config::handleReturn},
       {"cgi_extension", &Config::handleCgiExt},
       {"cgi_path", &Config::handleCgiPath},
+      {"cgi_timeout", &Config::handleCgiTimeout},
+      {"cgi_workers", &Config::handleCgiWorkers},
+      {"cgi_worker_max_requests", &Config::handleCgiWorkerMaxRequests},
+      {"cgi_worker_idle_timeout", &Config::handleCgiWorkerIdleTimeout},
+      {"cgi_max_concurrent", &Config::handleLocationCgiMaxConcurrent},
+      {"cgi_cache", &Config::handleCgiCache},
+      {"cgi_cache_valid", &Config::handleCgiCacheValid},
+      {"fastcgi_pass", &Config::handleFastCGIPass},
       {"client_max_body_size", &Config::handleLocationClientMaxBodySize}};
 }
 
+void Config::handleFileCacheSize(const std::string &value,
+                                 GlobalBlock &global) {
+  global.fileCacheSize = (value == "off") ? 0 : ConfigUtils::parseSize(value);
+}
+
+void Config::handleFileCacheMaxEntrySize(const std::string &value,
+                                         GlobalBlock &global) {
+  global.fileCacheMaxEntrySize = ConfigUtils::parseSize(value);
+}
+
+void Config::handleFileCacheValid(const std::string &value,
+                                  GlobalBlock &global) {
+  global.fileCacheValidMs = ConfigUtils::parseDuration(value);
+}
+
+void Config::handleOpenFileCache(const std::string &value,
+                                 GlobalBlock &global) {
+  try {
+    global.openFileCacheEntries = (value == "off") ? 0 : std::stoul(value);
+  } catch (const std::exception &) {
+    throw std::invalid_argument("Invalid open_file_cache: " + value);
+  }
+}
+
+void Config::handleOpenFileCacheValid(const std::string &value,
+                                      GlobalBlock &global) {
+  global.openFileCacheValidMs = ConfigUtils::parseDuration(value);
+}
+
+void Config::handleOpenFileCacheErrors(const std::string &value,
+                                       GlobalBlock &global) {
+  global.openFileCacheErrors = ConfigUtils::parseBooleanValue(value);
+}
+
+void Config::handleResponseCacheEntries(const std::string &value,
+                                        GlobalBlock &global) {
+  try {
+    global.responseCacheEntries = (value == "off") ? 0 : std::stoul(value);
+  } catch (const std::exception &) {
+    throw std::invalid_argument("Invalid response_cache_entries: " + value);
+  }
+}
+
+void Config::handleNegativeCacheEntries(const std::string &value,
+                                        GlobalBlock &global) {
+  try {
+    global.negativeCacheEntries = (value == "off") ? 0 : std::stoul(value);
+  } catch (const std::exception &) {
+    throw std::invalid_argument("Invalid negative_cache_entries: " + value);
+  }
+}
+
+void Config::handleNegativeCacheValid(const std::string &value,
+                                      GlobalBlock &global) {
+  global.negativeCacheValidMs = ConfigUtils::parseDuration(value);
+}
+
+void Config::handleWarmup(const std::string &value, GlobalBlock &global) {
+  global.warmup = ConfigUtils::parseBooleanValue(value);
+}
+
+void Config::handleWarmupBackground(const std::string &value,
+                                    GlobalBlock &global) {
+  global.warmupBackground = ConfigUtils::parseBooleanValue(value);
+}
+
+void Config::handleWarmupThreads(const std::string &value,
+                                 GlobalBlock &global) {
+  try {
+    global.warmupThreads = std::stoul(value);
+  } catch (const std::exception &) {
+    throw std::invalid_argument("Invalid warmup_threads: " + value);
+  }
+  if (global.warmupThreads == 0)
+    throw std::invalid_argument("warmup_threads must be at least 1");
+}
+
+void Config::handleWarmupMaxFileSize(const std::string &value,
+                                     GlobalBlock &global) {
+  global.warmupMaxFileSize = ConfigUtils::parseSize(value);
+}
+
+void Config::handleWarmupBudget(const std::string &value,
+                                GlobalBlock &global) {
+  global.warmupBudget = ConfigUtils::parseSize(value);
+}
+
+void Config::handleLogAsync(const std::string &value, GlobalBlock &global) {
+  global.logAsync = ConfigUtils::parseBooleanValue(value);
+}
+
+void Config::handleLogBuffer(const std::string &value, GlobalBlock &global) {
+  try {
+    global.logBufferRecords = std::stoul(value);
+  } catch (const std::exception &) {
+    throw std::invalid_argument("Invalid log_buffer: " + value);
+  }
+  if (global.logBufferRecords == 0)
+    throw std::invalid_argument("log_buffer must be at least 1");
+}
+
+void Config::handleLogFlushInterval(const std::string &value,
+                                    GlobalBlock &global) {
+  global.logFlushIntervalMs = ConfigUtils::parseDuration(value);
+}
+
+void Config::handleLogOverflow(const std::string &value, GlobalBlock &global) {
+  if (value == "drop")
+    global.logBlockWhenFull = false;
+  else if (value == "block")
+    global.logBlockWhenFull = true;
+  else
+    throw std::invalid_argument("Invalid log_overflow (drop|block): " + value);
+}
+
+void Config::handleAccessLog(const std::string &value, GlobalBlock &global) {
+  if (value.empty())
+    throw std::invalid_argument("access_log needs a path or off");
+  global.accessLog = (value == "off") ? "" : value;
+}
+
+void Config::handleAccessLogBuffer(const std::string &value,
+                                   GlobalBlock &global) {
+  global.accessLogBuffer = ConfigUtils::parseSize(value);
+}
+
+void Config::handleAccessLogFlush(const std::string &value,
+                                  GlobalBlock &global) {
+  global.accessLogFlushMs = ConfigUtils::parseDuration(value);
+}
+
+void Config::handleAccessLogSample(const std::string &value,
+                                   GlobalBlock &global) {
+  try {
+    global.accessLogSample = std::stoul(value);
+  } catch (const std::exception &) {
+    throw std::invalid_argument("Invalid access_log_sample: " + value);
+  }
+  if (global.accessLogSample == 0)
+    throw std::invalid_argument("access_log_sample must be at least 1");
+}
+
+void Config::handleServerTiming(const std::string &value,
+                                GlobalBlock &global) {
+  global.serverTiming = ConfigUtils::parseBooleanValue(value);
+}
+
+void Config::handleSlowRequestLog(const std::string &value,
+                                  GlobalBlock &global) {
+  global.slowRequestMs =
+      (value == "off") ? 0 : ConfigUtils::parseDuration(value);
+}
+
+void Config::handleTraceClock(const std::string &value, GlobalBlock &global) {
+  if (value == "monotonic")
+    global.traceTsc = false;
+  else if (value == "rdtsc")
+    global.traceTsc = true;
+  else
+    throw std::invalid_argument("Invalid trace_clock (monotonic|rdtsc): " +
+                                value);
+}
+
+void Config::handleCgiMaxConcurrent(const std::string &value,
+                                    GlobalBlock &global) {
+  try {
+    global.cgiMaxConcurrent = (value == "off") ? 0 : std::stoul(value);
+  } catch (const std::exception &) {
+    throw std::invalid_argument("Invalid cgi_max_concurrent: " + value);
+  }
+  if (global.cgiMaxConcurrent == 0 && value != "off")
+    throw std::invalid_argument("cgi_max_concurrent must be at least 1 or off");
+}
+
+void Config::handleCgiQueueSize(const std::string &value,
+                                GlobalBlock &global) {
+  try {
+    global.cgiQueueSize = (value == "off") ? 0 : std::stoul(value);
+  } catch (const std::exception &) {
+    throw std::invalid_argument("Invalid cgi_queue_size: " + value);
+  }
+}
+
+void Config::handleCgiQueueTimeout(const std::string &value,
+                                   GlobalBlock &global) {
+  global.cgiQueueTimeoutMs = ConfigUtils::parseDuration(value);
+  if (global.cgiQueueTimeoutMs == 0)
+    throw std::invalid_argument("Invalid cgi_queue_timeout: " + value);
+}
+
+void Config::handleCgiCacheEntries(const std::string &value,
+                                   GlobalBlock &global) {
+  try {
+    global.cgiCacheEntries = (value == "off") ? 0 : std::stoul(value);
+  } catch (const std::exception &) {
+    throw std::invalid_argument("Invalid cgi_cache_entries: " + value);
+  }
+}
+
 void Config::handleListen(const std::string &value, ServerBlock &server) {
   auto [host, port] = ConfigUtils::parseListenDirective(value);
   server.listenDirectives.push_back({host, port});
@@ -99,6 +341,11 @@ void Config::handleAutoindex(const std::string &value,
   location.autoindex = ConfigUtils::parseBooleanValue(value);
 }
 
+void Config::handleStubStatus(const std::string &value,
+                              LocationBlock &location) {
+  location.stubStatus = ConfigUtils::parseBooleanValue(value);
+}
+
 void Config::handleUploadStore(const std::string &value,
                                LocationBlock &location) {
   location.uploadStore = value;
@@ -114,11 +361,74 @@ void Config::handleReturn(const std::string &value, LocationBlock &location) {
 }
 
 void Config::handleCgiExt(const std::string &value, LocationBlock &location) {
-  location.cgiExtension = value;
+  location.cgiExtensions = ConfigUtils::parseMultiValue(value);
 }
 
 void Config::handleCgiPath(const std::string &value, LocationBlock &location) {
-  location.cgiPath = value;
+  location.cgiPaths = ConfigUtils::parseMultiValue(value);
+}
+
+void Config::handleCgiTimeout(const std::string &value,
+                              LocationBlock &location) {
+  location.cgiTimeoutMs = ConfigUtils::parseDuration(value);
+  if (location.cgiTimeoutMs == 0)
+    throw std::invalid_argument("Invalid cgi_timeout: " + value);
+}
+
+void Config::handleCgiWorkers(const std::string &value,
+                              LocationBlock &location) {
+  try {
+    location.cgiWorkers = std::stoul(value);
+  } catch (const std::exception &) {
+    throw std::invalid_argument("Invalid cgi_workers: " + value);
+  }
+  if (location.cgiWorkers > Constants::MAX_CGI_WORKERS)
+    throw std::invalid_argument("cgi_workers must be at most " +
+                                std::to_string(Constants::MAX_CGI_WORKERS));
+}
+
+void Config::handleCgiWorkerMaxRequests(const std::string &value,
+                                        LocationBlock &location) {
+  try {
+    location.cgiWorkerMaxRequests = std::stoul(value);
+  } catch (const std::exception &) {
+    throw std::invalid_argument("Invalid cgi_worker_max_requests: " + value);
+  }
+}
+
+void Config::handleCgiWorkerIdleTimeout(const std::string &value,
+                                        LocationBlock &location) {
+  location.cgiWorkerIdleTimeoutMs =
+      value == "off" ? 0 : ConfigUtils::parseDuration(value);
+  if (location.cgiWorkerIdleTimeoutMs == 0 && value != "off")
+    throw std::invalid_argument("Invalid cgi_worker_idle_timeout: " + value);
+}
+
+void Config::handleLocationCgiMaxConcurrent(const std::string &value,
+                                            LocationBlock &location) {
+  try {
+    location.cgiMaxConcurrent = (value == "off") ? 0 : std::stoul(value);
+  } catch (const std::exception &) {
+    throw std::invalid_argument("Invalid cgi_max_concurrent: " + value);
+  }
+  if (location.cgiMaxConcurrent == 0 && value != "off")
+    throw std::invalid_argument("cgi_max_concurrent must be at least 1 or off");
+}
+
+void Config::handleCgiCache(const std::string &value,
+                            LocationBlock &location) {
+  location.cgiCache = ConfigUtils::parseBooleanValue(value);
+}
+
+void Config::handleCgiCacheValid(const std::string &value,
+                                 LocationBlock &location) {
+  location.cgiCacheValidMs =
+      (value == "off") ? 0 : ConfigUtils::parseDuration(value);
+}
+
+void Config::handleFastCGIPass(const std::string &value,
+                               LocationBlock &location) {
+  location.fastcgiPass = ConfigUtils::parseFastCGIAddress(value);
 }
 
 void Config::handleLocationClientMaxBodySize(const std::string &value,
@@ -7,6 +7,8 @@
 #include <sstream>
 #include <stdexcept>
 #include <string_view>
+#include <sys/un.h>
+#include <unistd.h>
 
 std::vector<std::string> ConfigUtils::splitWhitespace(const std::string &str) {
   std::vector<std::string> tokens;
@@ -30,7 +32,7 @@ ConfigUtils::extractServerBlocks(const std::string &content) {
       std::string blockContent;
       int braceCount = 1;
 
-      while (std::getline(iss, line) && braceCount > 0) {
+      while (braceCount > 0 && std::getline(iss, line)) {
         for (char c : line) {
           if (c == '{')
             braceCount++;
@@ -46,6 +48,30 @@ ConfigUtils::extractServerBlocks(const std::string &content) {
   return blocks;
 }
 
+std::vector<std::string>
+ConfigUtils::extractGlobalDirectives(const std::string &content) {
+  std::vector<std::string> directives;
+  std::istringstream iss(content);
+  std::string line;
+  int braceCount = 0;
+
+  while (std::getline(iss, line)) {
+    std::string_view trimmed = line;
+    trimmed = HttpUtils::trimWhitespace(trimmed.substr(0, trimmed.find('#')));
+    if (braceCount == 0 && !trimmed.empty() &&
+        trimmed.find('{') == std::string_view::npos &&
+        trimmed.find('}') == std::string_view::npos)
+      directives.push_back(std::string(trimmed));
+    for (char c : trimmed) {
+      if (c == '{')
+        braceCount++;
+      else if (c == '}')
+        braceCount--;
+    }
+  }
+  return directives;
+}
+
 std::pair<std::string, std::string>
 ConfigUtils::parseDirective(const std::string &line) {
   std::string_view trimmed_view = HttpUtils::trimWhitespace(line);
@@ -99,6 +125,31 @@ size_t ConfigUtils::parseSize(const std::string &value) {
   }
 }
 
+// Parses "250ms", "5s", "2m" or a bare number of seconds into milliseconds.
+size_t ConfigUtils::parseDuration(const std::string &value) {
+  if (value.empty())
+    throw std::invalid_argument("Empty duration value");
+
+  size_t unitPos = value.find_first_not_of("0123456789");
+  std::string numStr = value.substr(0, unitPos);
+  std::string unit = unitPos == std::string::npos ? "s" : value.substr(unitPos);
+  if (numStr.empty())
+    throw std::invalid_argument("Invalid duration format: " + value);
+
+  size_t multiplier;
+  if (unit == "ms")
+    multiplier = 1;
+  else if (unit == "s")
+    multiplier = 1000;
+  else if (unit == "m")
+    multiplier = 60 * 1000;
+  else if (unit == "h")
+    multiplier = 60 * 60 * 1000;
+  else
+    throw std::invalid_argument("Invalid duration unit: " + value);
+  return std::stoull(numStr) * multiplier;
+}
+
 bool ConfigUtils::parseBooleanValue(const std::string &value) {
   std::string lower = value;
   std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
@@ -147,6 +198,28 @@ ConfigUtils::parseListenDirective(const std::string &value) {
   }
 }
 
+std::string ConfigUtils::parseFastCGIAddress(const std::string &value) {
+  if (value.compare(0, 5, "unix:") == 0) {
+    std::string path = value.substr(5);
+    if (path.empty() || path[0] != '/' ||
+        path.size() >= sizeof(sockaddr_un::sun_path))
+      throw std::invalid_argument("Invalid fastcgi_pass: " + value);
+    return value;
+  }
+  size_t colon = value.rfind(':');
+  if (colon == std::string::npos)
+    throw std::invalid_argument("Invalid fastcgi_pass: " + value);
+  std::string host = value.substr(0, colon);
+  std::string port = value.substr(colon + 1);
+  if (host == "localhost")
+    host = "127.0.0.1";
+  if (!isValidIPv4(host) || port.empty() || port.size() > 5 ||
+      port.find_first_not_of("0123456789") != std::string::npos ||
+      std::stoi(port) < 1 || std::stoi(port) > 65535)
+    throw std::invalid_argument("Invalid fastcgi_pass: " + value);
+  return host + ":" + port;
+}
+
 std::map<int, std::string>
 ConfigUtils::parseErrorPages(const std::string &value) {
   std::map<int, std::string> errorPages;
@@ -204,6 +277,26 @@ bool ConfigUtils::isValidServerName(const std::string &name) {
   return true;
 }
 
+void ConfigUtils::parseLocationSpec(const std::string &spec,
+                                    LocationMatch &match, std::string &path) {
+  static const std::map<std::string, LocationMatch> modifiers = {
+      {"=", LocationMatch::Exact},
+      {"^~", LocationMatch::PreferentialPrefix},
+      {"~", LocationMatch::Regex},
+      {"~*", LocationMatch::RegexCaseless}};
+
+  match = LocationMatch::Prefix;
+  path = spec;
+  size_t space = spec.find_first_of(" \t");
+  if (space == std::string::npos)
+    return;
+  auto it = modifiers.find(spec.substr(0, space));
+  if (it == modifiers.end())
+    return;
+  match = it->second;
+  path = std::string(HttpUtils::trimWhitespace(spec.substr(space + 1)));
+}
+
 bool ConfigUtils::isValidPath(const std::string &path) {
   if (path.empty())
     return false;
@@ -222,3 +315,32 @@ bool ConfigUtils::isValidPath(const std::string &path) {
   }
   return true;
 }
+
+std::vector<CgiHandler>
+ConfigUtils::parseCgiHandlers(const std::vector<std::string> &extensions,
+                              const std::vector<std::string> &paths) {
+  if (extensions.empty() != paths.empty())
+    throw std::invalid_argument(
+        "cgi_extension and cgi_path must be given together");
+  if (paths.size() != 1 && paths.size() != extensions.size())
+    throw std::invalid_argument(
+        "cgi_path needs one interpreter, or one per cgi_extension");
+
+  std::vector<CgiHandler> handlers;
+  for (size_t i = 0; i < extensions.size(); ++i) {
+    const std::string &extension = extensions[i];
+    const std::string &path = paths.size() == 1 ? paths[0] : paths[i];
+    if (extension.size() < 2 || extension[0] != '.' ||
+        extension.find('/') != std::string::npos)
+      throw std::invalid_argument("Invalid cgi_extension: " + extension);
+    for (const CgiHandler &handler : handlers)
+      if (handler.extension == extension)
+        throw std::invalid_argument("Duplicate cgi_extension: " + extension);
+    if (path.empty() || path[0] != '/')
+      throw std::invalid_argument("cgi_path must be absolute: " + path);
+    if (access(path.c_str(), X_OK) != 0)
+      throw std::invalid_argument("cgi_path is not executable: " + path);
+    handlers.push_back({extension, path});
+  }
+  return handlers;
+}
@@ -0,0 +1,235 @@
+#include "resource/CGICache.hpp"
+#include "utils/Constants.hpp"
+#include "utils/Utils.hpp"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <list>
+#include <sstream>
+#include <strings.h>
+#include <unordered_map>
+
+using Clock = std::chrono::steady_clock;
+
+struct CGICacheSlot {
+  std::string key;
+  std::string headers; // cacheable header block, see HttpResponse
+  FileBufferPtr body;
+  Clock::time_point storedAt;
+  Clock::time_point freshUntil;
+  Clock::time_point staleUntil;
+  bool shared = false; // public or s-maxage: also for Authorization
+};
+
+static std::list<CGICacheSlot> lru;
+static std::unordered_map<std::string_view,
+                          std::list<CGICacheSlot>::iterator>
+    slots;
+static size_t maxEntries = Constants::DEFAULT_CGI_CACHE_ENTRIES;
+static CGICache::Stats counters;
+
+static void eraseSlot(std::list<CGICacheSlot>::iterator it) {
+  slots.erase(it->key);
+  lru.erase(it);
+}
+
+// How long a response may be served fresh, and then stale while it is
+// refreshed, and whether a shared cache may answer requests carrying
+// Authorization with it; false if it must not be kept at all.
+static bool lifetime(const std::map<std::string, std::string> &headers,
+                     size_t defaultValidMs, std::chrono::seconds &fresh,
+                     std::chrono::seconds &stale, bool &shared) {
+  if (HttpUtils::findHeader(headers, "Set-Cookie") ||
+      HttpUtils::findHeader(headers, "Vary"))
+    return false;
+  long maxAge = -1;
+  long sharedMaxAge = -1;
+  long staleWhileRevalidate = 0;
+  if (const std::string *cacheControl =
+          HttpUtils::findHeader(headers, "Cache-Control")) {
+    std::istringstream directives(*cacheControl);
+    std::string directive;
+    while (std::getline(directives, directive, ',')) {
+      std::string token(HttpUtils::trimWhitespace(directive));
+      std::transform(token.begin(), token.end(), token.begin(), ::tolower);
+      if (token.compare(0, 8, "no-store") == 0 ||
+          token.compare(0, 8, "no-cache") == 0 ||
+          token.compare(0, 7, "private") == 0)
+        return false;
+      size_t equals = token.find('=');
+      if (equals == std::string::npos) {
+        if (token == "public")
+          shared = true;
+        continue;
+      }
+      std::string name = token.substr(0, equals);
+      std::string value = token.substr(equals + 1);
+      value.erase(std::remove(value.begin(), value.end(), '"'), value.end());
+      char *end;
+      long seconds = std::strtol(value.c_str(), &end, 10);
+      if (value.empty() || *end || seconds < 0)
+        continue;
+      if (name == "max-age")
+        maxAge = seconds;
+      else if (name == "s-maxage") {
+        sharedMaxAge = seconds;
+        shared = true;
+      }
+      else if (name == "stale-while-revalidate")
+        staleWhileRevalidate = seconds;
+    }
+  }
+
+  long freshSeconds;
+  if (sharedMaxAge >= 0)
+    freshSeconds = sharedMaxAge;
+  else if (maxAge >= 0)
+    freshSeconds = maxAge;
+  else if (const std::string *expires =
+               HttpUtils::findHeader(headers, "Expires")) {
+    time_t expiresAt;
+    if (!HttpUtils::parseHttpDate(*expires, expiresAt))
+      return false; // an invalid date means already expired
+    time_t base = std::time(nullptr);
+    if (const std::string *date = HttpUtils::findHeader(headers, "Date"))
+      HttpUtils::parseHttpDate(*date, base);
+    freshSeconds = static_cast<long>(expiresAt - base);
+  } else
+    freshSeconds = static_cast<long>((defaultValidMs + 999) / 1000);
+  if (freshSeconds <= 0)
+    return false;
+  fresh = std::chrono::seconds(freshSeconds);
+  stale = std::chrono::seconds(staleWhileRevalidate);
+  return true;
+}
+
+void CGICache::configure(size_t newMaxEntries) {
+  maxEntries = newMaxEntries;
+  while (lru.size() > maxEntries)
+    eraseSlot(std::prev(lru.end()));
+}
+
+bool CGICache::enabled() { return maxEntries != 0; }
+
+CGICache::Policy CGICache::policy(const HTTP::Request &request) {
+  Policy policy;
+  if (HttpUtils::findHeader(request.headers, "Cookie")) {
+    policy.usable = false;
+    return policy;
+  }
+  policy.sharedOnly =
+      HttpUtils::findHeader(request.headers, "Authorization") != nullptr;
+  if (const std::string *cacheControl =
+          HttpUtils::findHeader(request.headers, "Cache-Control")) {
+    std::istringstream directives(*cacheControl);
+    std::string directive;
+    while (std::getline(directives, directive, ',')) {
+      std::string token(HttpUtils::trimWhitespace(directive));
+      std::transform(token.begin(), token.end(), token.begin(), ::tolower);
+      if (token == "no-cache")
+        policy.lookup = false;
+    }
+  }
+  return policy;
+}
+
+std::string CGICache::makeKey(const RouteContext &route,
+                              const HTTP::Request &request) {
+  std::ostringstream key;
+  key << route.server << '\n'
+      << HTTP::methodToString(request.requestLine.method) << '\n';
+  auto host = request.headers.find("Host");
+  if (host != request.headers.end()) {
+    std::string lowered = host->second;
+    std::transform(lowered.begin(), lowered.end(), lowered.begin(), ::tolower);
+    key << lowered;
+  }
+  key << '\n' << request.requestLine.uri;
+  return key.str();
+}
+
+CGICache::Result CGICache::lookup(const std::string &key,
+                                  OutgoingResponse &response,
+                                  bool sharedOnly) {
+  auto it = slots.find(key);
+  if (it == slots.end() || (sharedOnly && !it->second->shared)) {
+    ++counters.misses;
+    return MISS;
+  }
+  CGICacheSlot &slot = *it->second;
+  Clock::time_point now = Clock::now();
+  Result result = now < slot.freshUntil ? HIT : STALE;
+  if (result == STALE && now >= slot.staleUntil) {
+    eraseSlot(it->second);
+    ++counters.misses;
+    return MISS;
+  }
+  lru.splice(lru.begin(), lru, it->second);
+  ++(result == HIT ? counters.hits : counters.stale);
+
+  long age =
+      std::chrono::duration_cast<std::chrono::seconds>(now - slot.storedAt)
+          .count();
+  response = OutgoingResponse(
+      HttpResponse::completeHeaderBlock(slot.headers + "Age: " +
+                                        std::to_string(age) + "\r\n"),
+      slot.body);
+  return result;
+}
+
+bool CGICache::store(const std::string &key, int status,
+                     const std::map<std::string, std::string> &headers,
+                     std::string_view body, size_t defaultValidMs,
+                     bool sharedOnly) {
+  std::chrono::seconds fresh;
+  std::chrono::seconds stale;
+  bool shared = false;
+  if (maxEntries == 0 || status != 200 ||
+      body.size() > Constants::CGI_CACHE_MAX_ENTRY ||
+      !lifetime(headers, defaultValidMs, fresh, stale, shared) ||
+      (sharedOnly && !shared)) {
+    ++counters.uncacheable;
+    return false;
+  }
+
+  CGICacheSlot slot;
+  slot.key = key;
+  slot.body = FileBuffer::fromString(std::string(body));
+  HttpResponse response;
+  response.status(status, HTTP::statusToString(status));
+  // Date is added on every hit; the body is framed here.
+  for (const auto &[name, value] : headers)
+    if (strcasecmp(name.c_str(), "Date") != 0 &&
+        strcasecmp(name.c_str(), "Content-Type") != 0 &&
+        strcasecmp(name.c_str(), "Content-Length") != 0)
+      response.header(name, value);
+  const std::string *contentType =
+      HttpUtils::findHeader(headers, "Content-Type");
+  response.body(slot.body, contentType
+                               ? std::string_view(*contentType)
+                               : Constants::CGI_DEFAULT_CONTENT_TYPE);
+  slot.headers = response.cacheableHeaderBlock();
+  slot.storedAt = Clock::now();
+  slot.freshUntil = slot.storedAt + fresh;
+  slot.staleUntil = slot.freshUntil + stale;
+  slot.shared = shared;
+
+  auto existing = slots.find(key);
+  if (existing != slots.end())
+    eraseSlot(existing->second);
+  while (lru.size() >= maxEntries)
+    eraseSlot(std::prev(lru.end()));
+  lru.push_front(std::move(slot));
+  slots[lru.front().key] = lru.begin();
+  ++counters.stores;
+  return true;
+}
+
+void CGICache::noteCollapsed() { ++counters.collapsed; }
+
+CGICache::Stats CGICache::stats() {
+  Stats current = counters;
+  current.entries = lru.size();
+  return current;
+}
@@ -1,9 +1,18 @@
 #include "CGIHandler.hpp"
 #include "HTTP/core/ErrorResponseBuilder.hpp"
 #include "HTTP/core/HttpResponse.hpp"
+#include "resource/CGIProcess.hpp"
+#include "resource/CGIWorkers.hpp"
+#include "server/Metrics.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Trace.hpp"
 #include "utils/Utils.hpp"
+#include <algorithm>
+#include <csignal>
+#include <cstring>
 #include <fcntl.h>
+#include <spawn.h>
+#include <strings.h>
 
 using HTTP::Method;
 using HTTP::methodToString;
@@ -11,215 +20,178 @@ using HTTP::Request;
 using HTTP::StatusCode;
 using HTTP::statusToString;
 
-CGIHandler::CGIHandler(const std::string &root) : _root_directory(root) {
-  Logger::logf<LogLevel::INFO>("CGIHandler initialized with root directory: %s",
-                               root.c_str());
-  registerHandler(".php", "/usr/bin/php");
-  registerHandler(".py", "/usr/bin/python3");
-  registerHandler(".pl", "/usr/bin/perl");
+OutgoingResponse CGIHandler::executeCGI(const RouteContext &route,
+                                        const Request &request,
+                                        const std::string &interpreter) {
+  Metrics::add(Metrics::CGI_EXECUTIONS);
+  OutgoingResponse response =
+      executeScript(route.filePath, interpreter, request, *route.route);
+  if (!response.cgi)
+    Metrics::add(Metrics::CGI_FAILURES);
+  return response;
 }
 
-CGIHandler::~CGIHandler() {}
-
-bool CGIHandler::canHandle(const std::string &filePath) const {
-  size_t dot_pos = filePath.find_last_of('.');
-  if (dot_pos == std::string::npos) {
-    return false;
-  }
-  std::string extension = filePath.substr(dot_pos);
-  return _cgi_handlers.find(extension) != _cgi_handlers.end();
-}
-
-std::string CGIHandler::executeCGI(const std::string &uri,
-                                   const Request &request) {
-  std::string cleanUri = uri;
-  if (!cleanUri.empty() && cleanUri[0] == '/') {
-    cleanUri = cleanUri.substr(1);
-  }
-  std::string filePath = _root_directory;
-  if (!filePath.empty() && filePath.back() != '/') {
-    filePath += "/";
-  }
-  filePath += cleanUri;
-  
-  size_t dot_pos = filePath.find_last_of('.');
-
-  if (dot_pos == std::string::npos)
-    return "";
-  std::string extension = filePath.substr(dot_pos);
-  auto handlerIt = _cgi_handlers.find(extension);
-  if (handlerIt == _cgi_handlers.end())
-    return "";
-
-  return executeScript(filePath, handlerIt->second, request);
-}
-
-std::string CGIHandler::executeScript(const std::string &script_path,
-                                      const std::string &handler_path,
-                                      const Request &request) {
+// Starts the script and returns at once: the response carries the running
+// process, which the server's event loop feeds and reads. A location with
+// cgi_workers hands it to an idle pre-started interpreter instead.
+//
+// Otherwise the interpreter is started with posix_spawn(), which glibc runs
+// as a vfork-style clone that shares the server's memory until the exec, so
+// the cost does not grow with the server's size the way fork()'s page-table
+// copy does. The pipes are close-on-exec, so concurrent children never hold
+// each other's ends open, and the file actions put the child's ends on
+// stdin and stdout; the server's ends are made non-blocking beforehand,
+// which leaves the child's blocking.
+OutgoingResponse CGIHandler::executeScript(const std::string &script_path,
+                                           const std::string &handler_path,
+                                           const Request &request,
+                                           const Route &route) {
+  Trace::Span spawn(Trace::CGI_SPAWN);
+  std::chrono::milliseconds timeout(route.cgiTimeoutMs);
+  // A streamed body has only its first bytes in request.body yet; the
+  // declared length is what the script will read.
+  size_t inputLength = 0;
+  if (request.requestLine.method == Method::POST)
+    inputLength = std::max(request.contentLength, request.body.size());
+  std::vector<std::string> env_vars =
+      requestEnvironment(script_path, request, inputLength);
+  if (std::shared_ptr<CGIOutput> worker = CGIWorkers::start(
+          route.block, handler_path, script_path, route.cgiEnvironment,
+          env_vars,
+          inputLength ? std::string_view(request.body) : std::string_view(),
+          inputLength, timeout))
+    return OutgoingResponse(std::move(worker));
 
   int pipefd[2];
-  if (pipe(pipefd) == -1)
+  if (pipe2(pipefd, O_CLOEXEC) == -1)
     return ErrorResponseBuilder::buildResponse(500);
-
   int input_pipe[2] = {-1, -1};
-  if (request.requestLine.method == Method::POST && !request.body.empty()) {
-    if (pipe(input_pipe) == -1) {
-      close(pipefd[0]);
-      close(pipefd[1]);
-      return ErrorResponseBuilder::buildResponse(500);
-    }
-  }
-
-  pid_t pid = fork();
-  if (pid < 0) {
+  if (inputLength > 0 && pipe2(input_pipe, O_CLOEXEC) == -1) {
     close(pipefd[0]);
     close(pipefd[1]);
-
-    if (input_pipe[0] != -1) {
-      close(input_pipe[0]);
-      close(input_pipe[1]);
-    }
     return ErrorResponseBuilder::buildResponse(500);
   }
-
-  if (pid == 0) {
-    dup2(pipefd[1], STDOUT_FILENO);
-    close(pipefd[0]);
-    close(pipefd[1]);
-
-    if (input_pipe[0] != -1) {
-      dup2(input_pipe[0], STDIN_FILENO);
-      close(input_pipe[0]);
-      close(input_pipe[1]);
-    }
-
-    std::vector<char *> args;
-    args.push_back(const_cast<char *>(handler_path.c_str()));
-    args.push_back(const_cast<char *>(script_path.c_str()));
-    args.push_back(nullptr);
-
-    std::vector<std::string> env_vars;
-    env_vars.emplace_back("GATEWAY_INTERFACE=CGI/1.1");
-    env_vars.emplace_back("REQUEST_METHOD=" +
-                          methodToString(request.requestLine.method));
-    env_vars.emplace_back("SCRIPT_NAME=" + script_path);
-    env_vars.emplace_back("SERVER_PROTOCOL=" + request.requestLine.version);
-    env_vars.emplace_back("SERVER_SOFTWARE=webserv/1.0");
-    
-    // Add missing CGI environment variables
-    std::string serverName = "localhost";
-    if (auto it = request.headers.find("Host"); it != request.headers.end()) {
-      std::string host = it->second;
-      size_t colonPos = host.find(':');
-      serverName = (colonPos != std::string::npos) ? host.substr(0, colonPos) : host;
-    }
-    env_vars.emplace_back("SERVER_NAME=" + serverName);
-    env_vars.emplace_back("SERVER_PORT=8080");
-
-    size_t pos = request.requestLine.uri.find('?');
-    std::string queryStr = (pos != std::string::npos)
-                               ? request.requestLine.uri.substr(pos + 1)
-                               : "";
-    env_vars.emplace_back("QUERY_STRING=" + queryStr);
-    
-    // Set PATH_INFO - for CGI, this should be the path after the script name
-    std::string pathInfo = "";
-    std::string requestUri = request.requestLine.uri;
-    if (pos != std::string::npos) {
-      requestUri = requestUri.substr(0, pos); // Remove query string
-    }
-    
-    // Find the script name in the URI and extract anything after it
-    size_t scriptNameStart = requestUri.find_last_of('/');
-    if (scriptNameStart != std::string::npos) {
-      std::string scriptName = requestUri.substr(scriptNameStart + 1);
-      size_t scriptExtPos = scriptName.find('.');
-      if (scriptExtPos != std::string::npos) {
-        // PATH_INFO is typically empty for simple script calls
-        // but could contain extra path segments in more complex setups
-        pathInfo = ""; // Most cases don't need PATH_INFO
-      }
-    }
-    env_vars.emplace_back("PATH_INFO=" + pathInfo);
-
-    if (auto it = request.headers.find("CONTENT_TYPE");
-        it != request.headers.end())
-      env_vars.emplace_back("CONTENT_TYPE=" + it->second);
-    if (auto it = request.headers.find("CONTENT_LENGTH");
-        it != request.headers.end())
-      env_vars.emplace_back("CONTENT_LENGTH=" + it->second);
-
-    std::vector<char *> envp;
-    for (auto &env : env_vars)
-      envp.push_back(const_cast<char *>(env.c_str()));
-    envp.push_back(nullptr);
-
-    execve(handler_path.c_str(), args.data(), envp.data());
-    _exit(EXIT_FAILURE);
+  auto closePipes = [&]() {
+    for (int fd : {pipefd[0], pipefd[1], input_pipe[0], input_pipe[1]})
+      if (fd != -1)
+        close(fd);
+  };
+  if (fcntl(pipefd[0], F_SETFL, O_NONBLOCK) < 0 ||
+      (input_pipe[1] != -1 && fcntl(input_pipe[1], F_SETFL, O_NONBLOCK) < 0)) {
+    closePipes();
+    return ErrorResponseBuilder::buildResponse(500);
   }
 
-  if (input_pipe[0] != -1) {
-    close(input_pipe[0]);
-    write(input_pipe[1], request.body.c_str(), request.body.size());
-    close(input_pipe[1]);
-  }
-  close(pipefd[1]);
-  std::ostringstream output;
-  char buffer[4096];
-  ssize_t bytesRead;
-  if (fcntl(pipefd[0], F_SETFL, O_NONBLOCK) < 0) {
-    close(pipefd[0]);
-    kill(pid, SIGTERM);
-    waitpid(pid, nullptr, 0);
+  char *args[] = {const_cast<char *>(handler_path.c_str()),
+                  const_cast<char *>(script_path.c_str()), nullptr};
+  std::vector<char *> envp;
+  envp.reserve(route.cgiEnvironment.size() + env_vars.size() + 1);
+  for (const std::string &env : route.cgiEnvironment)
+    envp.push_back(const_cast<char *>(env.c_str()));
+  for (const std::string &env : env_vars)
+    envp.push_back(const_cast<char *>(env.c_str()));
+  envp.push_back(nullptr);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, pipefd[1], STDOUT_FILENO);
+  if (input_pipe[0] != -1)
+    posix_spawn_file_actions_adddup2(&actions, input_pipe[0], STDIN_FILENO);
+  // The server ignores SIGPIPE; scripts get the default back.
+  posix_spawnattr_t attributes;
+  posix_spawnattr_init(&attributes);
+  sigset_t defaults;
+  sigemptyset(&defaults);
+  sigaddset(&defaults, SIGPIPE);
+  posix_spawnattr_setsigdefault(&attributes, &defaults);
+  posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGDEF);
+
+  pid_t pid;
+  int error = posix_spawn(&pid, handler_path.c_str(), &actions, &attributes,
+                          args, envp.data());
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attributes);
+  if (error != 0) {
+    Logger::logf<LogLevel::WARN>("Failed to start %s: %s", handler_path,
+                                 strerror(error));
+    closePipes();
     return ErrorResponseBuilder::buildResponse(500);
   }
-  bytesRead = read(pipefd[0], buffer, sizeof(buffer));
-  if (bytesRead > 0) {
-    output.write(buffer, bytesRead);
-  }
-  int status;
-  int waitResult = waitpid(pid, &status, WNOHANG);
-  
-  if (waitResult == 0) {
-    usleep(100000);
-    waitResult = waitpid(pid, &status, WNOHANG);
-  }
-  
-  if (waitResult > 0) {
-    while ((bytesRead = read(pipefd[0], buffer, sizeof(buffer))) > 0) {
-      output.write(buffer, bytesRead);
-    }
-    close(pipefd[0]);
-    if (WIFEXITED(status) && WEXITSTATUS(status) != 0)
-      return ErrorResponseBuilder::buildResponse(500); 
-    return parseCGIOutput(output.str());
-  }
-  close(pipefd[0]);
-  kill(pid, SIGTERM);
-  waitpid(pid, nullptr, 0);
-  return ErrorResponseBuilder::buildResponse(500);
-}
 
-std::string CGIHandler::parseCGIOutput(const std::string &output) {
-  size_t header_end = output.find("\r\n\r\n");
-  size_t header_separator_len = 4;
+  close(pipefd[1]);
+  if (input_pipe[0] != -1)
+    close(input_pipe[0]);
+  Logger::logf<LogLevel::DEBUG>("CGI started: pid %d for %s", pid,
+                                script_path);
+  return OutgoingResponse(std::make_shared<CGIProcess>(
+      pid, pipefd[0], input_pipe[1],
+      input_pipe[1] != -1 ? request.body : std::string(),
+      input_pipe[1] != -1 ? inputLength : 0, timeout));
+}
 
-  if (header_end == std::string::npos) {
-    header_end = output.find("\n\n");
-    header_separator_len = 2;
-  }
+// The CGI/1.1 meta-variables of a request, as "NAME=value", beyond the
+// ones fixed per location in Route::cgiEnvironment; CONTENT_LENGTH only for
+// a request with a body, and then the decoded length, so chunked bodies
+// get one too.
+std::vector<std::string>
+CGIHandler::requestEnvironment(const std::string &script_path,
+                               const Request &request, size_t contentLength) {
+  std::vector<std::string> env_vars;
+  env_vars.reserve(7);
+  env_vars.emplace_back("REQUEST_METHOD=" +
+                        methodToString(request.requestLine.method));
+  env_vars.emplace_back("SCRIPT_NAME=" + script_path);
+  env_vars.emplace_back("SERVER_PROTOCOL=" + request.requestLine.version);
+
+  std::string_view serverName = "localhost";
+  if (auto it = request.headers.find("Host"); it != request.headers.end())
+    serverName = std::string_view(it->second).substr(0, it->second.find(':'));
+  env_vars.emplace_back("SERVER_NAME=").append(serverName);
+
+  std::string_view uri = request.requestLine.uri;
+  size_t pos = uri.find('?');
+  env_vars.emplace_back("QUERY_STRING=")
+      .append(pos != std::string_view::npos ? uri.substr(pos + 1)
+                                            : std::string_view());
+
+  if (auto it = request.headers.find("Content-Type");
+      it != request.headers.end())
+    env_vars.emplace_back("CONTENT_TYPE=" + it->second);
+  if (contentLength > 0)
+    env_vars.emplace_back("CONTENT_LENGTH=" + std::to_string(contentLength));
+  return env_vars;
+}
 
-  if (header_end == std::string::npos)
-    return ErrorResponseBuilder::buildResponse(500);
+std::vector<std::string>
+CGIHandler::buildEnvironment(const std::string &script_path,
+                             const Request &request, size_t contentLength,
+                             const Route &route) {
+  std::vector<std::string> env_vars = route.cgiEnvironment;
+  std::vector<std::string> perRequest =
+      requestEnvironment(script_path, request, contentLength);
+  env_vars.insert(env_vars.end(), std::make_move_iterator(perRequest.begin()),
+                  std::make_move_iterator(perRequest.end()));
+  return env_vars;
+}
 
-  std::string header_section = output.substr(0, header_end);
-  std::string body = output.substr(header_end + header_separator_len);
+// The header block ends at the first blank line, CRLF or bare LF.
+size_t CGIHandler::findHeaderEnd(std::string_view output,
+                                 size_t &separatorLength) {
+  size_t crlf = output.find("\r\n\r\n");
+  size_t lf = output.find("\n\n");
+  if (lf < crlf) {
+    separatorLength = 2;
+    return lf;
+  }
+  separatorLength = 4;
+  return crlf;
+}
 
-  std::map<std::string, std::string> headers;
-  std::istringstream header_stream(header_section);
+bool CGIHandler::parseCGIHeaders(std::string_view section, int &status,
+                                 std::map<std::string, std::string> &headers) {
+  std::istringstream header_stream{std::string(section)};
   std::string line;
-  StatusCode status_code = StatusCode::OK;
+  status = static_cast<int>(StatusCode::OK);
 
   while (std::getline(header_stream, line)) {
     if (!line.empty() && line.back() == '\r')
@@ -233,35 +205,43 @@ std::string CGIHandler::parseCGIOutput(const std::string &output) {
       value.erase(0, value.find_first_not_of(" \t"));
       if (key == "Status") {
         try {
-          int status_num = std::stoi(value.substr(0, 3));
-          status_code = static_cast<StatusCode>(status_num);
+          status = std::stoi(value.substr(0, 3));
         } catch (...) {
-          return ErrorResponseBuilder::buildResponse(500);
+          return false;
         }
       } else
         headers[key] = value;
     }
   }
-  if (headers.find("Content-Type") == headers.end())
-    headers["Content-Type"] = FileUtils::getMimeType(body);
+  return true;
+}
+
+std::string CGIHandler::parseCGIOutput(const std::string &output) {
+  size_t header_separator_len;
+  size_t header_end = findHeaderEnd(output, header_separator_len);
+  if (header_end == std::string::npos)
+    return ErrorResponseBuilder::buildResponse(500);
 
+  std::map<std::string, std::string> headers;
+  int status_code;
+  if (!parseCGIHeaders(std::string_view(output).substr(0, header_end),
+                       status_code, headers))
+    return ErrorResponseBuilder::buildResponse(500);
+  std::string body = output.substr(header_end + header_separator_len);
+
+  const std::string *contentType =
+      HttpUtils::findHeader(headers, "Content-Type");
   HttpResponse response;
-  response.status(static_cast<int>(status_code), statusToString(status_code))
-      .body(body, headers["Content-Type"]);
+  response.status(status_code, statusToString(status_code))
+      .body(body, contentType ? std::string_view(*contentType)
+                              : Constants::CGI_DEFAULT_CONTENT_TYPE);
+  // The body is framed here, whatever case the script spelled these in.
   for (const auto &header : headers) {
-    if (header.first != "Content-Type") {
+    if (strcasecmp(header.first.c_str(), "Content-Type") != 0 &&
+        strcasecmp(header.first.c_str(), "Content-Length") != 0) {
       response.header(header.first, header.second);
     }
   }
 
   return response.str();
 }
-
-void CGIHandler::registerHandler(const std::string &extension,
-                                 const std::string &handlerPath) {
-  _cgi_handlers[extension] = handlerPath;
-}
-
-void CGIHandler::setRootDirectory(const std::string &root) {
-  _root_directory = root;
-}
@@ -0,0 +1,200 @@
+#include "resource/CGIOutput.hpp"
+#include "HTTP/core/ErrorResponseBuilder.hpp"
+#include "resource/CGIHandler.hpp"
+#include "server/Metrics.hpp"
+#include "utils/Constants.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Utils.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+
+CGIOutput::CGIOutput(std::string name, std::chrono::milliseconds timeout)
+    : _name(std::move(name)), _timeout(timeout),
+      _deadline(std::chrono::steady_clock::now() + timeout) {}
+
+void CGIOutput::receiveOutput(const char *data, size_t size) {
+  if (_streaming) {
+    appendBody(data, size);
+    return;
+  }
+  _output.append(data, size);
+  if (!headerReady() && !_headerInvalid)
+    findHeader();
+}
+
+void CGIOutput::findHeader() {
+  size_t separatorLength;
+  size_t end = CGIHandler::findHeaderEnd(_output, separatorLength);
+  if (end == std::string::npos) {
+    if (_output.size() > Constants::MAX_HEADER_SIZE)
+      _headerInvalid = true;
+    return;
+  }
+  if (!CGIHandler::parseCGIHeaders(std::string_view(_output).substr(0, end),
+                                   _statusCode, _headers)) {
+    _headerInvalid = true;
+    return;
+  }
+  _headerEnd = end;
+  _bodyStart = end + separatorLength;
+}
+
+bool CGIOutput::outputBlocked() const {
+  if (_spliceBlocked)
+    return true;
+  if (_streaming)
+    return _stream.size() - _streamSent >= Constants::CGI_STREAM_BUFFER;
+  return _output.size() >= Constants::CGI_STREAM_BUFFER;
+}
+
+OutgoingResponse CGIOutput::response() const {
+  if (!succeeded() || _headerInvalid) {
+    Logger::logf<LogLevel::WARN>("%s failed (status %d)", _name.c_str(),
+                                 _status);
+    Metrics::add(Metrics::CGI_FAILURES);
+    return ErrorResponseBuilder::buildResponse(_errorStatus);
+  }
+  std::string response = CGIHandler::parseCGIOutput(_output);
+  if (response.compare(0, 10, "HTTP/1.1 5") == 0)
+    Metrics::add(Metrics::CGI_FAILURES);
+  return response;
+}
+
+std::string CGIOutput::beginStream(bool chunked) {
+  std::string_view body = std::string_view(_output).substr(_bodyStart);
+  HttpResponse response;
+  response.status(_statusCode, HTTP::statusToString(_statusCode));
+  for (const auto &[name, value] : _headers)
+    response.header(name, value);
+  if (!HttpUtils::findHeader(_headers, "Content-Type"))
+    response.header("Content-Type", Constants::CGI_DEFAULT_CONTENT_TYPE);
+  const std::string *contentLength =
+      HttpUtils::findHeader(_headers, "Content-Length");
+  _chunked = chunked && !contentLength;
+  if (_chunked)
+    response.header("Transfer-Encoding", "chunked");
+  if (_statusCode >= 500)
+    Metrics::add(Metrics::CGI_FAILURES);
+
+  _streaming = true;
+  if (!_chunked && contentLength) {
+    char *end;
+    unsigned long long length = std::strtoull(contentLength->c_str(), &end, 10);
+    if (!contentLength->empty() && !*end) {
+      _bodyLeft = static_cast<size_t>(length);
+      _bodySized = true;
+    }
+  }
+  if (!body.empty())
+    appendBody(body.data(), body.size());
+  std::string().swap(_output);
+  return response.str();
+}
+
+// A body with a Content-Length stops there, as the splice path does:
+// anything the script writes past it would break the response's framing.
+void CGIOutput::appendBody(const char *data, size_t size) {
+  if (_bodySized) {
+    if (size > _bodyLeft) {
+      if (!_bodyOverrun)
+        Logger::logf<LogLevel::WARN>("%s wrote past its Content-Length, "
+                                     "dropping the excess",
+                                     _name.c_str());
+      _bodyOverrun = true;
+      size = _bodyLeft;
+    }
+    _bodyLeft -= size;
+  }
+  if (_captureLimit) {
+    if (_captured.size() + size <= _captureLimit)
+      _captured.append(data, size);
+    else {
+      _captureLimit = 0;
+      std::string().swap(_captured);
+    }
+  }
+  if (!_chunked) {
+    _stream.append(data, size);
+    return;
+  }
+  char prefix[24];
+  int length = std::snprintf(prefix, sizeof(prefix), "%zx\r\n", size);
+  _stream.append(prefix, static_cast<size_t>(length));
+  _stream.append(data, size);
+  _stream.append("\r\n");
+}
+
+// splice() returns EAGAIN both for an empty pipe and for a full socket;
+// the bytes left in the pipe tell which one to wait for.
+ssize_t CGIOutput::spliceTo(int socketFd) {
+  int pipeFd = splicePipe();
+  size_t moved = 0;
+  _spliceBlocked = false;
+  while (_bodyLeft) {
+    ssize_t spliced =
+        splice(pipeFd, nullptr, socketFd, nullptr,
+               std::min(_bodyLeft, Constants::CGI_STREAM_BUFFER),
+               SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (spliced > 0) {
+      _bodyLeft -= static_cast<size_t>(spliced);
+      moved += static_cast<size_t>(spliced);
+      continue;
+    }
+    if (spliced == 0) {
+      spliceEnded(); // a body shorter than its Content-Length
+      break;
+    }
+    if (errno == EINTR)
+      continue;
+    if (errno != EAGAIN)
+      return -1;
+    int queued = 0;
+    _spliceBlocked = ioctl(pipeFd, FIONREAD, &queued) == 0 && queued > 0;
+    break;
+  }
+  return static_cast<ssize_t>(moved);
+}
+
+bool CGIOutput::completeBody(std::string_view &body) const {
+  if (!finished() || !succeeded() || _headerInvalid || !headerReady())
+    return false;
+  if (!_streaming) {
+    body = std::string_view(_output).substr(_bodyStart);
+    return true;
+  }
+  if (!_captureLimit)
+    return false;
+  body = _captured;
+  return true;
+}
+
+void CGIOutput::endStream() {
+  if (_streamEnded)
+    return;
+  _streamEnded = true;
+  if (succeeded()) {
+    if (_chunked)
+      _stream.append("0\r\n\r\n");
+    return;
+  }
+  Logger::logf<LogLevel::WARN>("%s failed (status %d) after its response "
+                               "started",
+                               _name.c_str(), _status);
+  if (_statusCode < 500)
+    Metrics::add(Metrics::CGI_FAILURES);
+}
+
+void CGIOutput::consume(size_t bytes) {
+  _streamSent += bytes;
+  if (_streamSent == _stream.size()) {
+    _stream.clear();
+    _streamSent = 0;
+  } else if (_streamSent >= Constants::CGI_STREAM_BUFFER / 2) {
+    _stream.erase(0, _streamSent);
+    _streamSent = 0;
+  }
+}
@@ -0,0 +1,154 @@
+#include "resource/CGIProcess.hpp"
+#include "utils/Constants.hpp"
+#include "utils/Logger.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static int openPidFd(pid_t pid) {
+#ifdef SYS_pidfd_open
+  return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+  (void)pid;
+  return -1;
+#endif
+}
+
+CGIProcess::CGIProcess(pid_t pid, int stdoutFd, int stdinFd, std::string input,
+                       size_t inputLength, std::chrono::milliseconds timeout)
+    : CGIOutput("CGI pid " + std::to_string(pid), timeout), _pid(pid),
+      _pidFd(openPidFd(pid)), _stdoutFd(stdoutFd), _stdinFd(stdinFd),
+      _input(std::move(input)), _inputLeft(inputLength) {
+  if (_pidFd < 0)
+    Logger::logf<LogLevel::DEBUG>("pidfd_open failed for pid %d: %s", pid,
+                                  strerror(errno));
+}
+
+CGIProcess::~CGIProcess() {
+  closeFd(_stdinFd);
+  closeFd(_stdoutFd);
+  closeFd(_pidFd);
+  if (!_exited) {
+    kill(_pid, SIGKILL);
+    waitpid(_pid, nullptr, 0);
+  }
+}
+
+void CGIProcess::closeFd(int &fd) {
+  if (fd >= 0)
+    close(fd);
+  fd = -1;
+}
+
+bool CGIProcess::writeInput() {
+  while (_inputSent < _input.size()) {
+    ssize_t written = write(_stdinFd, _input.data() + _inputSent,
+                            _input.size() - _inputSent);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return true;
+      // EPIPE: the script exited or closed stdin without reading it all.
+      closeInput();
+      return false;
+    }
+    _inputSent += static_cast<size_t>(written);
+    _inputLeft -= std::min(_inputLeft, static_cast<size_t>(written));
+  }
+  _input.clear();
+  _inputSent = 0;
+  if (_inputLeft > 0)
+    return true; // the rest of the body is still on its way
+  closeInput();
+  return false;
+}
+
+void CGIProcess::closeInput() {
+  closeFd(_stdinFd);
+  std::string().swap(_input);
+  _inputSent = 0;
+}
+
+void CGIProcess::appendInput(const char *data, size_t size) {
+  if (_stdinFd < 0)
+    return;
+  if (_inputSent >= Constants::CGI_STREAM_BUFFER / 2) {
+    _input.erase(0, _inputSent);
+    _inputSent = 0;
+  }
+  _input.append(data, size);
+}
+
+bool CGIProcess::readOutput() {
+  char buffer[16384];
+  while (true) {
+    if (outputBlocked())
+      return true;
+    ssize_t bytesRead = read(_stdoutFd, buffer, sizeof(buffer));
+    if (bytesRead > 0) {
+      receiveOutput(buffer, static_cast<size_t>(bytesRead));
+      continue;
+    }
+    if (bytesRead < 0 && errno == EINTR)
+      continue;
+    if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return true;
+    break;
+  }
+  closeFd(_stdoutFd);
+  return false;
+}
+
+void CGIProcess::spliceEnded() {
+  closeFd(_stdoutFd);
+  if (_pidFd < 0)
+    reap();
+}
+
+bool CGIProcess::handleEvent(const struct pollfd &pfd) {
+  bool open;
+  if (pfd.fd == _stdinFd) {
+    // POLLERR: the script closed stdin. Reported even while the pipe is not
+    // polled for writing, when there may be nothing to write.
+    if (pfd.revents & POLLERR)
+      closeInput();
+    else
+      writeInput();
+    open = _stdinFd >= 0;
+  } else if (pfd.fd == _stdoutFd)
+    open = readOutput();
+  else
+    open = reap();
+  // Without a pidfd, try to reap as soon as the output ends; onTimer()
+  // retries if the child is not gone yet.
+  if (_stdoutFd < 0 && _pidFd < 0)
+    reap();
+  return open;
+}
+
+bool CGIProcess::onTimer() {
+  return _stdoutFd < 0 && _pidFd < 0 && !_exited && !reap();
+}
+
+bool CGIProcess::reap() {
+  if (_exited)
+    return false;
+  pid_t result = waitpid(_pid, &_status, WNOHANG);
+  if (result == 0)
+    return true;
+  if (result < 0)
+    _status = -1; // already collected elsewhere; treat as a failure
+  _exited = true;
+  closeFd(_pidFd);
+  return false;
+}
+
+bool CGIProcess::succeeded() const {
+  return _exited && _status != -1 && WIFEXITED(_status) &&
+         WEXITSTATUS(_status) == 0;
+}
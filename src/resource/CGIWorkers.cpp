@@ -0,0 +1,505 @@
+#include "resource/CGIWorkers.hpp"
+#include "utils/Logger.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Runs in the interpreter with the socket on descriptor 3 and /dev/null on
+// stdin and stdout. Each script gets the request's environment, sys.argv
+// and sys.path[0] as if started on its own, and sys.stdin/sys.stdout backed
+// by frames; modules it imports stay loaded for the next request.
+static const char PYTHON_BOOTSTRAP[] = R"PY(
+import io, os, runpy, socket, struct, sys, traceback
+
+conn = socket.socket(fileno=3)
+path = sys.path[1:]
+
+def recv_exact(n):
+    data = b""
+    while len(data) < n:
+        chunk = conn.recv(n - len(data))
+        if not chunk:
+            raise EOFError
+        data += chunk
+    return data
+
+def frame():
+    kind, length = struct.unpack(">cI", recv_exact(5))
+    return kind, recv_exact(length)
+
+def send(kind, data=b""):
+    conn.sendall(struct.pack(">cI", kind, len(data)) + data)
+
+class Input(io.RawIOBase):
+    def __init__(self):
+        self.data, self.done = b"", False
+    def readable(self):
+        return True
+    def readinto(self, buffer):
+        while not self.data and not self.done:
+            kind, data = frame()
+            if kind != b"I":
+                raise EOFError
+            self.data, self.done = data, not data
+        n = min(len(buffer), len(self.data))
+        buffer[:n] = self.data[:n]
+        self.data = self.data[n:]
+        return n
+
+class Output(io.RawIOBase):
+    def writable(self):
+        return True
+    def write(self, data):
+        send(b"O", bytes(data))
+        return len(data)
+
+while True:
+    try:
+        kind, data = frame()
+    except EOFError:
+        break
+    script, *env = data.decode("utf-8", "surrogateescape").split("\0")[:-1]
+    os.environ.clear()
+    os.environ.update(entry.split("=", 1) for entry in env)
+    stdin = Input()
+    sys.stdin = io.TextIOWrapper(io.BufferedReader(stdin), encoding="utf-8")
+    sys.stdout = io.TextIOWrapper(io.BufferedWriter(Output(), 65536),
+                                  encoding="utf-8")
+    sys.argv = [script]
+    sys.path = [os.path.dirname(os.path.abspath(script))] + path
+    status = 0
+    try:
+        runpy.run_path(script, run_name="__main__")
+    except SystemExit as e:
+        if isinstance(e.code, int):
+            status = e.code
+        elif e.code is not None:
+            print(e.code, file=sys.stderr)
+            status = 1
+    except BaseException:
+        traceback.print_exc()
+        status = 1
+    try:
+        sys.stdout.flush()
+    except Exception:
+        status = status or 1
+    send(b"X", struct.pack(">i", status))
+    while not stdin.done:
+        stdin.readinto(bytearray(65536))
+)PY";
+
+static const size_t FRAME_HEADER_SIZE = 5;
+
+struct CGIWorkerPool {
+  const LocationBlock *location;
+  std::string interpreter;
+  std::vector<CGIWorker> idle; // most recently used last
+  size_t busy = 0;
+};
+
+static std::map<std::pair<const LocationBlock *, std::string>, CGIWorkerPool>
+    pools;
+static CGIWorkers::Stats counters;
+static std::chrono::steady_clock::time_point lastReap;
+static bool stopping = false;
+
+static void appendFrameHeader(std::string &out, char type, size_t length) {
+  out += type;
+  for (int shift = 24; shift >= 0; shift -= 8)
+    out += static_cast<char>((length >> shift) & 0xff);
+}
+
+static uint32_t readUint32(const char *data) {
+  const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+  return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) |
+         (uint32_t(bytes[2]) << 8) | uint32_t(bytes[3]);
+}
+
+static bool spawn(CGIWorkerPool &pool, CGIWorker &worker) {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0) {
+    Logger::logf<LogLevel::WARN>("CGI worker socketpair failed: %s",
+                                 strerror(errno));
+    return false;
+  }
+  // The child's end goes to descriptor 3; one already there is moved
+  // first, since a dup2() onto itself would keep it close-on-exec.
+  if (fds[1] == 3) {
+    int moved = fcntl(fds[1], F_DUPFD_CLOEXEC, 4);
+    close(fds[1]);
+    fds[1] = moved;
+  }
+  if (fds[1] < 0 || fcntl(fds[0], F_SETFL, O_NONBLOCK) < 0) {
+    close(fds[0]);
+    if (fds[1] >= 0)
+      close(fds[1]);
+    return false;
+  }
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null",
+                                   O_RDWR, 0);
+  posix_spawn_file_actions_adddup2(&actions, STDIN_FILENO, STDOUT_FILENO);
+  posix_spawn_file_actions_adddup2(&actions, fds[1], 3);
+  // Out of the server's process group, so that a terminal's Ctrl-C reaches
+  // the server alone and the workers go when their socket does.
+  posix_spawnattr_t attributes;
+  posix_spawnattr_init(&attributes);
+  sigset_t defaults;
+  sigemptyset(&defaults);
+  sigaddset(&defaults, SIGPIPE);
+  posix_spawnattr_setsigdefault(&attributes, &defaults);
+  posix_spawnattr_setpgroup(&attributes, 0);
+  posix_spawnattr_setflags(&attributes,
+                           POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP);
+
+  char *args[] = {const_cast<char *>(pool.interpreter.c_str()),
+                  const_cast<char *>("-c"),
+                  const_cast<char *>(PYTHON_BOOTSTRAP), nullptr};
+  char *envp[] = {nullptr};
+  pid_t pid;
+  int error = posix_spawn(&pid, pool.interpreter.c_str(), &actions,
+                          &attributes, args, envp);
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attributes);
+  close(fds[1]);
+  if (error != 0) {
+    Logger::logf<LogLevel::WARN>("CGI worker %s failed to start: %s",
+                                 pool.interpreter, strerror(error));
+    close(fds[0]);
+    return false;
+  }
+  worker = CGIWorker();
+  worker.pid = pid;
+  worker.fd = fds[0];
+  worker.idleSince = std::chrono::steady_clock::now();
+  ++counters.spawned;
+  Logger::logf<LogLevel::DEBUG>("CGI worker pid %d started for %s", pid,
+                                pool.interpreter);
+  return true;
+}
+
+static void stopWorker(CGIWorker &worker) {
+  close(worker.fd);
+  kill(worker.pid, SIGKILL);
+  waitpid(worker.pid, nullptr, 0);
+  worker.fd = -1;
+}
+
+// An idle worker has nothing to say; a readable socket means it died or
+// broke the protocol.
+static bool idleAndAlive(const CGIWorker &worker) {
+  struct pollfd pfd = {worker.fd, POLLIN, 0};
+  return poll(&pfd, 1, 0) == 0;
+}
+
+static CGIWorkerPool &poolFor(const LocationBlock *location,
+                              const std::string &interpreter) {
+  CGIWorkerPool &pool = pools[{location, interpreter}];
+  if (!pool.location) {
+    pool.location = location;
+    pool.interpreter = interpreter;
+  }
+  return pool;
+}
+
+bool CGIWorkers::supports(const std::string &interpreter) {
+  size_t slash = interpreter.find_last_of('/');
+  std::string name =
+      slash == std::string::npos ? interpreter : interpreter.substr(slash + 1);
+  return name.compare(0, 6, "python") == 0;
+}
+
+void CGIWorkers::prestart(const LocationBlock &location) {
+  if (location.cgiWorkers == 0)
+    return;
+  for (const CgiHandler &handler : location.cgiHandlers) {
+    if (!supports(handler.interpreter)) {
+      Logger::logf<LogLevel::WARN>(
+          "cgi_workers: %s cannot run as a worker, its scripts keep forking",
+          handler.interpreter);
+      continue;
+    }
+    CGIWorkerPool &pool = poolFor(&location, handler.interpreter);
+    if (!pool.idle.empty())
+      continue; // another extension with the same interpreter
+    while (pool.idle.size() < location.cgiWorkers) {
+      CGIWorker worker;
+      if (!spawn(pool, worker))
+        break;
+      pool.idle.push_back(worker);
+    }
+    Logger::logf<LogLevel::INFO>("CGI workers: %zu x %s for location %s",
+                                 pool.idle.size(), handler.interpreter,
+                                 location.path);
+  }
+}
+
+std::shared_ptr<CGIOutput>
+CGIWorkers::start(const LocationBlock *location,
+                  const std::string &interpreter, const std::string &script,
+                  const std::vector<std::string> &fixedEnv,
+                  const std::vector<std::string> &env, std::string_view input,
+                  size_t inputLength, std::chrono::milliseconds timeout) {
+  if (!location || location->cgiWorkers == 0 || stopping ||
+      !supports(interpreter))
+    return nullptr;
+  CGIWorkerPool &pool = poolFor(location, interpreter);
+
+  CGIWorker worker;
+  while (worker.fd < 0 && !pool.idle.empty()) {
+    worker = pool.idle.back();
+    pool.idle.pop_back();
+    if (!idleAndAlive(worker)) {
+      ++counters.lost;
+      stopWorker(worker);
+    }
+  }
+  if (worker.fd < 0 &&
+      (pool.idle.size() + pool.busy >= location->cgiWorkers ||
+       !spawn(pool, worker)))
+    return nullptr;
+
+  int inputFd = fcntl(worker.fd, F_DUPFD_CLOEXEC, 0);
+  if (inputFd < 0) {
+    pool.idle.push_back(worker);
+    return nullptr;
+  }
+  std::string begin = script;
+  begin += '\0';
+  for (const auto *entries : {&fixedEnv, &env})
+    for (const std::string &entry : *entries) {
+      begin += entry;
+      begin += '\0';
+    }
+  ++pool.busy;
+  ++counters.requests;
+  Logger::logf<LogLevel::DEBUG>("CGI worker pid %d runs %s", worker.pid,
+                                script);
+  return std::make_shared<CGIWorkerRequest>(pool, worker, inputFd,
+                                            std::move(begin), input,
+                                            inputLength, timeout);
+}
+
+void CGIWorkers::release(CGIWorkerPool &pool, CGIWorker worker, bool usable) {
+  --pool.busy;
+  ++worker.served;
+  if (!usable || stopping) {
+    if (!usable)
+      ++counters.lost;
+    stopWorker(worker);
+    return;
+  }
+  size_t maxRequests = pool.location->cgiWorkerMaxRequests;
+  if (maxRequests && worker.served >= maxRequests) {
+    ++counters.retired;
+    stopWorker(worker);
+    if (!spawn(pool, worker))
+      return;
+  }
+  worker.idleSince = std::chrono::steady_clock::now();
+  pool.idle.push_back(worker);
+}
+
+// Once a second at most: idle workers past their location's timeout are
+// stopped, and so are any that died while idle.
+void CGIWorkers::reapIdle(std::chrono::steady_clock::time_point now) {
+  if (now - lastReap < std::chrono::seconds(1))
+    return;
+  lastReap = now;
+  for (auto &[key, pool] : pools) {
+    std::chrono::milliseconds idleTimeout(
+        pool.location->cgiWorkerIdleTimeoutMs);
+    auto keep = std::remove_if(
+        pool.idle.begin(), pool.idle.end(), [&](CGIWorker &worker) {
+          if (!idleAndAlive(worker))
+            ++counters.lost;
+          else if (idleTimeout.count() == 0 ||
+                   now - worker.idleSince < idleTimeout)
+            return false;
+          else
+            ++counters.reaped;
+          stopWorker(worker);
+          return true;
+        });
+    pool.idle.erase(keep, pool.idle.end());
+  }
+}
+
+// Workers still leased are stopped when their requests let go of them.
+void CGIWorkers::stop() {
+  stopping = true;
+  for (auto &[key, pool] : pools) {
+    for (CGIWorker &worker : pool.idle)
+      stopWorker(worker);
+    pool.idle.clear();
+  }
+}
+
+CGIWorkers::Stats CGIWorkers::stats() { return counters; }
+
+CGIWorkerRequest::CGIWorkerRequest(CGIWorkerPool &pool, CGIWorker worker,
+                                   int inputFd, std::string begin,
+                                   std::string_view input, size_t inputLength,
+                                   std::chrono::milliseconds timeout)
+    : CGIOutput("CGI worker pid " + std::to_string(worker.pid), timeout),
+      _pool(pool), _worker(worker), _inputFd(inputFd),
+      _inputLeft(inputLength) {
+  queueFrame('B', begin.data(), begin.size());
+  appendInput(input.data(), input.size());
+  if (!_inputQueued && _inputLeft == 0) {
+    queueFrame('I', nullptr, 0);
+    _inputQueued = true;
+  }
+}
+
+CGIWorkerRequest::~CGIWorkerRequest() {
+  if (_inputFd >= 0)
+    close(_inputFd);
+  CGIWorkers::release(_pool, _worker, _usable && _ended && _inputDone);
+}
+
+void CGIWorkerRequest::queueFrame(char type, const char *data, size_t size) {
+  if (_outSent >= Constants::CGI_STREAM_BUFFER / 2) {
+    _out.erase(0, _outSent);
+    _outSent = 0;
+  }
+  appendFrameHeader(_out, type, size);
+  _out.append(data, size);
+}
+
+void CGIWorkerRequest::appendInput(const char *data, size_t size) {
+  if (_inputFd < 0 || _inputQueued || _ended || size == 0)
+    return;
+  size = std::min(size, _inputLeft);
+  queueFrame('I', data, size);
+  _inputLeft -= size;
+  if (_inputLeft == 0) {
+    queueFrame('I', nullptr, 0);
+    _inputQueued = true;
+  }
+}
+
+void CGIWorkerRequest::endInput() {
+  if (_inputFd < 0 || _inputQueued || _ended)
+    return;
+  _inputLeft = 0;
+  queueFrame('I', nullptr, 0);
+  _inputQueued = true;
+}
+
+bool CGIWorkerRequest::writeInput() {
+  while (_outSent < _out.size()) {
+    ssize_t written =
+        write(_inputFd, _out.data() + _outSent, _out.size() - _outSent);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return true;
+      closeInput(); // the worker is gone; its socket reports that too
+      return false;
+    }
+    _outSent += static_cast<size_t>(written);
+  }
+  _out.clear();
+  _outSent = 0;
+  if (!_inputQueued)
+    return true;
+  _inputDone = true;
+  closeInput();
+  return false;
+}
+
+void CGIWorkerRequest::closeInput() {
+  close(_inputFd);
+  _inputFd = -1;
+  std::string().swap(_out);
+  _outSent = 0;
+}
+
+bool CGIWorkerRequest::readOutput() {
+  char buffer[16384];
+  while (!_ended) {
+    if (outputBlocked())
+      return true;
+    ssize_t bytesRead = read(_worker.fd, buffer, sizeof(buffer));
+    if (bytesRead > 0) {
+      receive(buffer, static_cast<size_t>(bytesRead));
+      continue;
+    }
+    if (bytesRead < 0 && errno == EINTR)
+      continue;
+    if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return true;
+    Logger::logf<LogLevel::WARN>("CGI worker pid %d exited mid-request",
+                                 _worker.pid);
+    fail();
+  }
+  return false;
+}
+
+void CGIWorkerRequest::receive(const char *data, size_t size) {
+  while (size > 0) {
+    if (_ended) {
+      _usable = false; // nothing may follow the exit status
+      return;
+    }
+    if (_frameType == 'O') {
+      size_t length = std::min(size, _frameLeft);
+      receiveOutput(data, length);
+      data += length;
+      size -= length;
+      if ((_frameLeft -= length) == 0)
+        _frameType = 0;
+      continue;
+    }
+    size_t want = _frameType ? _frameLeft : FRAME_HEADER_SIZE;
+    size_t length = std::min(size, want - _in.size());
+    _in.append(data, length);
+    data += length;
+    size -= length;
+    if (_in.size() < want)
+      return;
+    if (_frameType == 'X') {
+      _status = static_cast<int32_t>(readUint32(_in.data()));
+      _ended = true;
+    } else {
+      _frameType = _in[0];
+      _frameLeft = readUint32(_in.data() + 1);
+      if (_frameType == 'O' && _frameLeft == 0)
+        _frameType = 0;
+      else if (_frameType != 'O' && (_frameType != 'X' || _frameLeft != 4)) {
+        Logger::logf<LogLevel::WARN>("CGI worker pid %d sent a bad frame",
+                                     _worker.pid);
+        fail();
+      }
+    }
+    _in.clear();
+  }
+}
+
+void CGIWorkerRequest::fail() {
+  _status = -1;
+  _ended = true;
+  _usable = false;
+}
+
+bool CGIWorkerRequest::handleEvent(const struct pollfd &pfd) {
+  if (pfd.fd == _inputFd) {
+    if (pfd.revents & (POLLERR | POLLHUP))
+      closeInput();
+    else
+      writeInput();
+    return _inputFd >= 0;
+  }
+  return readOutput();
+}
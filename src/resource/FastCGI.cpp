@@ -0,0 +1,529 @@
+#include "resource/FastCGI.hpp"
+#include "utils/Constants.hpp"
+#include "utils/Logger.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Record types and fields from the FastCGI 1.0 specification.
+static const uint8_t FCGI_VERSION = 1;
+static const uint8_t FCGI_BEGIN_REQUEST = 1;
+static const uint8_t FCGI_ABORT_REQUEST = 2;
+static const uint8_t FCGI_END_REQUEST = 3;
+static const uint8_t FCGI_PARAMS = 4;
+static const uint8_t FCGI_STDIN = 5;
+static const uint8_t FCGI_STDOUT = 6;
+static const uint8_t FCGI_STDERR = 7;
+static const uint8_t FCGI_GET_VALUES = 9;
+static const uint8_t FCGI_GET_VALUES_RESULT = 10;
+static const uint8_t FCGI_RESPONDER = 1;
+static const uint8_t FCGI_KEEP_CONN = 1;
+static const size_t FCGI_HEADER_SIZE = 8;
+static const size_t FCGI_MAX_CONTENT = 65535;
+
+static void appendLength(std::string &out, size_t length) {
+  if (length < 128) {
+    out += static_cast<char>(length);
+    return;
+  }
+  out += static_cast<char>((length >> 24) | 0x80);
+  out += static_cast<char>(length >> 16);
+  out += static_cast<char>(length >> 8);
+  out += static_cast<char>(length);
+}
+
+static bool readLength(std::string_view data, size_t &pos, size_t &length) {
+  if (pos >= data.size())
+    return false;
+  const unsigned char *bytes =
+      reinterpret_cast<const unsigned char *>(data.data()) + pos;
+  if (bytes[0] < 128) {
+    length = bytes[0];
+    pos += 1;
+    return true;
+  }
+  if (data.size() - pos < 4)
+    return false;
+  length = (static_cast<size_t>(bytes[0] & 0x7f) << 24) |
+           (static_cast<size_t>(bytes[1]) << 16) |
+           (static_cast<size_t>(bytes[2]) << 8) | bytes[3];
+  pos += 4;
+  return true;
+}
+
+static void appendPair(std::string &out, std::string_view name,
+                       std::string_view value) {
+  appendLength(out, name.size());
+  appendLength(out, value.size());
+  out.append(name);
+  out.append(value);
+}
+
+FastCGIRequest::FastCGIRequest(std::string name, size_t inputLength,
+                               std::chrono::milliseconds timeout, int owner)
+    : CGIOutput(std::move(name), timeout), _inputLeft(inputLength),
+      _owner(owner) {
+  _errorStatus = 502;
+}
+
+FastCGIRequest::~FastCGIRequest() {
+  if (_connection)
+    _connection->abort(*this);
+}
+
+void FastCGIRequest::updateFlow() {
+  if (_connection)
+    _connection->updateEvents();
+}
+
+void FastCGIRequest::appendInput(const char *data, size_t size) {
+  if (_connection)
+    _connection->sendInput(*this, data, size);
+}
+
+void FastCGIRequest::endInput() {
+  _inputLeft = 0;
+  if (_connection)
+    _connection->sendInput(*this, nullptr, 0);
+}
+
+bool FastCGIRequest::inputFull() const {
+  return _connection &&
+         _connection->queued() >= Constants::CGI_STREAM_BUFFER;
+}
+
+FastCGIConnection::FastCGIConnection(FastCGIPool &pool, std::string backend,
+                                     int fd, bool connecting)
+    : _pool(pool), _backend(std::move(backend)), _fd(fd),
+      _connecting(connecting),
+      _idleSince(std::chrono::steady_clock::now()) {
+  std::string query;
+  appendPair(query, "FCGI_MPXS_CONNS", "");
+  appendPair(query, "FCGI_MAX_REQS", "");
+  appendRecord(FCGI_GET_VALUES, 0, query.data(), query.size());
+}
+
+// Requests still on the connection are left without one; the pool only
+// drops busy connections when the server shuts down.
+FastCGIConnection::~FastCGIConnection() {
+  for (auto &[id, request] : _requests)
+    if (request)
+      request->_connection = nullptr;
+  ::close(_fd);
+}
+
+void FastCGIConnection::appendRecord(uint8_t type, uint16_t id,
+                                     const char *data, size_t size) {
+  const char header[FCGI_HEADER_SIZE] = {
+      static_cast<char>(FCGI_VERSION), static_cast<char>(type),
+      static_cast<char>(id >> 8),      static_cast<char>(id & 0xff),
+      static_cast<char>(size >> 8),    static_cast<char>(size & 0xff),
+      0,                               0};
+  _out.append(header, sizeof(header));
+  _out.append(data, size);
+}
+
+void FastCGIConnection::begin(FastCGIRequest &request,
+                              const std::vector<std::string> &params,
+                              std::string_view input) {
+  uint16_t id = _nextId;
+  while (id == 0 || _requests.count(id))
+    ++id;
+  _nextId = static_cast<uint16_t>(id + 1);
+  _requests[id] = &request;
+  request._connection = this;
+  request._id = id;
+
+  const char body[8] = {0, static_cast<char>(FCGI_RESPONDER),
+                        static_cast<char>(FCGI_KEEP_CONN)};
+  appendRecord(FCGI_BEGIN_REQUEST, id, body, sizeof(body));
+  // Pairs are not split across records; php-fpm parses each on its own.
+  std::string pairs;
+  for (const std::string &param : params) {
+    size_t separator = param.find('=');
+    if (separator == std::string::npos)
+      continue;
+    std::string pair;
+    appendPair(pair, std::string_view(param).substr(0, separator),
+               std::string_view(param).substr(separator + 1));
+    if (pair.size() > FCGI_MAX_CONTENT)
+      continue;
+    if (pairs.size() + pair.size() > FCGI_MAX_CONTENT) {
+      appendRecord(FCGI_PARAMS, id, pairs.data(), pairs.size());
+      pairs.clear();
+    }
+    pairs += pair;
+  }
+  if (!pairs.empty())
+    appendRecord(FCGI_PARAMS, id, pairs.data(), pairs.size());
+  appendRecord(FCGI_PARAMS, id, nullptr, 0);
+  sendInput(request, input.data(), input.size());
+}
+
+void FastCGIConnection::sendInput(FastCGIRequest &request, const char *data,
+                                  size_t size) {
+  if (request._inputDone)
+    return;
+  size = std::min(size, request._inputLeft);
+  for (size_t pos = 0; pos < size; pos += FCGI_MAX_CONTENT)
+    appendRecord(FCGI_STDIN, request._id, data + pos,
+                 std::min(FCGI_MAX_CONTENT, size - pos));
+  request._inputLeft -= size;
+  if (request._inputLeft == 0) {
+    appendRecord(FCGI_STDIN, request._id, nullptr, 0);
+    request._inputDone = true;
+  }
+  if (!_connecting)
+    flush();
+  updateEvents();
+}
+
+// A backend that does not multiplex has no other way to stop work on a
+// request than losing the connection, which nginx relies on as well.
+void FastCGIConnection::abort(FastCGIRequest &request) {
+  _requests[request._id] = nullptr;
+  request._connection = nullptr;
+  if (_maxRequests == 1) {
+    _pool.close(_fd); // destroys this connection
+    return;
+  }
+  appendRecord(FCGI_ABORT_REQUEST, request._id, nullptr, 0);
+  if (!_connecting)
+    flush();
+  updateEvents();
+}
+
+bool FastCGIConnection::handleEvent(short revents,
+                                    std::vector<int> &progressed) {
+  if (_connecting) {
+    if (!(revents & (POLLOUT | POLLERR | POLLHUP)))
+      return true;
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(_fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0)
+      error = errno;
+    if (error) {
+      Logger::logf<LogLevel::WARN>("FastCGI connect to %s failed: %s",
+                                   _backend.c_str(), strerror(error));
+      fail(progressed);
+      return false;
+    }
+    _connecting = false;
+  }
+  if ((revents & (POLLIN | POLLHUP | POLLERR)) && !receive(progressed)) {
+    fail(progressed);
+    return false;
+  }
+  bool wasFull = queued() >= Constants::CGI_STREAM_BUFFER;
+  if (queued() && !flush()) {
+    fail(progressed);
+    return false;
+  }
+  // Clients held back by a full input queue can send again.
+  if (wasFull && queued() < Constants::CGI_STREAM_BUFFER)
+    for (const auto &[id, request] : _requests)
+      if (request)
+        progressed.push_back(request->owner());
+  updateEvents();
+  return true;
+}
+
+void FastCGIConnection::updateEvents() {
+  short events = 0;
+  if (_connecting || queued())
+    events |= POLLOUT;
+  if (!_connecting && !outputBlocked())
+    events |= POLLIN;
+  _pool._poller->update(_fd, events);
+}
+
+bool FastCGIConnection::outputBlocked() const {
+  for (const auto &[id, request] : _requests)
+    if (request && request->outputBlocked())
+      return true;
+  return false;
+}
+
+bool FastCGIConnection::flush() {
+  while (_outSent < _out.size()) {
+    ssize_t sent = send(_fd, _out.data() + _outSent, _out.size() - _outSent,
+                        MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (sent < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+      return false;
+    }
+    _outSent += static_cast<size_t>(sent);
+  }
+  if (_outSent == _out.size()) {
+    _out.clear();
+    _outSent = 0;
+  } else if (_outSent >= Constants::CGI_STREAM_BUFFER / 2) {
+    _out.erase(0, _outSent);
+    _outSent = 0;
+  }
+  return true;
+}
+
+// Reads and dispatches whole records until the socket is drained or a
+// request's output buffer is full; the rest waits in the socket, which
+// throttles the backend.
+bool FastCGIConnection::receive(std::vector<int> &progressed) {
+  char buffer[16384];
+  while (!outputBlocked()) {
+    ssize_t bytesRead = recv(_fd, buffer, sizeof(buffer), 0);
+    if (bytesRead < 0 && errno == EINTR)
+      continue;
+    if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return true;
+    if (bytesRead <= 0)
+      return false;
+    _in.append(buffer, static_cast<size_t>(bytesRead));
+
+    size_t pos = 0;
+    while (_in.size() - pos >= FCGI_HEADER_SIZE) {
+      const unsigned char *header =
+          reinterpret_cast<const unsigned char *>(_in.data()) + pos;
+      if (header[0] != FCGI_VERSION) {
+        Logger::logf<LogLevel::WARN>("FastCGI %s: bad record version %d",
+                                     _backend.c_str(), header[0]);
+        return false;
+      }
+      size_t contentLength = (static_cast<size_t>(header[4]) << 8) | header[5];
+      size_t recordLength = FCGI_HEADER_SIZE + contentLength + header[6];
+      if (_in.size() - pos < recordLength)
+        break;
+      dispatch(header[1], static_cast<uint16_t>((header[2] << 8) | header[3]),
+               std::string_view(_in).substr(pos + FCGI_HEADER_SIZE,
+                                            contentLength),
+               progressed);
+      pos += recordLength;
+    }
+    _in.erase(0, pos);
+  }
+  return true;
+}
+
+void FastCGIConnection::dispatch(uint8_t type, uint16_t id,
+                                 std::string_view content,
+                                 std::vector<int> &progressed) {
+  if (id == 0) {
+    if (type == FCGI_GET_VALUES_RESULT)
+      readValues(content);
+    return;
+  }
+  auto it = _requests.find(id);
+  if (it == _requests.end())
+    return;
+  FastCGIRequest *request = it->second; // nullptr once aborted
+  if (type == FCGI_STDOUT && request && !content.empty()) {
+    request->receiveOutput(content.data(), content.size());
+    progressed.push_back(request->owner());
+  } else if (type == FCGI_STDERR && !content.empty()) {
+    while (!content.empty() &&
+           (content.back() == '\n' || content.back() == '\r'))
+      content.remove_suffix(1);
+    Logger::logf<LogLevel::WARN>("FastCGI %s: %s", _backend.c_str(),
+                                 std::string(content).c_str());
+  } else if (type == FCGI_END_REQUEST) {
+    if (request) {
+      const unsigned char *body =
+          reinterpret_cast<const unsigned char *>(content.data());
+      int appStatus = -1;
+      if (content.size() >= 5 && body[4] == 0) // FCGI_REQUEST_COMPLETE
+        appStatus = static_cast<int>((static_cast<uint32_t>(body[0]) << 24) |
+                                     (body[1] << 16) | (body[2] << 8) |
+                                     body[3]);
+      else
+        Logger::logf<LogLevel::WARN>(
+            "FastCGI %s rejected request %u (protocol status %d)",
+            _backend.c_str(), id, content.size() >= 5 ? body[4] : -1);
+      request->_status = appStatus;
+      if (appStatus > 0)
+        request->_errorStatus = 500; // the application failed, not the link
+      request->_ended = true;
+      request->_connection = nullptr;
+      progressed.push_back(request->owner());
+    }
+    _requests.erase(it);
+    if (_requests.empty())
+      _idleSince = std::chrono::steady_clock::now();
+  }
+}
+
+void FastCGIConnection::readValues(std::string_view content) {
+  bool multiplexes = false;
+  size_t maxRequests = Constants::FASTCGI_MAX_MULTIPLEX;
+  size_t pos = 0, nameLength, valueLength;
+  while (readLength(content, pos, nameLength) &&
+         readLength(content, pos, valueLength) &&
+         content.size() - pos >= nameLength + valueLength) {
+    std::string_view name = content.substr(pos, nameLength);
+    std::string_view value = content.substr(pos + nameLength, valueLength);
+    pos += nameLength + valueLength;
+    if (name == "FCGI_MPXS_CONNS")
+      multiplexes = value == "1";
+    else if (name == "FCGI_MAX_REQS") {
+      size_t limit = std::strtoul(std::string(value).c_str(), nullptr, 10);
+      if (limit > 0)
+        maxRequests = std::min(maxRequests, limit);
+    }
+  }
+  _maxRequests = multiplexes ? maxRequests : 1;
+  Logger::logf<LogLevel::DEBUG>("FastCGI %s: %zu requests per connection",
+                                _backend.c_str(), _maxRequests);
+}
+
+void FastCGIConnection::fail(std::vector<int> &progressed) {
+  size_t lost = 0;
+  for (auto &[id, request] : _requests) {
+    if (!request)
+      continue;
+    request->_status = -1;
+    request->_ended = true;
+    request->_connection = nullptr;
+    progressed.push_back(request->owner());
+    ++lost;
+  }
+  _requests.clear();
+  if (lost)
+    Logger::logf<LogLevel::WARN>("FastCGI connection to %s lost with %zu "
+                                 "requests in flight",
+                                 _backend.c_str(), lost);
+}
+
+FastCGIPool::~FastCGIPool() {
+  // Connections close their sockets; the poller may already be gone.
+  _connections.clear();
+}
+
+std::shared_ptr<FastCGIRequest>
+FastCGIPool::start(const std::string &backend,
+                   const std::vector<std::string> &params,
+                   std::string_view input, size_t inputLength,
+                   std::chrono::milliseconds timeout, int owner) {
+  FastCGIConnection *connection = nullptr;
+  for (const auto &[fd, candidate] : _connections) {
+    if (candidate->backend() == backend && candidate->hasRoom()) {
+      connection = candidate.get();
+      break;
+    }
+  }
+  if (!connection)
+    connection = connect(backend);
+  if (!connection)
+    return nullptr;
+  auto request = std::make_shared<FastCGIRequest>("FastCGI " + backend,
+                                                  inputLength, timeout, owner);
+  connection->begin(*request, params, input);
+  return request;
+}
+
+// Backends are "unix:/path" or "host:port" with a numeric IPv4 host, as
+// validated by the fastcgi_pass directive.
+FastCGIConnection *FastCGIPool::connect(const std::string &backend) {
+  struct sockaddr_storage address;
+  std::memset(&address, 0, sizeof(address));
+  socklen_t addressLength;
+  if (backend.compare(0, 5, "unix:") == 0) {
+    struct sockaddr_un *unixAddress =
+        reinterpret_cast<struct sockaddr_un *>(&address);
+    unixAddress->sun_family = AF_UNIX;
+    std::strncpy(unixAddress->sun_path, backend.c_str() + 5,
+                 sizeof(unixAddress->sun_path) - 1);
+    addressLength = sizeof(struct sockaddr_un);
+  } else {
+    struct sockaddr_in *inetAddress =
+        reinterpret_cast<struct sockaddr_in *>(&address);
+    size_t colon = backend.rfind(':');
+    inetAddress->sin_family = AF_INET;
+    inetAddress->sin_port = htons(static_cast<uint16_t>(
+        std::strtoul(backend.c_str() + colon + 1, nullptr, 10)));
+    if (colon == std::string::npos ||
+        inet_pton(AF_INET, backend.substr(0, colon).c_str(),
+                  &inetAddress->sin_addr) != 1)
+      return nullptr;
+    addressLength = sizeof(struct sockaddr_in);
+  }
+
+  int fd = socket(address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                  0);
+  if (fd < 0) {
+    Logger::logf<LogLevel::ERROR>("FastCGI socket failed: %s",
+                                  strerror(errno));
+    return nullptr;
+  }
+  if (address.ss_family == AF_INET) {
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  }
+  bool connecting = false;
+  if (::connect(fd, reinterpret_cast<struct sockaddr *>(&address),
+                addressLength) < 0) {
+    connecting = errno == EINPROGRESS;
+    if (!connecting) {
+      Logger::logf<LogLevel::WARN>("FastCGI connect to %s failed: %s",
+                                   backend.c_str(), strerror(errno));
+      ::close(fd);
+      return nullptr;
+    }
+  }
+  Logger::logf<LogLevel::DEBUG>("FastCGI connection to %s opened (fd %d)",
+                                backend.c_str(), fd);
+  auto connection =
+      std::make_unique<FastCGIConnection>(*this, backend, fd, connecting);
+  FastCGIConnection *opened = connection.get();
+  _connections[fd] = std::move(connection);
+  _poller->add(fd, POLLOUT);
+  return opened;
+}
+
+void FastCGIPool::close(int fd) {
+  _poller->remove(fd);
+  _connections.erase(fd);
+}
+
+size_t FastCGIPool::idleCount(const std::string &backend) const {
+  size_t count = 0;
+  for (const auto &[fd, connection] : _connections)
+    if (connection->backend() == backend && connection->idle())
+      ++count;
+  return count;
+}
+
+std::vector<int> FastCGIPool::handleEvent(const struct pollfd &pfd) {
+  std::vector<int> progressed;
+  auto it = _connections.find(pfd.fd);
+  if (it == _connections.end())
+    return progressed;
+  FastCGIConnection &connection = *it->second;
+  if (!connection.handleEvent(pfd.revents, progressed) ||
+      (connection.idle() &&
+       idleCount(connection.backend()) > Constants::FASTCGI_KEEPALIVE))
+    close(pfd.fd);
+  std::sort(progressed.begin(), progressed.end());
+  progressed.erase(std::unique(progressed.begin(), progressed.end()),
+                   progressed.end());
+  return progressed;
+}
+
+void FastCGIPool::closeIdle(std::chrono::steady_clock::time_point now) {
+  const auto limit =
+      std::chrono::milliseconds(Constants::FASTCGI_IDLE_TIMEOUT_MS);
+  for (auto it = _connections.begin(); it != _connections.end();) {
+    FastCGIConnection &connection = *it->second;
+    if (connection.idle() && now - connection.idleSince() > limit) {
+      _poller->remove(it->first);
+      it = _connections.erase(it);
+    } else
+      ++it;
+  }
+}
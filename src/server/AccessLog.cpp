@@ -0,0 +1,95 @@
+#include "server/AccessLog.hpp"
+#include "utils/Logger.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+using AccessClock = std::chrono::steady_clock;
+
+static int logFd = -1;
+static std::string batch;
+static AccessLog::Settings settings;
+static AccessClock::time_point lastFlush;
+static size_t sampleCounter = 0;
+static AccessLog::Stats counters;
+
+bool AccessLog::open(const Settings &newSettings) {
+  close();
+  logFd = ::open(newSettings.path.c_str(),
+                 O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (logFd < 0) {
+    Logger::logf<LogLevel::ERROR>("Cannot open access log %s: %s",
+                                  newSettings.path, std::strerror(errno));
+    return false;
+  }
+  settings = newSettings;
+  if (settings.sampleRate == 0)
+    settings.sampleRate = 1;
+  batch.clear();
+  batch.reserve(settings.bufferSize + AccessLogFormat::RECORD_SIZE +
+                AccessLogFormat::MAX_TARGET);
+  AccessLogFormat::appendHeader(batch,
+                                static_cast<uint32_t>(settings.sampleRate));
+  lastFlush = AccessClock::now();
+  sampleCounter = 0;
+  return true;
+}
+
+void AccessLog::close() {
+  if (logFd < 0)
+    return;
+  flush();
+  ::close(logFd);
+  logFd = -1;
+}
+
+bool AccessLog::enabled() { return logFd >= 0; }
+
+bool AccessLog::sample() {
+  if (logFd < 0)
+    return false;
+  if (sampleCounter++ % settings.sampleRate == 0)
+    return true;
+  ++counters.skipped;
+  return false;
+}
+
+void AccessLog::write(const AccessLogFormat::Record &record) {
+  if (logFd < 0)
+    return;
+  AccessLogFormat::appendRecord(batch, record);
+  ++counters.records;
+  if (batch.size() >= settings.bufferSize)
+    flush();
+}
+
+void AccessLog::tick() {
+  if (logFd >= 0 && !batch.empty() &&
+      AccessClock::now() - lastFlush >=
+          std::chrono::milliseconds(settings.flushIntervalMs))
+    flush();
+}
+
+void AccessLog::flush() {
+  lastFlush = AccessClock::now();
+  size_t offset = 0;
+  while (logFd >= 0 && offset < batch.size()) {
+    ssize_t written =
+        ::write(logFd, batch.data() + offset, batch.size() - offset);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      Logger::logf<LogLevel::ERROR>("Access log write failed: %s",
+                                    std::strerror(errno));
+      break;
+    }
+    offset += static_cast<size_t>(written);
+    ++counters.writes;
+  }
+  counters.bytes += offset;
+  batch.clear();
+}
+
+AccessLog::Stats AccessLog::stats() { return counters; }
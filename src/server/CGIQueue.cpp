@@ -0,0 +1,131 @@
+#include "server/CGIQueue.hpp"
+#include "server/Metrics.hpp"
+#include "server/Server.hpp"
+#include <algorithm>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+struct CGIWaiter {
+  Server *server;
+  int fd;
+  const Route *route;
+  Clock::time_point since;
+};
+
+static CGIQueue::Settings settings;
+static CGIQueue::Stats counters;
+static std::unordered_map<const Route *, size_t> running; // per location
+static std::deque<CGIWaiter> waiters;
+
+static bool hasRoom(const Route *route) {
+  if (settings.maxConcurrent && counters.running >= settings.maxConcurrent)
+    return false;
+  if (!route->cgiMaxConcurrent)
+    return true;
+  auto it = running.find(route);
+  return it == running.end() || it->second < route->cgiMaxConcurrent;
+}
+
+static void take(const Route *route) {
+  ++counters.running;
+  ++counters.admitted;
+  if (route->cgiMaxConcurrent)
+    ++running[route];
+}
+
+static uint64_t waitedUs(const CGIWaiter &waiter, Clock::time_point now) {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(now -
+                                                            waiter.since)
+          .count());
+}
+
+void CGIQueue::configure(const Settings &newSettings) {
+  settings = newSettings;
+}
+
+// A newcomer is started at once only if no waiter could use the slot, so
+// that a slot freed during this round of events goes to the queue first.
+bool CGIQueue::tryAcquire(const Route *route) {
+  if (!hasRoom(route) ||
+      std::any_of(waiters.begin(), waiters.end(),
+                  [](const CGIWaiter &w) { return hasRoom(w.route); }))
+    return false;
+  take(route);
+  return true;
+}
+
+CGIQueue::Admission CGIQueue::acquire(Server *server, int fd,
+                                      const Route *route) {
+  if (tryAcquire(route))
+    return ADMITTED;
+  if (waiters.size() >= settings.queueSize) {
+    ++counters.rejected;
+    return REJECTED;
+  }
+  waiters.push_back({server, fd, route, Clock::now()});
+  ++counters.queued;
+  return QUEUED;
+}
+
+void CGIQueue::release(const Route *route) {
+  if (counters.running)
+    --counters.running;
+  if (!route->cgiMaxConcurrent)
+    return;
+  auto it = running.find(route);
+  if (it != running.end() && --it->second == 0)
+    running.erase(it);
+}
+
+void CGIQueue::cancel(Server *server, int fd) {
+  auto it = std::find_if(waiters.begin(), waiters.end(),
+                         [&](const CGIWaiter &w) {
+                           return w.server == server && w.fd == fd;
+                         });
+  if (it != waiters.end())
+    waiters.erase(it);
+}
+
+// The servers are called after the walk: starting a script may fail and
+// release its slot, or drop the client, either of which reaches back here.
+void CGIQueue::dispatch(Clock::time_point now) {
+  if (waiters.empty())
+    return;
+  std::chrono::milliseconds timeout(settings.queueTimeoutMs);
+  std::vector<CGIWaiter> admitted;
+  std::vector<CGIWaiter> expired;
+  for (auto it = waiters.begin(); it != waiters.end();) {
+    if (hasRoom(it->route)) {
+      take(it->route);
+      admitted.push_back(*it);
+      it = waiters.erase(it);
+    } else if (now - it->since >= timeout) {
+      expired.push_back(*it);
+      it = waiters.erase(it);
+    } else
+      ++it;
+  }
+  for (const CGIWaiter &waiter : admitted) {
+    Metrics::observe(Metrics::CGI_QUEUE, waitedUs(waiter, now));
+    waiter.server->resumeCgi(waiter.fd, waiter.route);
+  }
+  for (const CGIWaiter &waiter : expired) {
+    Metrics::observe(Metrics::CGI_QUEUE, waitedUs(waiter, now));
+    ++counters.timedOut;
+    waiter.server->shedCgi(waiter.fd);
+  }
+}
+
+size_t CGIQueue::retryAfterSeconds() {
+  return std::max<size_t>(1, (settings.queueTimeoutMs + 999) / 1000);
+}
+
+CGIQueue::Stats CGIQueue::stats() {
+  Stats result = counters;
+  result.waiting = waiters.size();
+  return result;
+}
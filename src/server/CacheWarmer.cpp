@@ -0,0 +1,221 @@
+#include "server/CacheWarmer.hpp"
+#include "utils/Constants.hpp"
+#include "utils/Logger.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+using WarmClock = std::chrono::steady_clock;
+
+CacheWarmer::CacheWarmer()
+    : _pendingDirs(0), _runningThreads(0), _reserved(0), _overBudget(0),
+      _stop(false), _active(false), _files(0), _bytes(0) {}
+
+CacheWarmer::~CacheWarmer() { stop(); }
+
+// Nested roots (a location root inside the server root) are walked once.
+static std::vector<std::string>
+distinctRoots(const std::vector<std::string> &roots) {
+  std::vector<std::pair<std::string, std::string>> resolved;
+  for (const auto &root : roots) {
+    std::error_code ec;
+    fs::path canonical = fs::weakly_canonical(root, ec);
+    if (ec || !fs::is_directory(canonical, ec))
+      continue;
+    resolved.emplace_back(canonical.string(), root);
+  }
+  std::sort(resolved.begin(), resolved.end());
+
+  std::vector<std::string> distinct;
+  std::string previous;
+  for (const auto &[canonical, root] : resolved) {
+    if (!previous.empty() &&
+        (canonical == previous ||
+         canonical.compare(0, previous.size() + 1, previous + "/") == 0))
+      continue;
+    previous = canonical;
+    distinct.push_back(root);
+  }
+  return distinct;
+}
+
+void CacheWarmer::start(const std::vector<std::string> &roots,
+                        const Settings &settings) {
+  stop();
+  _settings = settings;
+  _stop = false;
+  _reserved = 0;
+  _overBudget = 0;
+  _files = 0;
+  _bytes = 0;
+  _dirs.clear();
+  _loaded.clear();
+
+  for (const auto &root : distinctRoots(roots)) {
+    Logger::logf<LogLevel::INFO>("Warm-up: scanning %s", root);
+    _dirs.push_back(root);
+  }
+  _pendingDirs = _dirs.size();
+  if (_dirs.empty())
+    return;
+
+  size_t threads = std::max<size_t>(1, _settings.threads);
+  _runningThreads = threads;
+  _active = true;
+  _startedAt = _lastProgress = WarmClock::now();
+  for (size_t i = 0; i < threads; ++i)
+    _threads.emplace_back(&CacheWarmer::work, this);
+}
+
+void CacheWarmer::work() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  for (;;) {
+    _cv.wait(lock, [this] {
+      return _stop || !_dirs.empty() || _pendingDirs == 0;
+    });
+    if (_stop || _dirs.empty())
+      break;
+    std::string dir = std::move(_dirs.front());
+    _dirs.pop_front();
+    lock.unlock();
+
+    std::vector<std::string> subdirs;
+    std::vector<Loaded> loaded;
+    scanDirectory(dir, subdirs, loaded);
+
+    lock.lock();
+    for (auto &subdir : subdirs)
+      _dirs.push_back(std::move(subdir));
+    _pendingDirs += subdirs.size();
+    --_pendingDirs;
+    for (auto &entry : loaded)
+      _loaded.push_back(std::move(entry));
+    if (!subdirs.empty() || _pendingDirs == 0)
+      _cv.notify_all();
+  }
+  --_runningThreads;
+  _cv.notify_all();
+}
+
+void CacheWarmer::scanDirectory(const std::string &dir,
+                                std::vector<std::string> &subdirs,
+                                std::vector<Loaded> &loaded) {
+  std::error_code ec;
+  fs::directory_iterator it(dir, fs::directory_options::skip_permission_denied,
+                            ec);
+  for (; !ec && it != fs::directory_iterator() && !_stop; it.increment(ec)) {
+    const fs::directory_entry &entry = *it;
+    std::error_code entryError;
+    if (entry.is_directory(entryError)) {
+      // Do not follow directory symlinks: they can loop.
+      if (!entry.is_symlink(entryError))
+        subdirs.push_back(entry.path().string());
+      continue;
+    }
+    if (!entry.is_regular_file(entryError))
+      continue;
+
+    std::string path = entry.path().string();
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+    if (fd < 0)
+      continue;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+        static_cast<size_t>(st.st_size) > _settings.maxFileSize) {
+      close(fd);
+      continue;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    if (!reserve(size + Constants::CACHE_ENTRY_OVERHEAD)) {
+      close(fd);
+      ++_overBudget;
+      continue;
+    }
+
+    Loaded file;
+    file.file.content = FileBuffer::fromFd(fd, size, &file.mapError);
+    close(fd);
+    if (!file.file.content)
+      continue;
+    file.file.mimeType = FileUtils::getMimeType(path);
+    file.file.stamp = FileCache::FileStamp::fromStat(st);
+    file.path = std::move(path);
+    loaded.push_back(std::move(file));
+  }
+}
+
+bool CacheWarmer::reserve(size_t bytes) {
+  size_t current = _reserved.load();
+  do {
+    if (current + bytes > _settings.budget)
+      return false;
+  } while (!_reserved.compare_exchange_weak(current, current + bytes));
+  return true;
+}
+
+bool CacheWarmer::drain(std::chrono::milliseconds wait) {
+  if (!_active)
+    return false;
+
+  std::vector<Loaded> batch;
+  bool finished;
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (wait.count() > 0)
+      _cv.wait_for(lock, wait, [this] { return _runningThreads == 0; });
+    finished = _runningThreads == 0;
+    batch.swap(_loaded);
+  }
+
+  for (const auto &entry : batch) {
+    if (entry.mapError)
+      Logger::logf<LogLevel::WARN>("mmap failed for %s, read instead: %s",
+                                   entry.path.c_str(),
+                                   strerror(entry.mapError));
+    FileUtils::preloadFile(entry.path, entry.file);
+    ++_files;
+    _bytes += entry.file.content->size();
+  }
+
+  WarmClock::time_point now = WarmClock::now();
+  if (!finished && now - _lastProgress >= std::chrono::seconds(1)) {
+    _lastProgress = now;
+    Logger::logf<LogLevel::INFO>("Warm-up: %zu files, %zu bytes loaded so far",
+                                 _files, _bytes);
+  }
+  if (finished)
+    finish();
+  return _active;
+}
+
+void CacheWarmer::finish() {
+  for (auto &thread : _threads)
+    thread.join();
+  _threads.clear();
+  _active = false;
+
+  long long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          WarmClock::now() - _startedAt)
+                          .count();
+  Logger::logf<LogLevel::INFO>(
+      "Warm-up %s: %zu files, %zu bytes in %lld ms (%zu skipped over budget)",
+      _stop ? "stopped" : "finished", _files, _bytes, elapsed,
+      _overBudget.load());
+}
+
+void CacheWarmer::stop() {
+  if (!_active)
+    return;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+    _loaded.clear();
+  }
+  _cv.notify_all();
+  finish();
+}
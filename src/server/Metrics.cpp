@@ -0,0 +1,280 @@
+#include "server/Metrics.hpp"
+#include "HTTP/core/ResponseCache.hpp"
+#include "resource/CGICache.hpp"
+#include "server/CGIQueue.hpp"
+#include "utils/NegativeCache.hpp"
+#include "utils/OpenFileCache.hpp"
+#include "utils/Utils.hpp"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+struct Histogram {
+  std::atomic<uint64_t> buckets[Metrics::BUCKETS];
+  std::atomic<uint64_t> count;
+  std::atomic<uint64_t> sum;
+  std::atomic<uint64_t> max;
+};
+
+struct MetricsShard {
+  std::atomic<uint64_t> counters[Metrics::COUNTER_COUNT];
+  Histogram histograms[Metrics::PHASE_COUNT];
+
+  MetricsShard() {
+    for (auto &counter : counters)
+      counter.store(0, std::memory_order_relaxed);
+    for (auto &histogram : histograms) {
+      for (auto &bucket : histogram.buckets)
+        bucket.store(0, std::memory_order_relaxed);
+      histogram.count.store(0, std::memory_order_relaxed);
+      histogram.sum.store(0, std::memory_order_relaxed);
+      histogram.max.store(0, std::memory_order_relaxed);
+    }
+  }
+};
+
+// Shards outlive their threads so a snapshot never reads freed memory.
+static std::mutex shardsMutex;
+static std::vector<std::unique_ptr<MetricsShard>> shards;
+
+static MetricsShard &localShard() {
+  thread_local MetricsShard *shard = [] {
+    std::lock_guard<std::mutex> lock(shardsMutex);
+    shards.push_back(std::make_unique<MetricsShard>());
+    return shards.back().get();
+  }();
+  return *shard;
+}
+
+// Only the owning thread writes a shard, so a relaxed load and store is
+// enough and avoids a locked instruction on the hot path.
+static void bump(std::atomic<uint64_t> &value, uint64_t delta) {
+  value.store(value.load(std::memory_order_relaxed) + delta,
+              std::memory_order_relaxed);
+}
+
+size_t Metrics::bucketIndex(uint64_t micros) {
+  if (micros < SUB_BUCKETS)
+    return static_cast<size_t>(micros);
+  unsigned msb = 63 - static_cast<unsigned>(__builtin_clzll(micros));
+  return (msb - 2) * SUB_BUCKETS + ((micros >> (msb - 3)) & (SUB_BUCKETS - 1));
+}
+
+uint64_t Metrics::bucketUpperBound(size_t index) {
+  if (index < SUB_BUCKETS)
+    return index;
+  unsigned msb = static_cast<unsigned>(index / SUB_BUCKETS) + 2;
+  uint64_t sub = index % SUB_BUCKETS;
+  uint64_t lower = (SUB_BUCKETS + sub) << (msb - 3);
+  return lower + (uint64_t(1) << (msb - 3)) - 1;
+}
+
+void Metrics::add(Counter counter, uint64_t value) {
+  bump(localShard().counters[counter], value);
+}
+
+void Metrics::observe(Phase phase, uint64_t micros) {
+  Histogram &histogram = localShard().histograms[phase];
+  bump(histogram.buckets[bucketIndex(micros)], 1);
+  bump(histogram.count, 1);
+  bump(histogram.sum, micros);
+  if (micros > histogram.max.load(std::memory_order_relaxed))
+    histogram.max.store(micros, std::memory_order_relaxed);
+}
+
+void Metrics::response(int status, uint64_t bytes) {
+  MetricsShard &shard = localShard();
+  bump(shard.counters[REQUESTS], 1);
+  bump(shard.counters[BYTES_SENT], bytes);
+  int statusClass = status / 100;
+  if (statusClass >= 1 && statusClass <= 5)
+    bump(shard.counters[RESPONSES_1XX + statusClass - 1], 1);
+}
+
+struct HistogramSnapshot {
+  uint64_t buckets[Metrics::BUCKETS] = {};
+  uint64_t count = 0;
+  uint64_t sum = 0;
+  uint64_t max = 0;
+
+  uint64_t percentile(double quantile) const {
+    if (count == 0)
+      return 0;
+    uint64_t rank = static_cast<uint64_t>(quantile * count);
+    if (rank == 0)
+      rank = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < Metrics::BUCKETS; ++i) {
+      seen += buckets[i];
+      if (seen >= rank)
+        return std::min(Metrics::bucketUpperBound(i), max);
+    }
+    return max;
+  }
+};
+
+struct MetricsSnapshot {
+  uint64_t counters[Metrics::COUNTER_COUNT] = {};
+  HistogramSnapshot histograms[Metrics::PHASE_COUNT];
+};
+
+static MetricsSnapshot snapshot() {
+  MetricsSnapshot total;
+  std::lock_guard<std::mutex> lock(shardsMutex);
+  for (const auto &shard : shards) {
+    for (size_t i = 0; i < Metrics::COUNTER_COUNT; ++i)
+      total.counters[i] += shard->counters[i].load(std::memory_order_relaxed);
+    for (size_t p = 0; p < Metrics::PHASE_COUNT; ++p) {
+      const Histogram &from = shard->histograms[p];
+      HistogramSnapshot &to = total.histograms[p];
+      for (size_t i = 0; i < Metrics::BUCKETS; ++i)
+        to.buckets[i] += from.buckets[i].load(std::memory_order_relaxed);
+      to.count += from.count.load(std::memory_order_relaxed);
+      to.sum += from.sum.load(std::memory_order_relaxed);
+      to.max = std::max(to.max, from.max.load(std::memory_order_relaxed));
+    }
+  }
+  return total;
+}
+
+static const char *const PHASE_NAMES[Metrics::PHASE_COUNT] = {
+    "first_byte", "parse", "handler", "send", "cgi_queue"};
+
+// Prometheus buckets: powers of two from 1us to ~67s.
+static const size_t PROMETHEUS_BUCKETS = 27;
+
+struct CacheCounters {
+  const char *name;
+  size_t hits;
+  size_t misses;
+};
+
+static std::vector<CacheCounters> cacheCounters() {
+  FileCache::Stats file = FileUtils::cacheStats();
+  OpenFileCache::Stats open = OpenFileCache::stats();
+  ResponseCache::Stats response = ResponseCache::stats();
+  NegativeCache::Stats negative = NegativeCache::stats();
+  CGICache::Stats cgi = CGICache::stats();
+  return {{"file", file.hits, file.misses},
+          {"open_file", open.hits + open.errorHits, open.misses},
+          {"response", response.hits, response.misses},
+          {"negative", negative.hits, negative.misses},
+          {"cgi", cgi.hits + cgi.stale, cgi.misses}};
+}
+
+std::string Metrics::prometheus() {
+  MetricsSnapshot data = snapshot();
+  const uint64_t *c = data.counters;
+  std::ostringstream out;
+
+  out << "# TYPE webserv_requests_total counter\n"
+      << "webserv_requests_total " << c[REQUESTS] << '\n'
+      << "# TYPE webserv_responses_total counter\n";
+  for (int i = 0; i < 5; ++i)
+    out << "webserv_responses_total{code=\"" << i + 1 << "xx\"} "
+        << c[RESPONSES_1XX + i] << '\n';
+  out << "# TYPE webserv_bytes_received_total counter\n"
+      << "webserv_bytes_received_total " << c[BYTES_RECEIVED] << '\n'
+      << "# TYPE webserv_bytes_sent_total counter\n"
+      << "webserv_bytes_sent_total " << c[BYTES_SENT] << '\n'
+      << "# TYPE webserv_connections_accepted_total counter\n"
+      << "webserv_connections_accepted_total " << c[CONNECTIONS_ACCEPTED]
+      << '\n'
+      << "# TYPE webserv_connections_active gauge\n"
+      << "webserv_connections_active "
+      << c[CONNECTIONS_ACCEPTED] - c[CONNECTIONS_CLOSED] << '\n'
+      << "# TYPE webserv_cgi_executions_total counter\n"
+      << "webserv_cgi_executions_total " << c[CGI_EXECUTIONS] << '\n'
+      << "# TYPE webserv_cgi_failures_total counter\n"
+      << "webserv_cgi_failures_total " << c[CGI_FAILURES] << '\n';
+
+  CGIQueue::Stats queue = CGIQueue::stats();
+  out << "# TYPE webserv_cgi_running gauge\n"
+      << "webserv_cgi_running " << queue.running << '\n'
+      << "# TYPE webserv_cgi_queue_depth gauge\n"
+      << "webserv_cgi_queue_depth " << queue.waiting << '\n'
+      << "# TYPE webserv_cgi_queued_total counter\n"
+      << "webserv_cgi_queued_total " << queue.queued << '\n'
+      << "# TYPE webserv_cgi_rejected_total counter\n"
+      << "webserv_cgi_rejected_total{reason=\"queue_full\"} "
+      << queue.rejected << '\n'
+      << "webserv_cgi_rejected_total{reason=\"queue_timeout\"} "
+      << queue.timedOut << '\n';
+
+  out << "# TYPE webserv_cache_hits_total counter\n";
+  std::vector<CacheCounters> caches = cacheCounters();
+  for (const auto &cache : caches)
+    out << "webserv_cache_hits_total{cache=\"" << cache.name << "\"} "
+        << cache.hits << '\n';
+  out << "# TYPE webserv_cache_misses_total counter\n";
+  for (const auto &cache : caches)
+    out << "webserv_cache_misses_total{cache=\"" << cache.name << "\"} "
+        << cache.misses << '\n';
+
+  out << "# TYPE webserv_phase_duration_seconds histogram\n";
+  for (size_t p = 0; p < PHASE_COUNT; ++p) {
+    const HistogramSnapshot &h = data.histograms[p];
+    uint64_t cumulative = 0;
+    size_t bucket = 0;
+    for (size_t k = 0; k < PROMETHEUS_BUCKETS; ++k) {
+      // le is inclusive, so 2^k's own bucket counts too; above 8us that
+      // bucket also holds values up to an eighth past 2^k.
+      size_t limit = bucketIndex(uint64_t(1) << k);
+      for (; bucket <= limit; ++bucket)
+        cumulative += h.buckets[bucket];
+      out << "webserv_phase_duration_seconds_bucket{phase=\"" << PHASE_NAMES[p]
+          << "\",le=\"" << static_cast<double>(uint64_t(1) << k) / 1e6
+          << "\"} " << cumulative << '\n';
+    }
+    out << "webserv_phase_duration_seconds_bucket{phase=\"" << PHASE_NAMES[p]
+        << "\",le=\"+Inf\"} " << h.count << '\n'
+        << "webserv_phase_duration_seconds_sum{phase=\"" << PHASE_NAMES[p]
+        << "\"} " << static_cast<double>(h.sum) / 1e6 << '\n'
+        << "webserv_phase_duration_seconds_count{phase=\"" << PHASE_NAMES[p]
+        << "\"} " << h.count << '\n';
+  }
+  return out.str();
+}
+
+std::string Metrics::json() {
+  MetricsSnapshot data = snapshot();
+  const uint64_t *c = data.counters;
+  std::ostringstream out;
+
+  out << "{\"requests\":" << c[REQUESTS] << ",\"responses\":{";
+  for (int i = 0; i < 5; ++i)
+    out << (i ? "," : "") << '"' << i + 1 << "xx\":" << c[RESPONSES_1XX + i];
+  out << "},\"bytes\":{\"received\":" << c[BYTES_RECEIVED]
+      << ",\"sent\":" << c[BYTES_SENT] << "}"
+      << ",\"connections\":{\"accepted\":" << c[CONNECTIONS_ACCEPTED]
+      << ",\"active\":" << c[CONNECTIONS_ACCEPTED] - c[CONNECTIONS_CLOSED]
+      << "},\"cgi\":{\"executions\":" << c[CGI_EXECUTIONS]
+      << ",\"failures\":" << c[CGI_FAILURES];
+  CGIQueue::Stats queue = CGIQueue::stats();
+  out << ",\"running\":" << queue.running
+      << ",\"queue\":{\"depth\":" << queue.waiting
+      << ",\"queued\":" << queue.queued
+      << ",\"rejected\":" << queue.rejected
+      << ",\"timed_out\":" << queue.timedOut << "}},\"caches\":{";
+  std::vector<CacheCounters> caches = cacheCounters();
+  for (size_t i = 0; i < caches.size(); ++i)
+    out << (i ? "," : "") << '"' << caches[i].name
+        << "\":{\"hits\":" << caches[i].hits
+        << ",\"misses\":" << caches[i].misses << '}';
+  out << "},\"latency_us\":{";
+  for (size_t p = 0; p < PHASE_COUNT; ++p) {
+    const HistogramSnapshot &h = data.histograms[p];
+    out << (p ? "," : "") << '"' << PHASE_NAMES[p] << "\":{\"count\":"
+        << h.count << ",\"sum\":" << h.sum
+        << ",\"p50\":" << h.percentile(0.5)
+        << ",\"p90\":" << h.percentile(0.9)
+        << ",\"p99\":" << h.percentile(0.99)
+        << ",\"p999\":" << h.percentile(0.999) << ",\"max\":" << h.max
+        << '}';
+  }
+  out << "}}\n";
+  return out.str();
+}
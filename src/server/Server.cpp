@@ -2,21 +2,31 @@
 #include <arpa/inet.h>
 #include <atomic>
 #include <cerrno>
+#include <cstdlib>
 #include <cstring>
 #include <ctime>
 #include <fcntl.h>
+#include <filesystem>
 #include <netinet/in.h>
 #include <stdexcept>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "HTTP/core/ErrorResponseBuilder.hpp"
 #include "HTTP/core/HTTPParser.hpp"
 #include "HTTP/core/HttpResponse.hpp"
+#include "HTTP/core/ResponseCache.hpp"
 #include "HTTP/handlers/MethodDispatcher.hpp"
 #include "HTTP/routing/RequestRouter.hpp"
 #include "Logger.hpp"
 #include "Server.hpp"
+#include "resource/CGICache.hpp"
+#include "server/AccessLog.hpp"
+#include "server/CGIQueue.hpp"
+#include "server/Metrics.hpp"
+#include "utils/Constants.hpp"
 #include "utils/Utils.hpp"
 #include <sstream>
 
@@ -24,8 +34,18 @@ using HTTP::parseRequest;
 using HTTP::Request;
 extern std::atomic<bool> g_running;
 
-Server::Server(const ServerBlock *config)
-    : _serverFd(-1), _running(false), _config(config), _router(config) {
+static uint32_t elapsedUs(std::chrono::steady_clock::time_point from,
+                          std::chrono::steady_clock::time_point to) {
+  if (from.time_since_epoch().count() == 0 || to < from)
+    return 0;
+  return static_cast<uint32_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(to - from)
+          .count());
+}
+
+Server::Server(const ServerBlock *config, Poller *poller)
+    : _serverFd(-1), _running(false), _poller(poller), _config(config),
+      _router(config), _fastcgi(poller) {
 
   ErrorResponseBuilder::setCurrentConfig(config);
 }
@@ -36,7 +56,7 @@ Server::~Server() {
 }
 
 int Server::setupSocket() {
-  _serverFd = socket(AF_INET, SOCK_STREAM, 0);
+  _serverFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
   if (_serverFd < 0) {
     Logger::error("Failed to create socket");
     return -1;
@@ -84,23 +104,85 @@ int Server::setupSocket() {
 int Server::acceptConnection() {
   struct sockaddr_in clientAddr;
   socklen_t addrLen = sizeof(clientAddr);
-  int clientFd = accept(_serverFd, (struct sockaddr *)&clientAddr, &addrLen);
+  // Close-on-exec: a CGI child must not keep other clients' sockets open.
+  int clientFd = accept4(_serverFd, (struct sockaddr *)&clientAddr, &addrLen,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
   if (clientFd < 0) {
     return -1;
   }
-  if (fcntl(clientFd, F_SETFL, O_NONBLOCK) < 0) {
-    Logger::error("Failed to set client socket to non-blocking mode");
-    close(clientFd);
-    return -1;
-  }
-  _clients[clientFd] = std::time(nullptr);
-  _clientBuffers[clientFd] = "";
-  Logger::logf<LogLevel::INFO>("New client connected: fd=%d", clientFd);
+  Client &client = _clients[clientFd];
+  client.lastActivity = std::time(nullptr);
+  std::memcpy(client.addr, &clientAddr.sin_addr.s_addr, sizeof(client.addr));
+  client.port = ntohs(clientAddr.sin_port);
+  client.acceptedAt = std::chrono::steady_clock::now();
+  Metrics::add(Metrics::CONNECTIONS_ACCEPTED);
+  _poller->add(clientFd, POLLIN);
+  Logger::logf<LogLevel::DEBUG>("New client connected: fd=%d", clientFd);
   return clientFd;
 }
 
+void Server::handleEvent(const struct pollfd &pfd) {
+  if (_fastcgi.owns(pfd.fd)) {
+    for (int clientFd : _fastcgi.handleEvent(pfd)) {
+      auto it = _clients.find(clientFd);
+      if (it != _clients.end() && it->second.cgi)
+        pumpCgi(clientFd);
+    }
+    return;
+  }
+  auto cgiIt = _cgiToClient.find(pfd.fd);
+  if (cgiIt != _cgiToClient.end()) {
+    handleCgiEvent(cgiIt->second, pfd);
+    return;
+  }
+  auto it = _clients.find(pfd.fd);
+  if (it == _clients.end())
+    return;
+  if (it->second.cgi) {
+    if (pfd.revents & (POLLERR | POLLNVAL))
+      removeClient(pfd.fd);
+    else if ((pfd.revents & POLLIN) && it->second.bodyRemaining)
+      readCgiBody(pfd.fd);
+    else if (pfd.revents & POLLHUP)
+      removeClient(pfd.fd);
+    else if (pfd.revents & POLLOUT)
+      flushCgi(pfd.fd);
+    return;
+  }
+  if (it->second.cgiQueued || it->second.cacheWaiting) {
+    if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
+      removeClient(pfd.fd);
+    return;
+  }
+  if (it->second.responding) {
+    if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
+      removeClient(pfd.fd);
+    else if (pfd.revents & POLLOUT)
+      flushResponse(pfd.fd);
+    return;
+  }
+  handleClient(pfd.fd);
+}
+
+// Adds a header line to a serialized header block.
+static void insertHeader(std::string &head, std::string_view line) {
+  size_t headerEnd = head.find("\r\n\r\n");
+  if (headerEnd != std::string::npos)
+    head.insert(headerEnd, std::string("\r\n").append(line));
+}
+
+// 503 for a CGI request turned away under cgi_max_concurrent.
+static OutgoingResponse overloaded() {
+  OutgoingResponse response(ErrorResponseBuilder::buildResponse(503));
+  insertHeader(response.head,
+               "Retry-After: " +
+                   std::to_string(CGIQueue::retryAfterSeconds()));
+  return response;
+}
+
 void Server::handleClient(int fd) {
   char buffer[4096];
+  uint64_t recvStart = Trace::enabled() ? Trace::now() : 0;
   ssize_t bytesRead = recv(fd, buffer, sizeof(buffer) - 1, 0);
 
   if (bytesRead <= 0) {
@@ -108,12 +190,26 @@ void Server::handleClient(int fd) {
     return;
   }
   
-  buffer[bytesRead] = '\0';
-  _clientBuffers[fd] += std::string(buffer, bytesRead);
-  _clients[fd] = std::time(nullptr);
+  Client &client = _clients[fd];
+  if (client.buffer.empty()) {
+    client.startedAt = std::chrono::steady_clock::now();
+    if (client.acceptedAt.time_since_epoch().count()) {
+      Metrics::observe(Metrics::FIRST_BYTE,
+                       elapsedUs(client.acceptedAt, client.startedAt));
+      client.acceptedAt = {};
+    }
+  }
+  if (recvStart) {
+    if (client.buffer.empty())
+      client.trace = Trace::Request{{}, recvStart};
+    client.trace.ticks[Trace::RECV] += Trace::now() - recvStart;
+  }
+  client.buffer.append(buffer, bytesRead);
+  Metrics::add(Metrics::BYTES_RECEIVED, static_cast<uint64_t>(bytesRead));
+  client.lastActivity = std::time(nullptr);
 
   // Check for oversized requests
-  if (_clientBuffers[fd].length() > 65536) { // 64KB limit
+  if (client.buffer.length() > 65536) { // 64KB limit
     Logger::error("Client request too large, closing connection");
     sendErrorToClient(fd, 413);
     removeClient(fd);
@@ -121,13 +217,30 @@ void Server::handleClient(int fd) {
   }
 
   // Check if request is complete
-  if (!HttpUtils::isCompleteRequest(_clientBuffers[fd]))
+  if (!HttpUtils::isCompleteRequest(client.buffer)) {
+    if (!client.streamChecked &&
+        client.buffer.find("\r\n\r\n") != std::string::npos) {
+      client.streamChecked = true;
+      Trace::Scope traceScope(recvStart ? &client.trace : nullptr);
+      startBodyStream(fd);
+    }
     return;
+  }
+  processRequest(fd);
+}
 
+// Parses and answers the complete request in the client's buffer.
+void Server::processRequest(int fd) {
+  Client &client = _clients[fd];
+  Trace::Scope traceScope(Trace::enabled() ? &client.trace : nullptr);
   try {
     Request request;
-    auto parseResult = parseRequest(_clientBuffers[fd], request, &_router);
-    
+    RouteContext route;
+    Trace::Span parseSpan(Trace::PARSE);
+    auto parseResult = parseRequest(client.buffer, request, &_router, route);
+    parseSpan.finish();
+    noteRequest(client, request);
+
     if (!parseResult.success) {
       Logger::logf<LogLevel::WARN>("Parse failed with status %d", 
                                    parseResult.statusCode);
@@ -136,29 +249,124 @@ void Server::handleClient(int fd) {
       return;
     }
 
-    std::string root = "./www";
-    if (_config && !_config->root.empty())
-      root = _config->root;
-    
-    std::string responseStr = MethodHandler::handleRequest(request, root, &_router);
+    if (route.route->stubStatus) {
+      queueResponse(fd, statusPage(client, request));
+      return;
+    }
 
-    // Ensure Connection: close header for proper cleanup
-    size_t headerEnd = responseStr.find("\r\n\r\n");
-    if (headerEnd != std::string::npos) {
-      std::string headers = responseStr.substr(0, headerEnd);
-      if (headers.find("\r\nConnection: ") == std::string::npos &&
-          headers.find("Connection: ") != 0) {
-        responseStr.insert(headerEnd, "\r\nConnection: close");
-      }
+    OutgoingResponse response;
+    Trace::Span cacheSpan(Trace::CACHE);
+    bool cached = request.requestLine.method == HTTP::Method::GET &&
+                  ResponseCache::lookup(ResponseCache::makeKey(route, request),
+                                        request, response);
+    cacheSpan.finish();
+    if (cached) {
+      if (Trace::serverTimingEnabled())
+        insertHeader(response.head,
+                     "Server-Timing: " + Trace::serverTiming(client.trace));
+      queueResponse(fd, std::move(response));
+      return;
     }
 
-    ssize_t sent = send(fd, responseStr.c_str(), responseStr.length(), MSG_NOSIGNAL);
-    if (sent < 0) {
-      Logger::error("Failed to send response to client");
+    if (serveCgiCache(fd, request, route) || !admitCgi(fd, request, route))
+      return;
+    response = handle(fd, request, route);
+    if (response.cgi) {
+      startCgi(fd, std::move(response.cgi));
+      return;
     }
-    
+    releaseCgiSlot(client);
+    respond(fd, std::move(response));
+
+  } catch (const std::exception &e) {
+    Logger::logf<LogLevel::ERROR>("Error handling client: %s", e.what());
+    sendErrorToClient(fd, 500);
     removeClient(fd);
+  }
+}
+
+void Server::noteRequest(Client &client, const Request &request) {
+  client.parsedAt = std::chrono::steady_clock::now();
+  client.method = request.requestLine.method;
+  client.acceptsChunked = request.requestLine.version != "HTTP/1.0";
+  if (AccessLog::enabled() || Trace::slowRequestMs())
+    client.target = request.requestLine.uri;
+}
+
+static std::string absolutePath(std::string_view path) {
+  std::error_code error;
+  std::filesystem::path absolute = std::filesystem::absolute(path, error);
+  if (error)
+    return std::string(path);
+  return absolute.lexically_normal().string();
+}
+
+OutgoingResponse Server::handle(int fd, const Request &request,
+                                const RouteContext &route) {
+  Trace::Span handlerSpan(Trace::HANDLER);
+  if (route.route->passesToFastCGI())
+    return passFastCgi(fd, request, route);
+  return MethodHandler::handleRequest(request, route);
+}
+
+// Everything in a fastcgi_pass location goes to the backend, with the file
+// the URI maps to as SCRIPT_FILENAME; the response then takes the same path
+// as a CGI script's. Paths are sent absolute: the backend resolves relative
+// ones against its own working directory, not ours.
+OutgoingResponse Server::passFastCgi(int fd, const Request &request,
+                                     const RouteContext &route) {
+  Trace::Span spawn(Trace::CGI_SPAWN);
+  Metrics::add(Metrics::CGI_EXECUTIONS);
+  size_t inputLength = std::max(request.contentLength, request.body.size());
+  std::vector<std::string> params =
+      CGIHandler::buildEnvironment(route.filePath, request, inputLength,
+                                   *route.route);
+  params.push_back("SCRIPT_FILENAME=" + absolutePath(route.filePath));
+  params.push_back("DOCUMENT_ROOT=" + absolutePath(route.root));
+  params.push_back("REQUEST_URI=" + request.requestLine.uri);
+  std::shared_ptr<FastCGIRequest> job = _fastcgi.start(
+      route.route->fastcgiPass, params, request.body, inputLength,
+      std::chrono::milliseconds(route.route->cgiTimeoutMs), fd);
+  if (!job) {
+    Metrics::add(Metrics::CGI_FAILURES);
+    return ErrorResponseBuilder::buildResponse(502);
+  }
+  return OutgoingResponse(std::move(job));
+}
+
+// A CGI or FastCGI POST with a Content-Length is started as soon as its
+// head is in, with the body bytes that came along; the rest is passed on as
+// it arrives instead of being buffered whole first. Anything else (or a
+// head that fails to parse) waits for the complete request as usual.
+void Server::startBodyStream(int fd) {
+  Client &client = _clients[fd];
+  try {
+    Request request;
+    RouteContext route;
+    Trace::Span parseSpan(Trace::PARSE);
+    if (!HTTP::parseRequestHead(client.buffer, request, &_router, route)
+             .success ||
+        request.chunkedTransfer || request.contentLength == 0 ||
+        !MethodHandler::streamsBody(request, route))
+      return;
+    size_t bodyStart = client.buffer.find("\r\n\r\n") + 4;
+    request.body = client.buffer.substr(bodyStart);
+    if (request.body.size() >= request.contentLength)
+      return;
+    parseSpan.finish();
+    noteRequest(client, request);
 
+    if (!admitCgi(fd, request, route))
+      return;
+    OutgoingResponse response = handle(fd, request, route);
+    if (!response.cgi) {
+      releaseCgiSlot(client);
+      respond(fd, std::move(response));
+      return;
+    }
+    client.bodyRemaining = request.contentLength - request.body.size();
+    client.buffer.clear();
+    startCgi(fd, std::move(response.cgi));
   } catch (const std::exception &e) {
     Logger::logf<LogLevel::ERROR>("Error handling client: %s", e.what());
     sendErrorToClient(fd, 500);
@@ -166,35 +374,787 @@ void Server::handleClient(int fd) {
   }
 }
 
-void Server::removeClient(int fd) {
+// Scripts start only within cgi_max_concurrent. Over it the client waits
+// with its request left in the buffer and its socket no longer read, so a
+// body stays in the kernel until the script can take it; resumeCgi() then
+// handles the buffer again. A full queue means 503 at once. False if the
+// request is not to be handled now.
+bool Server::admitCgi(int fd, const Request &request,
+                      const RouteContext &route) {
+  Client &client = _clients[fd];
+  if (client.cgiSlot || !MethodHandler::runsScript(request, route))
+    return true;
+  switch (CGIQueue::acquire(this, fd, route.route)) {
+  case CGIQueue::ADMITTED:
+    client.cgiSlot = route.route;
+    return true;
+  case CGIQueue::QUEUED:
+    client.cgiQueued = true;
+    _poller->update(fd, 0);
+    Logger::logf<LogLevel::DEBUG>("CGI queued: fd=%d", fd);
+    return false;
+  case CGIQueue::REJECTED:
+    break;
+  }
+  Logger::logf<LogLevel::DEBUG>("CGI queue full, turning away fd=%d", fd);
+  respond(fd, overloaded());
+  return false;
+}
+
+void Server::resumeCgi(int fd, const Route *slot) {
+  auto it = _clients.find(fd);
+  if (it == _clients.end()) {
+    CGIQueue::release(slot);
+    return;
+  }
+  Client &client = it->second;
+  client.cgiQueued = false;
+  client.cgiSlot = slot;
+  _poller->update(fd, POLLIN);
+  if (HttpUtils::isCompleteRequest(client.buffer))
+    processRequest(fd);
+  else
+    startBodyStream(fd);
+  // A head that no longer goes to a script leaves the client reading.
+  it = _clients.find(fd);
+  if (it != _clients.end() && !it->second.cgi)
+    releaseCgiSlot(it->second);
+}
+
+void Server::shedCgi(int fd) {
+  auto it = _clients.find(fd);
+  if (it == _clients.end())
+    return;
+  it->second.cgiQueued = false;
+  Logger::logf<LogLevel::DEBUG>("CGI queue timeout, turning away fd=%d", fd);
+  respond(fd, overloaded());
+}
+
+void Server::releaseCgiSlot(Client &client) {
+  if (!client.cgiSlot)
+    return;
+  CGIQueue::release(client.cgiSlot);
+  client.cgiSlot = nullptr;
+}
+
+// A GET for a script in a cgi_cache location is answered from the CGI cache
+// when it can be and the request allows (CGICache::policy). On a miss the
+// first client runs the script and fills the entry; later ones for the same
+// key wait, watched only for errors, until wakeCacheWaiters() handles their
+// buffer again. A stale entry is served while one refresh runs without a
+// client. True if the request needs nothing more now.
+bool Server::serveCgiCache(int fd, const Request &request,
+                           const RouteContext &route) {
+  Client &client = _clients[fd];
+  // A filler back from the CGI queue has already missed.
+  if (!client.cacheKey.empty() || client.cacheBypass ||
+      !route.route->cgiCache || !CGICache::enabled() ||
+      request.requestLine.method != HTTP::Method::GET ||
+      !MethodHandler::runsScript(request, route))
+    return false;
+  CGICache::Policy policy = CGICache::policy(request);
+  if (!policy.usable)
+    return false;
+  std::string key = CGICache::makeKey(route, request);
+  OutgoingResponse response;
+  CGICache::Result result =
+      policy.lookup ? CGICache::lookup(key, response, policy.sharedOnly)
+                    : CGICache::MISS;
+  auto fill = _cacheFills.find(key);
+  if (result != CGICache::MISS) {
+    if (result == CGICache::STALE && fill == _cacheFills.end())
+      refreshCgiCache(key, request, route, policy.sharedOnly);
+    respond(fd, std::move(response));
+    return true;
+  }
+  if (fill != _cacheFills.end()) {
+    fill->second.push_back(fd);
+    client.cacheKey = std::move(key);
+    client.cacheWaiting = true;
+    _poller->update(fd, 0);
+    CGICache::noteCollapsed();
+    Logger::logf<LogLevel::DEBUG>("CGI cache miss collapsed: fd=%d", fd);
+    return true;
+  }
+  _cacheFills[key];
+  client.cacheKey = std::move(key);
+  client.cacheValidMs = route.route->cgiCacheValidMs;
+  client.cacheSharedOnly = policy.sharedOnly;
+  return false;
+}
+
+// Stores a finished script's response under the key its client was filling
+// and wakes the clients waiting for it; if it could not be stored, they run
+// the script themselves.
+void Server::fillCgiCache(Client &client) {
+  if (client.cacheKey.empty() || client.cacheWaiting)
+    return;
+  std::string key;
+  key.swap(client.cacheKey);
+  const CGIOutput &cgi = *client.cgi;
+  std::string_view body;
+  bool stored = cgi.completeBody(body) &&
+                CGICache::store(key, cgi.statusCode(), cgi.headers(), body,
+                                client.cacheValidMs, client.cacheSharedOnly);
+  endCacheFill(key, !stored);
+}
 
-  _clients.erase(fd);
-  _clientBuffers.erase(fd);
+// A client that goes away leaves its key's waiters, or, if it was filling
+// the entry, wakes them so that one of them runs the script instead.
+void Server::leaveCgiCache(int fd) {
+  auto it = _clients.find(fd);
+  if (it == _clients.end() || it->second.cacheKey.empty())
+    return;
+  Client &client = it->second;
+  std::string key;
+  key.swap(client.cacheKey);
+  if (!client.cacheWaiting) {
+    endCacheFill(key, false);
+    return;
+  }
+  client.cacheWaiting = false;
+  auto fill = _cacheFills.find(key);
+  if (fill != _cacheFills.end())
+    fill->second.erase(
+        std::remove(fill->second.begin(), fill->second.end(), fd),
+        fill->second.end());
+}
+
+// Waiters are woken after the round of events, since answering them may
+// start scripts or remove clients.
+void Server::endCacheFill(const std::string &key, bool bypass) {
+  auto fill = _cacheFills.find(key);
+  if (fill == _cacheFills.end())
+    return;
+  for (int fd : fill->second)
+    _cacheWoken.emplace_back(fd, bypass);
+  _cacheFills.erase(fill);
+}
+
+void Server::wakeCacheWaiters() {
+  std::vector<std::pair<int, bool>> woken;
+  woken.swap(_cacheWoken);
+  for (const auto &[fd, bypass] : woken) {
+    auto it = _clients.find(fd);
+    if (it == _clients.end() || !it->second.cacheWaiting)
+      continue;
+    it->second.cacheWaiting = false;
+    it->second.cacheKey.clear();
+    it->second.cacheBypass = bypass;
+    _poller->update(fd, POLLIN);
+    processRequest(fd);
+  }
+}
+
+// Reruns the script behind a stale entry, only if a CGI slot is free at
+// once, with its output kept for the cache alone. Until it ends the key
+// counts as being filled, so no second refresh starts and misses wait for
+// it.
+void Server::refreshCgiCache(const std::string &key, const Request &request,
+                             const RouteContext &route, bool sharedOnly) {
+  if (!CGIQueue::tryAcquire(route.route))
+    return;
+  OutgoingResponse response = CGIHandler::executeCGI(
+      route, request, *route.route->cgiInterpreter(route.filePath));
+  if (!response.cgi) {
+    CGIQueue::release(route.route);
+    return;
+  }
+  int id = _nextRefreshId--;
+  CacheRefresh &refresh = _refreshes[id];
+  refresh.key = key;
+  refresh.validMs = route.route->cgiCacheValidMs;
+  refresh.sharedOnly = sharedOnly;
+  refresh.slot = route.route;
+  refresh.cgi = std::move(response.cgi);
+  refresh.cgi->captureBody(Constants::CGI_CACHE_MAX_ENTRY);
+  _cacheFills[key];
+  Logger::logf<LogLevel::DEBUG>("CGI cache refresh: %s",
+                                refresh.cgi->name().c_str());
+  watchCgi(*refresh.cgi, id);
+  pumpRefresh(id);
+}
+
+void Server::handleRefreshEvent(int id, const struct pollfd &pfd) {
+  auto it = _refreshes.find(id);
+  if (it == _refreshes.end()) {
+    unwatchCgiFd(pfd.fd);
+    return;
+  }
+  if (!it->second.cgi->handleEvent(pfd))
+    unwatchCgiFd(pfd.fd);
+  pumpRefresh(id);
+}
+
+// A refresh streams its output nowhere: the body is captured as it is
+// framed and then dropped, so the script is never held up.
+void Server::pumpRefresh(int id) {
+  auto it = _refreshes.find(id);
+  if (it == _refreshes.end())
+    return;
+  CGIOutput &cgi = *it->second.cgi;
+  if (cgi.headerInvalid() || cgi.finished()) {
+    endRefresh(id);
+    return;
+  }
+  if (cgi.headerReady() && !cgi.streaming())
+    cgi.beginStream(false);
+  if (cgi.streaming())
+    cgi.consume(cgi.pending().size());
+  updateCgiFds(cgi);
+}
+
+void Server::endRefresh(int id) {
+  auto it = _refreshes.find(id);
+  CacheRefresh refresh = std::move(it->second);
+  _refreshes.erase(it);
+  unwatchCgi(*refresh.cgi);
+  CGIQueue::release(refresh.slot);
+  std::string_view body;
+  bool stored = refresh.cgi->completeBody(body) &&
+                CGICache::store(refresh.key, refresh.cgi->statusCode(),
+                                refresh.cgi->headers(), body, refresh.validMs,
+                                refresh.sharedOnly);
+  endCacheFill(refresh.key, !stored);
+}
+
+// Adds the per-connection header lines to a handler's header block.
+void Server::completeHead(const Client &client, std::string &head) {
+  // Ensure Connection: close header for proper cleanup
+  size_t headerEnd = head.find("\r\n\r\n");
+  if (headerEnd != std::string::npos) {
+    std::string_view headers(head.data(), headerEnd);
+    if (headers.find("\r\nConnection: ") == std::string::npos &&
+        headers.find("Connection: ") != 0) {
+      head.insert(headerEnd, "\r\nConnection: close");
+    }
+  }
+  if (Trace::serverTimingEnabled())
+    insertHeader(head, "Server-Timing: " + Trace::serverTiming(client.trace));
+}
+
+void Server::respond(int fd, OutgoingResponse response) {
+  completeHead(_clients[fd], response.head);
+  queueResponse(fd, std::move(response));
+}
+
+void Server::queueResponse(int fd, OutgoingResponse response) {
+  Client &client = _clients[fd];
+  client.queuedAt = std::chrono::steady_clock::now();
+  if (Trace::enabled())
+    client.sendStartTick = Trace::now();
+  client.buffer.clear();
+  client.response = std::move(response);
+  client.sent = 0;
+  client.responding = true;
+  flushResponse(fd);
+}
+
+// Writes as much of the pending response as the socket accepts. The header
+// block and the shared body go out in one sendmsg() so small responses still
+// cost a single syscall; an open file follows the header via sendfile() with
+// MSG_MORE so both leave in the same segment. The rest waits for POLLOUT.
+void Server::flushResponse(int fd) {
+  Client &client = _clients[fd];
+  const OutgoingResponse &response = client.response;
+  const size_t total = response.size();
+  const size_t headSize = response.head.size();
+
+  while (client.sent < total) {
+    ssize_t sent;
+    if (response.file && client.sent >= headSize) {
+      off_t offset = static_cast<off_t>(client.sent - headSize);
+      sent = sendfile(fd, response.file->fd, &offset, total - client.sent);
+      if (sent == 0) {
+        Logger::error("File shrank while sending response");
+        break;
+      }
+    } else {
+      struct iovec iov[2];
+      int iovCount = 0;
+      size_t offset = client.sent;
+      if (offset < headSize) {
+        iov[iovCount].iov_base =
+            const_cast<char *>(response.head.data()) + offset;
+        iov[iovCount++].iov_len = headSize - offset;
+        offset = 0;
+      } else
+        offset -= headSize;
+      if (response.body && offset < response.body->size()) {
+        iov[iovCount].iov_base =
+            const_cast<char *>(response.body->data()) + offset;
+        iov[iovCount++].iov_len = response.body->size() - offset;
+      }
+
+      struct msghdr msg;
+      std::memset(&msg, 0, sizeof(msg));
+      msg.msg_iov = iov;
+      msg.msg_iovlen = iovCount;
+      int flags = MSG_NOSIGNAL | MSG_DONTWAIT;
+      if (response.file)
+        flags |= MSG_MORE;
+      sent = sendmsg(fd, &msg, flags);
+    }
+    if (sent < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        _poller->update(fd, POLLOUT);
+        return;
+      }
+      Logger::error("Failed to send response to client");
+      break;
+    }
+    client.sent += static_cast<size_t>(sent);
+    client.lastActivity = std::time(nullptr);
+  }
+  // "HTTP/1.1 200 OK": the status code follows the first space.
+  int status = 0;
+  size_t space = response.head.find(' ');
+  if (space != std::string::npos)
+    status = std::atoi(response.head.c_str() + space + 1);
+  finishRequest(client, status, client.sent);
+  removeClient(fd);
+}
+
+// Only loopback clients may read the metrics of a location with
+// `stub_status on`; JSON is served on ?format=json or Accept: application/json.
+OutgoingResponse Server::statusPage(const Client &client,
+                                    const Request &request) {
+  if (client.addr[0] != 127)
+    return OutgoingResponse(ErrorResponseBuilder::buildResponse(403));
+
+  bool json = request.requestLine.uri.find("format=json") != std::string::npos;
+  auto accept = request.headers.find("Accept");
+  if (accept != request.headers.end() &&
+      accept->second.find("application/json") != std::string::npos)
+    json = true;
+
+  HttpResponse response;
+  if (json)
+    response.body(Metrics::json(), "application/json");
+  else
+    response.body(Metrics::prometheus(), "text/plain; version=0.0.4");
+  response.header("Cache-Control", "no-store");
+  return response.build();
+}
+
+void Server::finishRequest(const Client &client, int status, size_t bytes) {
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  uint32_t parseUs = elapsedUs(client.startedAt, client.parsedAt);
+  uint32_t handleUs = elapsedUs(client.parsedAt, client.queuedAt);
+  uint32_t sendUs = elapsedUs(client.queuedAt, now);
+  Metrics::response(status, bytes);
+  if (client.parsedAt.time_since_epoch().count()) {
+    Metrics::observe(Metrics::PARSE, parseUs);
+    if (client.queuedAt.time_since_epoch().count()) {
+      Metrics::observe(Metrics::HANDLER, handleUs);
+      Metrics::observe(Metrics::SEND, sendUs);
+    }
+  }
+
+  size_t slowMs = Trace::slowRequestMs();
+  if (slowMs && client.trace.startedAt) {
+    Trace::Request trace = client.trace;
+    if (client.sendStartTick)
+      trace.ticks[Trace::SEND] = Trace::now() - client.sendStartTick;
+    if (Trace::toMillis(Trace::now() - trace.startedAt) >= slowMs)
+      Logger::logf<LogLevel::WARN>(
+          "Slow request: %s %s -> %d (%s)",
+          HTTP::methodToString(client.method), client.target, status,
+          [&] { return Trace::summary(trace); });
+  }
+
+  if (!AccessLog::sample())
+    return;
+  std::chrono::steady_clock::time_point started =
+      client.startedAt.time_since_epoch().count() ? client.startedAt : now;
+
+  AccessLogFormat::Record record;
+  // Wall-clock start of the request, derived from the steady timestamps.
+  record.timeUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::system_clock::now().time_since_epoch())
+                      .count() -
+                  static_cast<int64_t>(elapsedUs(started, now));
+  record.bytes = bytes;
+  std::memcpy(record.clientAddr, client.addr, sizeof(record.clientAddr));
+  record.clientPort = client.port;
+  record.serverPort = static_cast<uint16_t>(
+      _config->listenDirectives.empty() ? 8080
+                                        : _config->listenDirectives[0].second);
+  record.status = static_cast<uint16_t>(status);
+  record.method = static_cast<uint8_t>(client.method);
+  record.parseUs = parseUs;
+  record.handleUs = handleUs;
+  record.sendUs = sendUs;
+  record.target = client.target;
+  AccessLog::write(record);
+}
+
+// While a script runs its client is only watched for errors and a full
+// hangup, which kill the script, not for a read half-close; the script's
+// pipes and pidfd are polled instead and map back to the client through
+// _cgiToClient.
+void Server::startCgi(int fd, std::shared_ptr<CGIOutput> cgi) {
+  Client &client = _clients[fd];
+  client.cgi = std::move(cgi);
+  if (Trace::enabled())
+    client.cgiStartTick = Trace::now();
+  if (!client.cacheKey.empty())
+    client.cgi->captureBody(Constants::CGI_CACHE_MAX_ENTRY);
+  watchCgi(*client.cgi, fd);
+  updateCgiEvents(fd);
+}
+
+// Passes body bytes that arrive after the script has started on to its
+// stdin. A client that shuts down its sending side ends the body there; the
+// script sees end of input and its response still goes out.
+void Server::readCgiBody(int fd) {
+  Client &client = _clients[fd];
+  char buffer[16384];
+  ssize_t bytesRead =
+      recv(fd, buffer, std::min(sizeof(buffer), client.bodyRemaining), 0);
+  if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK ||
+                        errno == EINTR))
+    return;
+  if (bytesRead < 0) {
+    removeClient(fd);
+    return;
+  }
+  if (bytesRead == 0) {
+    client.bodyRemaining = 0;
+    client.cgi->endInput();
+    updateCgiEvents(fd);
+    return;
+  }
+  client.bodyRemaining -= static_cast<size_t>(bytesRead);
+  Metrics::add(Metrics::BYTES_RECEIVED, static_cast<uint64_t>(bytesRead));
+  client.lastActivity = std::time(nullptr);
+  client.cgi->appendInput(buffer, static_cast<size_t>(bytesRead));
+  updateCgiEvents(fd);
+}
+
+// Polls each side of a running script only while it can make progress: the
+// client for body bytes while the script's stdin buffer has room and for
+// POLLOUT while output waits, stdin while there is body to write, and
+// stdout while the output buffer has room. Either buffer filling up thus
+// throttles the side that feeds it.
+void Server::updateCgiEvents(int fd) {
+  Client &client = _clients[fd];
+  CGIOutput &cgi = *client.cgi;
+  short events = 0;
+  if (client.bodyRemaining && !cgi.inputFull())
+    events |= POLLIN;
+  if (cgi.streaming() &&
+      (client.sent < client.response.head.size() || !cgi.pending().empty() ||
+       cgi.spliceBlocked()))
+    events |= POLLOUT;
+  _poller->update(fd, events);
+  updateCgiFds(cgi);
+}
+
+void Server::updateCgiFds(CGIOutput &cgi) {
+  if (cgi.stdinFd() >= 0)
+    _poller->update(cgi.stdinFd(), cgi.inputWaiting() ? POLLOUT : 0);
+  if (cgi.stdoutFd() >= 0)
+    _poller->update(cgi.stdoutFd(), cgi.outputBlocked() ? 0 : POLLIN);
+  cgi.updateFlow();
+}
+
+void Server::handleCgiEvent(int clientFd, const struct pollfd &pfd) {
+  if (clientFd < 0) {
+    handleRefreshEvent(clientFd, pfd);
+    return;
+  }
+  auto it = _clients.find(clientFd);
+  if (it == _clients.end() || !it->second.cgi) {
+    unwatchCgiFd(pfd.fd);
+    return;
+  }
+  // Output spliced to the socket is moved by flushCgi(), not read.
+  const CGIOutput &cgi = *it->second.cgi;
+  bool splicing = pfd.fd == cgi.stdoutFd() && cgi.splicing() &&
+                  it->second.sent >= it->second.response.head.size();
+  if (!splicing && !it->second.cgi->handleEvent(pfd))
+    unwatchCgiFd(pfd.fd);
+  pumpCgi(clientFd);
+}
+
+void Server::watchCgiFd(int cgiFd, short events, int clientFd) {
+  _cgiToClient[cgiFd] = clientFd;
+  _poller->add(cgiFd, events);
+}
+
+void Server::watchCgi(const CGIOutput &cgi, int clientFd) {
+  if (cgi.stdinFd() >= 0)
+    watchCgiFd(cgi.stdinFd(), POLLOUT, clientFd);
+  watchCgiFd(cgi.stdoutFd(), POLLIN, clientFd);
+  if (cgi.pidFd() >= 0)
+    watchCgiFd(cgi.pidFd(), POLLIN, clientFd);
+}
+
+void Server::unwatchCgiFd(int cgiFd) {
+  _cgiToClient.erase(cgiFd);
+  _poller->remove(cgiFd);
+}
+
+void Server::unwatchCgi(const CGIOutput &cgi) {
+  for (int cgiFd : {cgi.stdinFd(), cgi.stdoutFd(), cgi.pidFd()})
+    if (cgiFd >= 0)
+      unwatchCgiFd(cgiFd);
+}
+
+// Stops polling the script's descriptors and drops the process, which kills
+// the child if it is still running.
+void Server::detachCgi(Client &client) {
+  unwatchCgi(*client.cgi);
+  client.cgi.reset();
+  client.bodyRemaining = 0;
+  releaseCgiSlot(client);
+}
+
+// Moves a script's output on to its client. A script that ends before its
+// response has started gets a regular response with a Content-Length and
+// its exit status checked; otherwise the head goes out as soon as the
+// header block is complete and the body follows as it is produced.
+void Server::pumpCgi(int fd) {
+  Client &client = _clients[fd];
+  CGIOutput &cgi = *client.cgi;
+  if (!cgi.streaming()) {
+    if (cgi.headerInvalid() || cgi.finished()) {
+      completeCgi(fd);
+      return;
+    }
+    if (!cgi.headerReady() || cgi.outputEnded()) {
+      updateCgiEvents(fd);
+      return;
+    }
+    startCgiStream(fd);
+  }
+  if (cgi.finished()) {
+    cgi.endStream();
+    releaseCgiSlot(client);
+  }
+  flushCgi(fd);
+}
+
+void Server::completeCgi(int fd) {
+  Client &client = _clients[fd];
+  OutgoingResponse response = client.cgi->response();
+  fillCgiCache(client);
+  detachCgi(client);
+  if (client.cgiStartTick && client.trace.startedAt)
+    client.trace.ticks[Trace::CGI_WAIT] += Trace::now() - client.cgiStartTick;
+  client.lastActivity = std::time(nullptr);
+  respond(fd, std::move(response));
+}
+
+void Server::startCgiStream(int fd) {
+  Client &client = _clients[fd];
+  client.response = OutgoingResponse(
+      client.cgi->beginStream(client.acceptsChunked));
+  if (client.cgiStartTick && client.trace.startedAt)
+    client.trace.ticks[Trace::CGI_WAIT] += Trace::now() - client.cgiStartTick;
+  completeHead(client, client.response.head);
+  client.queuedAt = std::chrono::steady_clock::now();
+  if (Trace::enabled())
+    client.sendStartTick = Trace::now();
+  client.buffer.clear();
+  client.sent = 0;
+  client.responding = true;
+}
+
+// Sends the head and whatever body the script has produced, then splices
+// the rest of a Content-Length body straight from the script's stdout when
+// it can; a slow client throttles the script through updateCgiEvents().
+void Server::flushCgi(int fd) {
+  Client &client = _clients[fd];
+  CGIOutput &cgi = *client.cgi;
+  const std::string &head = client.response.head;
+
+  while (true) {
+    struct iovec iov[2];
+    int iovCount = 0;
+    size_t headSent = std::min(client.sent, head.size());
+    if (headSent < head.size()) {
+      iov[iovCount].iov_base = const_cast<char *>(head.data()) + headSent;
+      iov[iovCount++].iov_len = head.size() - headSent;
+    }
+    std::string_view body = cgi.pending();
+    if (!body.empty()) {
+      iov[iovCount].iov_base = const_cast<char *>(body.data());
+      iov[iovCount++].iov_len = body.size();
+    }
+    if (iovCount == 0)
+      break;
+
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovCount;
+    ssize_t sent = sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (sent < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+      Logger::error("Failed to send CGI response to client");
+      finishRequest(client, cgi.statusCode(), client.sent);
+      removeClient(fd);
+      return;
+    }
+    size_t headPart = std::min(static_cast<size_t>(sent),
+                               head.size() - headSent);
+    cgi.consume(static_cast<size_t>(sent) - headPart);
+    client.sent += static_cast<size_t>(sent);
+    client.lastActivity = std::time(nullptr);
+  }
+
+  if (client.sent >= head.size() && cgi.splicing()) {
+    int pipeFd = cgi.stdoutFd();
+    ssize_t spliced = cgi.spliceTo(fd);
+    if (cgi.stdoutFd() != pipeFd)
+      unwatchCgiFd(pipeFd);
+    if (spliced < 0) {
+      Logger::error("Failed to splice CGI response to client");
+      finishRequest(client, cgi.statusCode(), client.sent);
+      removeClient(fd);
+      return;
+    }
+    if (spliced) {
+      client.sent += static_cast<size_t>(spliced);
+      client.lastActivity = std::time(nullptr);
+    }
+    // The pipe's EOF may have been the last thing the script had to end.
+    if (cgi.finished()) {
+      cgi.endStream();
+      releaseCgiSlot(client);
+    }
+  }
+
+  if (cgi.streamDone()) {
+    fillCgiCache(client);
+    finishRequest(client, cgi.statusCode(), client.sent);
+    removeClient(fd);
+    return;
+  }
+  updateCgiEvents(fd);
+}
+
+// A script or FastCGI request that overruns cgi_timeout is cancelled. Its
+// client gets 504, or a truncated response if the head has already gone out.
+void Server::timeoutCgi(int fd) {
+  Client &client = _clients[fd];
+  Logger::logf<LogLevel::WARN>("%s timed out after %zu ms",
+                               client.cgi->name().c_str(),
+                               client.cgi->timeoutMs());
+  Metrics::add(Metrics::CGI_FAILURES);
+  if (client.cgi->streaming()) {
+    finishRequest(client, client.cgi->statusCode(), client.sent);
+    removeClient(fd);
+    return;
+  }
+  detachCgi(client);
+  respond(fd, ErrorResponseBuilder::buildResponse(504));
+}
+
+void Server::removeClient(int fd) {
+  auto it = _clients.find(fd);
+  if (it != _clients.end()) {
+    if (it->second.cgi)
+      detachCgi(it->second);
+    releaseCgiSlot(it->second);
+    if (it->second.cgiQueued)
+      CGIQueue::cancel(this, fd);
+    leaveCgiCache(fd);
+  }
+  if (_clients.erase(fd))
+    Metrics::add(Metrics::CONNECTIONS_CLOSED);
+  _poller->remove(fd);
   close(fd);
-  Logger::logf<LogLevel::WARN>("Client removed: fd=%d", fd);
+  Logger::logf<LogLevel::DEBUG>("Client removed: fd=%d", fd);
 }
 
 void Server::checkTimeouts() {
   const time_t timeout = 30;
   const time_t now = std::time(nullptr);
+  const auto steadyNow = std::chrono::steady_clock::now();
+  // Finishing a script sends its response, which may remove the client, so
+  // those are handled after the walk.
+  std::vector<int> cgiProgressed;
+  std::vector<int> cgiExpired;
   auto it = _clients.begin();
   while (it != _clients.end()) {
-    if (now - it->second > timeout) {
+    // Queued clients are timed out by CGIQueue, and those waiting on the CGI
+    // cache go with the script they wait for.
+    if (it->second.cgiQueued || it->second.cacheWaiting) {
+      ++it;
+      continue;
+    }
+    // A running script has its own timeout; once it has finished, a client
+    // still draining its output is idle-checked like any other.
+    if (it->second.cgi && !it->second.cgi->finished()) {
+      CGIOutput &cgi = *it->second.cgi;
+      if (cgi.onTimer())
+        cgiProgressed.push_back(it->first);
+      else if (cgi.expired(steadyNow))
+        cgiExpired.push_back(it->first);
+      ++it;
+      continue;
+    }
+    if (now - it->second.lastActivity > timeout) {
       int fd = it->first;
-      std::string timeoutResponse = ErrorResponseBuilder::buildResponse(408);
-      send(fd, timeoutResponse.c_str(), timeoutResponse.length(), MSG_NOSIGNAL);
+      if (it->second.cgi)
+        detachCgi(it->second);
+      leaveCgiCache(fd);
+      if (!it->second.responding) {
+        std::string timeoutResponse = ErrorResponseBuilder::buildResponse(408);
+        send(fd, timeoutResponse.c_str(), timeoutResponse.length(),
+             MSG_NOSIGNAL | MSG_DONTWAIT);
+      }
       it = _clients.erase(it);
-      _clientBuffers.erase(fd);
+      Metrics::add(Metrics::CONNECTIONS_CLOSED);
+      _poller->remove(fd);
       close(fd);
     } else
       ++it;
   }
+  for (int fd : cgiProgressed)
+    pumpCgi(fd);
+  for (int fd : cgiExpired)
+    timeoutCgi(fd);
+  std::vector<int> refreshProgressed;
+  std::vector<int> refreshExpired;
+  for (auto &[id, refresh] : _refreshes) {
+    if (refresh.cgi->onTimer())
+      refreshProgressed.push_back(id);
+    else if (refresh.cgi->expired(steadyNow))
+      refreshExpired.push_back(id);
+  }
+  for (int id : refreshProgressed)
+    pumpRefresh(id);
+  for (int id : refreshExpired) {
+    auto refresh = _refreshes.find(id);
+    if (refresh == _refreshes.end())
+      continue;
+    Logger::logf<LogLevel::WARN>("%s timed out after %zu ms",
+                                 refresh->second.cgi->name().c_str(),
+                                 refresh->second.cgi->timeoutMs());
+    Metrics::add(Metrics::CGI_FAILURES);
+    endRefresh(id);
+  }
+  wakeCacheWaiters();
+  _fastcgi.closeIdle(steadyNow);
 }
 
 void Server::sendErrorToClient(int fd, int statusCode) {
   try {
     std::string errorResponse = ErrorResponseBuilder::buildResponse(statusCode);
-    send(fd, errorResponse.c_str(), errorResponse.length(), MSG_NOSIGNAL);
+    ssize_t sent =
+        send(fd, errorResponse.c_str(), errorResponse.length(), MSG_NOSIGNAL);
+    auto it = _clients.find(fd);
+    if (it != _clients.end())
+      finishRequest(it->second, statusCode, sent > 0 ? sent : 0);
   } catch (const std::exception &e) {
     Logger::logf<LogLevel::ERROR>("Failed to send error response to client fd=%d: %s", fd, e.what());
   } catch (...) {
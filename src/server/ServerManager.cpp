@@ -1,5 +1,15 @@
 #include "server/ServerManager.hpp"
+#include "HTTP/core/ResponseCache.hpp"
+#include "resource/CGICache.hpp"
+#include "resource/CGIWorkers.hpp"
+#include "server/AccessLog.hpp"
+#include "server/CGIQueue.hpp"
 #include "utils/Logger.hpp"
+#include "utils/NegativeCache.hpp"
+#include "utils/OpenFileCache.hpp"
+#include "utils/Trace.hpp"
+#include "utils/Utils.hpp"
+#include <algorithm>
 #include <atomic>
 #include <sstream>
 #include <stdexcept>
@@ -9,7 +19,10 @@ extern std::atomic<bool> g_running;
 
 ServerManager::ServerManager() : _running(false) {}
 
-ServerManager::~ServerManager() { stop(); }
+ServerManager::~ServerManager() {
+  stop();
+  Logger::stopAsync();
+}
 
 void ServerManager::initializeServers(const Config &config) {
   const auto &serverConfigs = config.getServers();
@@ -17,9 +30,72 @@ void ServerManager::initializeServers(const Config &config) {
   if (serverConfigs.empty())
     throw std::runtime_error("No server configurations found");
 
+  const GlobalBlock &global = config.getGlobal();
+  if (global.logAsync) {
+    Logger::AsyncSettings logSettings;
+    logSettings.bufferRecords = global.logBufferRecords;
+    logSettings.flushIntervalMs = global.logFlushIntervalMs;
+    logSettings.blockWhenFull = global.logBlockWhenFull;
+    Logger::startAsync(logSettings);
+    Logger::logf<LogLevel::INFO>(
+        "Async logging: %zu records, flush every %zu ms, %s when full",
+        logSettings.bufferRecords, logSettings.flushIntervalMs,
+        logSettings.blockWhenFull ? "block" : "drop");
+  }
+  if (!global.accessLog.empty()) {
+    AccessLog::Settings accessSettings;
+    accessSettings.path = global.accessLog;
+    accessSettings.bufferSize = global.accessLogBuffer;
+    accessSettings.flushIntervalMs = global.accessLogFlushMs;
+    accessSettings.sampleRate = global.accessLogSample;
+    if (AccessLog::open(accessSettings))
+      Logger::logf<LogLevel::INFO>(
+          "Access log: %s (binary), 1 in %zu requests", global.accessLog,
+          global.accessLogSample);
+  }
+  Trace::Settings traceSettings;
+  traceSettings.useTsc = global.traceTsc;
+  traceSettings.serverTiming = global.serverTiming;
+  traceSettings.slowRequestMs = global.slowRequestMs;
+  if (!Trace::configure(traceSettings))
+    Logger::logf<LogLevel::WARN>(
+        "trace_clock rdtsc is not available here, using the monotonic clock");
+  if (Trace::enabled())
+    Logger::logf<LogLevel::INFO>(
+        "Request tracing: %s clock, Server-Timing %s, slow log %s",
+        Trace::usingTsc() ? "rdtsc" : "monotonic",
+        global.serverTiming ? "on" : "off",
+        global.slowRequestMs ? std::to_string(global.slowRequestMs) + " ms"
+                             : std::string("off"));
+  FileUtils::configureCache(global.fileCacheSize, global.fileCacheMaxEntrySize,
+                            global.fileCacheValidMs);
+  OpenFileCache::configure(global.openFileCacheEntries,
+                           global.openFileCacheValidMs,
+                           global.openFileCacheErrors);
+  ResponseCache::configure(global.responseCacheEntries, global.fileCacheSize,
+                           global.fileCacheMaxEntrySize,
+                           global.fileCacheValidMs);
+  NegativeCache::configure(global.negativeCacheEntries,
+                           global.negativeCacheValidMs);
+  Logger::logf<LogLevel::INFO>(
+      "File cache: %zu bytes, max entry %zu bytes, revalidate every %zu ms",
+      global.fileCacheSize, global.fileCacheMaxEntrySize,
+      global.fileCacheValidMs);
+  CGIQueue::Settings cgiSettings;
+  cgiSettings.maxConcurrent = global.cgiMaxConcurrent;
+  cgiSettings.queueSize = global.cgiQueueSize;
+  cgiSettings.queueTimeoutMs = global.cgiQueueTimeoutMs;
+  CGIQueue::configure(cgiSettings);
+  CGICache::configure(global.cgiCacheEntries);
+  if (global.cgiMaxConcurrent)
+    Logger::logf<LogLevel::INFO>(
+        "CGI limit: %zu scripts, %zu queued for up to %zu ms",
+        global.cgiMaxConcurrent, global.cgiQueueSize,
+        global.cgiQueueTimeoutMs);
+
   for (const auto &[key, serverBlock] : serverConfigs) {
     try {
-      auto server = std::make_unique<Server>(&serverBlock);
+      auto server = std::make_unique<Server>(&serverBlock, &_poller);
       _servers.push_back(std::move(server));
 
       for (const auto &listen : serverBlock.listenDirectives) {
@@ -41,6 +117,52 @@ void ServerManager::initializeServers(const Config &config) {
   }
 
   Logger::logf<LogLevel::INFO>("Initialized %s servers", std::to_string(_servers.size()).c_str());
+  for (const auto &[key, serverBlock] : serverConfigs)
+    for (const auto &[path, location] : serverBlock.locations)
+      CGIWorkers::prestart(location);
+  startWarmup(config);
+}
+
+// Listeners are opened in start(), so a blocking warm-up finishes here and a
+// background one keeps going while the event loop drains it.
+void ServerManager::startWarmup(const Config &config) {
+  const GlobalBlock &global = config.getGlobal();
+  if (!global.warmup)
+    return;
+  if (global.fileCacheSize == 0) {
+    Logger::logf<LogLevel::WARN>("Warm-up skipped: file cache is off");
+    return;
+  }
+
+  std::vector<std::string> roots;
+  for (const auto &[key, serverBlock] : config.getServers()) {
+    if (!serverBlock.root.empty())
+      roots.push_back(serverBlock.root);
+    for (const auto &[path, location] : serverBlock.locations)
+      if (!location.root.empty())
+        roots.push_back(location.root);
+  }
+
+  CacheWarmer::Settings settings;
+  settings.threads = global.warmupThreads;
+  settings.maxFileSize = global.fileCacheMaxEntrySize;
+  if (global.warmupMaxFileSize)
+    settings.maxFileSize = std::min(settings.maxFileSize,
+                                    global.warmupMaxFileSize);
+  settings.budget = global.fileCacheSize;
+  if (global.warmupBudget)
+    settings.budget = std::min(settings.budget, global.warmupBudget);
+
+  Logger::logf<LogLevel::INFO>(
+      "Warm-up: %zu threads, files up to %zu bytes, budget %zu bytes (%s)",
+      settings.threads, settings.maxFileSize, settings.budget,
+      global.warmupBackground ? "background" : "blocking");
+  _warmer.start(roots, settings);
+  if (global.warmupBackground)
+    return;
+  while (_warmer.drain(std::chrono::milliseconds(200)))
+    if (!g_running.load())
+      _warmer.stop();
 }
 
 void ServerManager::setupServerSockets() {
@@ -75,9 +197,72 @@ bool ServerManager::start() {
     while (_running && g_running.load()) {
       processEvents(1000);
       checkAllTimeouts();
+      CGIQueue::dispatch(std::chrono::steady_clock::now());
+      if (_warmer.active())
+        _warmer.drain();
+      AccessLog::tick();
+      CGIWorkers::reapIdle(std::chrono::steady_clock::now());
     }
 
+    _warmer.stop();
+    CGIWorkers::stop();
+    FileCache::Stats stats = FileUtils::cacheStats();
+    Logger::logf<LogLevel::INFO>(
+        "File cache stats: hits=%zu misses=%zu evictions=%zu rejected=%zu "
+        "invalidations=%zu entries=%zu bytes=%zu",
+        stats.hits, stats.misses, stats.evictions, stats.rejected,
+        stats.invalidations, stats.entries, stats.bytes);
+    OpenFileCache::Stats openStats = OpenFileCache::stats();
+    Logger::logf<LogLevel::INFO>(
+        "Open file cache stats: hits=%zu misses=%zu error_hits=%zu "
+        "evictions=%zu entries=%zu",
+        openStats.hits, openStats.misses, openStats.errorHits,
+        openStats.evictions, openStats.entries);
+    ResponseCache::Stats responseStats = ResponseCache::stats();
+    Logger::logf<LogLevel::INFO>(
+        "Response cache stats: hits=%zu misses=%zu not_modified=%zu "
+        "invalidations=%zu entries=%zu bytes=%zu",
+        responseStats.hits, responseStats.misses, responseStats.notModified,
+        responseStats.invalidations, responseStats.entries,
+        responseStats.bytes);
+    NegativeCache::Stats negativeStats = NegativeCache::stats();
+    Logger::logf<LogLevel::INFO>(
+        "Negative cache stats: hits=%zu misses=%zu inserts=%zu evictions=%zu "
+        "invalidations=%zu entries=%zu",
+        negativeStats.hits, negativeStats.misses, negativeStats.inserts,
+        negativeStats.evictions, negativeStats.invalidations,
+        negativeStats.entries);
+    CGIWorkers::Stats workerStats = CGIWorkers::stats();
+    if (workerStats.spawned)
+      Logger::logf<LogLevel::INFO>(
+          "CGI worker stats: spawned=%zu requests=%zu retired=%zu reaped=%zu "
+          "lost=%zu",
+          workerStats.spawned, workerStats.requests, workerStats.retired,
+          workerStats.reaped, workerStats.lost);
+    CGIQueue::Stats queueStats = CGIQueue::stats();
+    if (queueStats.queued || queueStats.rejected)
+      Logger::logf<LogLevel::INFO>(
+          "CGI queue stats: admitted=%zu queued=%zu rejected=%zu "
+          "timed_out=%zu",
+          queueStats.admitted, queueStats.queued, queueStats.rejected,
+          queueStats.timedOut);
+    CGICache::Stats cgiCacheStats = CGICache::stats();
+    if (cgiCacheStats.hits || cgiCacheStats.misses)
+      Logger::logf<LogLevel::INFO>(
+          "CGI cache stats: hits=%zu stale=%zu misses=%zu collapsed=%zu "
+          "stores=%zu uncacheable=%zu entries=%zu",
+          cgiCacheStats.hits, cgiCacheStats.stale, cgiCacheStats.misses,
+          cgiCacheStats.collapsed, cgiCacheStats.stores,
+          cgiCacheStats.uncacheable, cgiCacheStats.entries);
+    AccessLog::close();
+    AccessLog::Stats accessStats = AccessLog::stats();
+    if (accessStats.records || accessStats.skipped)
+      Logger::logf<LogLevel::INFO>(
+          "Access log stats: records=%zu skipped=%zu writes=%zu bytes=%zu",
+          accessStats.records, accessStats.skipped, accessStats.writes,
+          accessStats.bytes);
     Logger::logf<LogLevel::INFO>("Server manager stopped");
+    Logger::stopAsync();
     return true;
   } catch (const std::exception &e) {
     Logger::logf<LogLevel::ERROR>("Error in server manager: %s", e.what());
@@ -122,17 +307,13 @@ void ServerManager::dispatchEvent(const struct pollfd &pfd) {
 
   if (serverIt != _socketToServerMap.end()) {
     size_t serverIndex = serverIt->second;
-    int clientFd = _servers[serverIndex]->acceptConnection();
-    if (clientFd > 0)
-      _poller.add(clientFd, POLLIN);
+    _servers[serverIndex]->acceptConnection();
     return;
   }
 
   for (auto &server : _servers) {
-    if (server->hasClient(pfd.fd)) {
-      server->handleClient(pfd.fd);
-      if (!server->hasClient(pfd.fd))
-        _poller.remove(pfd.fd);
+    if (server->hasClient(pfd.fd) || server->hasCgi(pfd.fd)) {
+      server->handleEvent(pfd);
       return;
     }
   }
@@ -0,0 +1,51 @@
+#include "utils/FileBuffer.hpp"
+#include "utils/Constants.hpp"
+#include <cerrno>
+#include <sys/mman.h>
+#include <unistd.h>
+
+FileBuffer::~FileBuffer() {
+  if (_mapped)
+    munmap(const_cast<char *>(_data), _size);
+}
+
+FileBufferPtr FileBuffer::fromFd(int fd, size_t size, int *mapError) {
+  std::shared_ptr<FileBuffer> buffer(new FileBuffer());
+
+  if (size >= Constants::MMAP_THRESHOLD) {
+    void *addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr != MAP_FAILED) {
+      madvise(addr, size, MADV_SEQUENTIAL);
+      buffer->_data = static_cast<const char *>(addr);
+      buffer->_size = size;
+      buffer->_mapped = true;
+      return buffer;
+    }
+    if (mapError)
+      *mapError = errno;
+  }
+
+  buffer->_heap.resize(size);
+  size_t total = 0;
+  while (total < size) {
+    ssize_t n = pread(fd, &buffer->_heap[total], size - total, total);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    total += static_cast<size_t>(n);
+  }
+  if (total != size)
+    return nullptr;
+  buffer->_data = buffer->_heap.data();
+  buffer->_size = size;
+  return buffer;
+}
+
+FileBufferPtr FileBuffer::fromString(std::string content) {
+  std::shared_ptr<FileBuffer> buffer(new FileBuffer());
+  buffer->_heap = std::move(content);
+  buffer->_data = buffer->_heap.data();
+  buffer->_size = buffer->_heap.size();
+  return buffer;
+}
@@ -1,12 +1,16 @@
+#include "HTTP/core/ResponseCache.hpp"
 #include "utils/Constants.hpp"
 #include "utils/FileCache.ipp"
 #include "utils/Logger.hpp"
+#include "utils/NegativeCache.hpp"
+#include "utils/OpenFileCache.hpp"
 #include "utils/Utils.hpp"
 #include "utils/ValidationUtils.hpp"
 #include <algorithm>
 #include <cctype>
 #include <cerrno>
 #include <cstdio>
+#include <cstring>
 #include <dirent.h>
 #include <fcntl.h>
 #include <filesystem>
@@ -18,48 +22,72 @@
 
 using HTTP::StatusCode;
 
-static FileCache fileCache(Constants::DEFAULT_CACHE_SIZE);
+static FileCache fileCache;
 
-static std::string readFileFromPath(const std::string &filePath,
-                                    StatusCode &status) {
-  std::string content, mimeType;
-  if (fileCache.getFile(filePath, content, mimeType)) {
+// The same file can be reached as "./www/index.html", "./www//index.html" or
+// "www/./index.html"; collapse those so lookups and invalidation agree.
+static std::string cacheKey(std::string_view path) {
+  if (path.substr(0, 2) != "./" && path.find("//") == std::string_view::npos &&
+      path.find("/./") == std::string_view::npos)
+    return std::string(path);
+  return std::filesystem::path(path).lexically_normal().string();
+}
+
+static bool loadFromPath(const std::string &filePath,
+                         FileCache::CachedFile &file, StatusCode &status) {
+  std::string key = cacheKey(filePath);
+  if (fileCache.getFile(key, file)) {
     status = StatusCode::OK;
-    return content;
+    return true;
   }
 
-  if (!FileUtils::exists(filePath)) {
+  OpenFilePtr openFile = OpenFileCache::lookup(key);
+  if (!openFile->isRegular()) {
     status = StatusCode::NOT_FOUND;
-    return "";
+    return false;
   }
-
-  std::ifstream file(filePath, std::ios::binary);
-  if (!file.is_open()) {
-    status = StatusCode::NOT_FOUND;
-    return "";
+  int mapError = 0;
+  file.content = FileBuffer::fromFd(openFile->fd, openFile->size, &mapError);
+  if (mapError)
+    Logger::logf<LogLevel::WARN>("mmap failed, falling back to read: %s",
+                                 strerror(mapError));
+  if (!file.content) {
+    status = StatusCode::INTERNAL_SERVER_ERROR;
+    return false;
   }
+  file.mimeType = FileUtils::getMimeType(filePath);
+  file.stamp = openFile->stamp;
 
-  content = std::string((std::istreambuf_iterator<char>(file)),
-                        std::istreambuf_iterator<char>());
-  file.close();
-
-  fileCache.cacheFile(filePath, content, FileUtils::getMimeType(filePath));
+  fileCache.cacheFile(key, file.content, file.mimeType, file.stamp);
   status = StatusCode::OK;
-  return content;
+  return true;
 }
 
 std::string FileUtils::readFile(std::string_view rootDir, std::string_view uri,
                                 StatusCode &status) {
+  FileBufferPtr buffer = readFileBuffer(rootDir, uri, status);
+  return buffer ? std::string(buffer->view()) : "";
+}
+
+FileBufferPtr FileUtils::readFileBuffer(std::string_view rootDir,
+                                        std::string_view uri,
+                                        StatusCode &status) {
+  FileCache::CachedFile file;
   if (!rootDir.empty()) {
     if (!ValidationUtils::isPathSafe(uri)) {
       status = StatusCode::FORBIDDEN;
-      return "";
+      return nullptr;
     }
-    std::string filePath = HttpUtils::buildPath(rootDir, uri);
-    return readFileFromPath(filePath, status);
+    loadFromPath(HttpUtils::buildPath(rootDir, uri), file, status);
   } else {
-    return readFileFromPath(std::string(uri), status);
+    loadFromPath(std::string(uri), file, status);
   }
+  return file.content;
+}
+
+bool FileUtils::loadFile(std::string_view filePath, FileCache::CachedFile &file,
+                         StatusCode &status) {
+  return loadFromPath(std::string(filePath), file, status);
 }
 
 bool FileUtils::writeFile(std::string_view rootDir, std::string_view uri,
@@ -72,7 +100,7 @@ bool FileUtils::writeFile(std::string_view rootDir, std::string_view uri,
   std::string filePath = HttpUtils::buildPath(rootDir, uri);
 
   if (writeFileContent(filePath, content)) {
-    fileCache.cacheFile(filePath, std::string(content), "text/html");
+    invalidateCache(filePath);
     status = StatusCode::CREATED;
     return true;
   }
@@ -83,7 +111,7 @@ bool FileUtils::writeFile(std::string_view rootDir, std::string_view uri,
 
 bool FileUtils::deleteFile(std::string_view rootDir, std::string_view uri,
                            StatusCode &status) {
-  Logger::logf<LogLevel::INFO>("Attempting to delete file: %s", uri.data());
+  Logger::logf<LogLevel::DEBUG>("Attempting to delete file: %s", uri.data());
   if (!ValidationUtils::isPathSafe(uri)) {
     Logger::logf<LogLevel::ERROR>("Attempted to delete unsafe path: %s", uri.data());
     status = StatusCode::FORBIDDEN;
@@ -92,7 +120,7 @@ bool FileUtils::deleteFile(std::string_view rootDir, std::string_view uri,
 
   std::string filePath = HttpUtils::buildPath(rootDir, uri);
 
-Logger::logf<LogLevel::INFO>("Resolved file path: %s", filePath.c_str());
+  Logger::logf<LogLevel::DEBUG>("Resolved file path: %s", filePath.c_str());
   struct stat fileStat;
   if (stat(filePath.c_str(), &fileStat) != 0) {
     status = StatusCode::NOT_FOUND;
@@ -105,6 +133,7 @@ Logger::logf<LogLevel::INFO>("Resolved file path: %s", filePath.c_str());
   }
 
   if (unlink(filePath.c_str()) == 0) {
+    invalidateCache(filePath);
     status = StatusCode::NO_CONTENT;
     return true;
   }
@@ -180,15 +209,43 @@ FileUtils::readFileContent(std::string_view filePath) {
                         : std::nullopt;
 }
 
+// The content goes to a temporary file in the same directory that is then
+// renamed over the target, never written in place: the old file may be
+// mapped by the file cache or a running send (see FileBuffer), which keep
+// the old inode and bytes until they let go of it.
 bool FileUtils::writeFileContent(std::string_view filePath,
                                  std::string_view content) {
-  std::ofstream file(std::string(filePath), std::ios::binary);
-  if (!file.is_open())
+  std::string target(filePath);
+  size_t slash = target.find_last_of('/');
+  std::string temp = target.substr(0, slash == std::string::npos ? 0
+                                                                  : slash + 1) +
+                     ".webserv-XXXXXX";
+  int fd = mkstemp(temp.data());
+  if (fd < 0)
     return false;
 
-  file.write(content.data(), content.size());
-  file.close();
-  return file.good();
+  struct stat existing;
+  mode_t mode = stat(target.c_str(), &existing) == 0
+                    ? existing.st_mode & 07777
+                    : 0644;
+  bool written = fchmod(fd, mode) == 0;
+  size_t offset = 0;
+  while (written && offset < content.size()) {
+    ssize_t bytes = write(fd, content.data() + offset, content.size() - offset);
+    if (bytes < 0 && errno == EINTR)
+      continue;
+    if (bytes <= 0)
+      written = false;
+    else
+      offset += static_cast<size_t>(bytes);
+  }
+  if (close(fd) != 0)
+    written = false;
+  if (!written || rename(temp.c_str(), target.c_str()) != 0) {
+    unlink(temp.c_str());
+    return false;
+  }
+  return true;
 }
 
 bool FileUtils::exists(std::string_view path) {
@@ -237,3 +294,31 @@ std::string FileUtils::getMimeType(std::string_view filePath) {
   return (it != extensionToMimeMap.end()) ? std::string(it->second)
                                           : "application/octet-stream";
 }
+
+void FileUtils::configureCache(size_t maxBytes, size_t maxEntrySize,
+                               size_t revalidateMs) {
+  fileCache.configure(maxBytes, maxEntrySize);
+  fileCache.setRevalidateInterval(std::chrono::milliseconds(revalidateMs));
+}
+
+void FileUtils::invalidateCache(std::string_view filePath) {
+  std::string key = cacheKey(filePath);
+  fileCache.removeFile(key);
+  OpenFileCache::invalidate(key);
+  NegativeCache::invalidatePath(key);
+  ResponseCache::invalidateFile(key);
+}
+
+void FileUtils::preloadFile(std::string_view filePath,
+                            const FileCache::CachedFile &file) {
+  fileCache.cacheFile(cacheKey(filePath), file.content, file.mimeType,
+                      file.stamp);
+}
+
+std::string FileUtils::normalizePath(std::string_view filePath) {
+  return cacheKey(filePath);
+}
+
+FileCache::Stats FileUtils::cacheStats() { return fileCache.getStats(); }
+
+size_t FileUtils::cacheMaxEntrySize() { return fileCache.getMaxEntrySize(); }
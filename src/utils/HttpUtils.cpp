@@ -5,8 +5,10 @@
 #include <algorithm>
 #include <cstdlib>
 #include <filesystem>
+#include <iomanip>
 #include <map>
 #include <sstream>
+#include <strings.h>
 #include <vector>
 
 std::string HttpUtils::getEffectiveRoot(std::string_view root) {
@@ -245,3 +247,82 @@ std::string HttpUtils::cleanUri(std::string_view uri) {
              ? std::string(uri.substr(0, queryPos))
              : std::string(uri);
 }
+
+std::string HttpUtils::formatHttpDate(time_t time) {
+  struct tm tm;
+  gmtime_r(&time, &tm);
+  char buffer[64];
+  size_t len = strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+  return std::string(buffer, len);
+}
+
+// Every response carries a Date header; formatting it once per second keeps
+// strftime off the hot path.
+const std::string &HttpUtils::currentHttpDate() {
+  static time_t cachedSecond = 0;
+  static std::string cachedDate;
+  time_t now = std::time(nullptr);
+  if (now != cachedSecond) {
+    cachedSecond = now;
+    cachedDate = formatHttpDate(now);
+  }
+  return cachedDate;
+}
+
+bool HttpUtils::parseHttpDate(std::string_view date, time_t &result) {
+  std::istringstream ss{std::string(date)};
+  struct tm tm = {};
+  ss >> std::get_time(&tm, "%a, %d %b %Y %H:%M:%S GMT");
+  if (ss.fail())
+    return false;
+  result = timegm(&tm);
+  return true;
+}
+
+std::string HttpUtils::makeETag(const FileCache::FileStamp &stamp) {
+  std::ostringstream ss;
+  ss << '"' << std::hex << stamp.mtimeSec << '-' << stamp.size << '"';
+  return ss.str();
+}
+
+// RFC 9110 13.2.2: If-None-Match takes precedence; If-Modified-Since is only
+// evaluated when the client sent no entity tags.
+bool HttpUtils::isNotModified(const std::map<std::string, std::string> &headers,
+                              std::string_view etag, time_t lastModified) {
+  auto inm = headers.find("If-None-Match");
+  if (inm != headers.end()) {
+    std::string_view tags = inm->second;
+    if (trimWhitespace(tags) == "*")
+      return true;
+    size_t pos = 0;
+    while (pos < tags.size()) {
+      size_t comma = tags.find(',', pos);
+      std::string_view tag = trimWhitespace(
+          tags.substr(pos, comma == std::string_view::npos ? std::string_view::npos
+                                                           : comma - pos));
+      if (tag.substr(0, 2) == "W/")
+        tag.remove_prefix(2);
+      if (tag == etag)
+        return true;
+      if (comma == std::string_view::npos)
+        break;
+      pos = comma + 1;
+    }
+    return false;
+  }
+
+  auto ims = headers.find("If-Modified-Since");
+  time_t since;
+  return ims != headers.end() && parseHttpDate(ims->second, since) &&
+         lastModified <= since;
+}
+
+const std::string *
+HttpUtils::findHeader(const std::map<std::string, std::string> &headers,
+                      std::string_view name) {
+  for (const auto &[key, value] : headers)
+    if (key.size() == name.size() &&
+        strncasecmp(key.data(), name.data(), name.size()) == 0)
+      return &value;
+  return nullptr;
+}
@@ -0,0 +1,60 @@
+#include "utils/LogRing.hpp"
+#include <cstring>
+
+static size_t roundUpPowerOfTwo(size_t value) {
+  size_t result = 2;
+  while (result < value)
+    result <<= 1;
+  return result;
+}
+
+LogRing::LogRing(size_t capacity)
+    : _slots(new Slot[roundUpPowerOfTwo(capacity)]),
+      _mask(roundUpPowerOfTwo(capacity) - 1), _tail(0), _head(0) {
+  for (size_t i = 0; i <= _mask; ++i)
+    _slots[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+bool LogRing::push(LogLevel level, int64_t timeUs, std::string_view text) {
+  size_t pos = _tail.load(std::memory_order_relaxed);
+  Slot *slot;
+  for (;;) {
+    slot = &_slots[pos & _mask];
+    size_t sequence = slot->sequence.load(std::memory_order_acquire);
+    intptr_t diff =
+        static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+    if (diff == 0) {
+      if (_tail.compare_exchange_weak(pos, pos + 1,
+                                      std::memory_order_relaxed))
+        break;
+    } else if (diff < 0) {
+      return false; // the consumer has not freed this slot yet
+    } else {
+      pos = _tail.load(std::memory_order_relaxed);
+    }
+  }
+
+  LogRecord &record = slot->record;
+  record.timeUs = timeUs;
+  record.level = level;
+  record.truncated = text.size() > sizeof(record.text);
+  record.length = static_cast<uint16_t>(
+      record.truncated ? sizeof(record.text) : text.size());
+  std::memcpy(record.text, text.data(), record.length);
+  slot->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+bool LogRing::pop(LogRecord &record) {
+  Slot &slot = _slots[_head & _mask];
+  if (slot.sequence.load(std::memory_order_acquire) != _head + 1)
+    return false;
+  record.timeUs = slot.record.timeUs;
+  record.level = slot.record.level;
+  record.length = slot.record.length;
+  record.truncated = slot.record.truncated;
+  std::memcpy(record.text, slot.record.text, record.length);
+  slot.sequence.store(_head + _mask + 1, std::memory_order_release);
+  ++_head;
+  return true;
+}
@@ -1,10 +1,32 @@
 #include "utils/Logger.hpp"
+#include "utils/LogRing.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <thread>
+
+struct Logger::AsyncState {
+  LogRing ring;
+  AsyncSettings settings;
+  std::thread writer;
+  std::atomic<bool> stop;
+  std::atomic<size_t> written;
+  std::atomic<size_t> dropped;
+  std::atomic<size_t> blocked;
+
+  explicit AsyncState(const AsyncSettings &asyncSettings)
+      : ring(asyncSettings.bufferRecords), settings(asyncSettings),
+        stop(false), written(0), dropped(0), blocked(0) {}
+};
 
 LogLevel Logger::_currentLevel = LogLevel::INFO;
 std::ofstream Logger::_logFile;
 bool Logger::_logToFile = false;
 bool Logger::_logToConsole = true;
 bool Logger::_useColors = true;
+std::unique_ptr<Logger::AsyncState> Logger::_async;
 
 const std::string Logger::COLOR_RESET = "\033[0m";
 const std::string Logger::COLOR_DEBUG = "\033[36m";
@@ -29,19 +51,34 @@ void Logger::disableFileLogging() noexcept {
   _logToFile = false;
 }
 
-std::string Logger::getCurrentTime() {
-  auto now = std::chrono::system_clock::now();
-  auto time_t = std::chrono::system_clock::to_time_t(now);
-  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-                now.time_since_epoch()) %
-            1000;
+static int64_t nowMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
 
-  std::stringstream ss;
-  ss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
-  ss << '.' << std::setfill('0') << std::setw(3) << ms.count();
-  return ss.str();
+// localtime() runs once per second of log time; the writer thread is the
+// only caller in async mode and the event loop otherwise.
+static std::string formatTimestamp(int64_t timeUs) {
+  static thread_local int64_t cachedSecond = -1;
+  static thread_local std::string cachedPrefix;
+
+  int64_t second = timeUs / 1000000;
+  if (second != cachedSecond) {
+    std::time_t time = static_cast<std::time_t>(second);
+    std::stringstream ss;
+    ss << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S");
+    cachedPrefix = ss.str();
+    cachedSecond = second;
+  }
+  char millis[8];
+  std::snprintf(millis, sizeof(millis), ".%03d",
+                static_cast<int>(timeUs / 1000 % 1000));
+  return cachedPrefix + millis;
 }
 
+std::string Logger::getCurrentTime() { return formatTimestamp(nowMicros()); }
+
 std::string Logger::levelToString(LogLevel level) {
   switch (level) {
   case LogLevel::DEBUG:
@@ -76,27 +113,146 @@ std::string Logger::getColorForLevel(LogLevel level) {
   }
 }
 
+void Logger::appendLine(std::string &console, std::string &file,
+                        LogLevel level, std::string_view timestamp,
+                        std::string_view message) {
+  std::string levelStr = levelToString(level);
+  if (_logToConsole) {
+    console.append("[").append(timestamp).append("] ");
+    console.append(getColorForLevel(level)).append("[").append(levelStr);
+    console.append("]").append(_useColors ? COLOR_RESET : "").append(" ");
+    console.append(message).append("\n");
+  }
+  if (_logToFile && _logFile.is_open()) {
+    file.append("[").append(timestamp).append("] [").append(levelStr);
+    file.append("] ").append(message).append("\n");
+  }
+}
+
+void Logger::writeOut(std::string &console, std::string &file) {
+  if (!console.empty()) {
+    std::cout.write(console.data(), console.size());
+    std::cout.flush();
+    console.clear();
+  }
+  if (!file.empty()) {
+    _logFile.write(file.data(), file.size());
+    _logFile.flush();
+    file.clear();
+  }
+}
+
 void Logger::writeLog(LogLevel level, std::string_view message) {
   if (level < _currentLevel) {
     return;
   }
 
-  std::string timestamp = getCurrentTime();
-  std::string levelStr = levelToString(level);
+  if (_async) {
+    AsyncState &state = *_async;
+    int64_t timeUs = nowMicros();
+    if (state.ring.push(level, timeUs, message))
+      return;
+    if (!state.settings.blockWhenFull) {
+      state.dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    state.blocked.fetch_add(1, std::memory_order_relaxed);
+    while (!state.ring.push(level, timeUs, message))
+      std::this_thread::yield();
+    return;
+  }
 
-  if (_logToConsole) {
-    std::string colorCode = getColorForLevel(level);
-    std::string resetCode = _useColors ? COLOR_RESET : "";
+  std::string console;
+  std::string file;
+  appendLine(console, file, level, getCurrentTime(), message);
+  writeOut(console, file);
+}
 
-    std::cout << "[" << timestamp << "] " << colorCode << "[" << levelStr << "]"
-              << resetCode << " " << message << std::endl;
+void Logger::runWriter(AsyncState &state) {
+  std::chrono::milliseconds interval(state.settings.flushIntervalMs);
+  std::chrono::milliseconds idle =
+      std::max(std::chrono::milliseconds(1), interval);
+  std::chrono::steady_clock::time_point lastWrite =
+      std::chrono::steady_clock::now();
+  size_t reportedDrops = 0;
+  std::string console;
+  std::string file;
+  LogRecord record;
+
+  for (;;) {
+    // Read before draining: once set, producers are done and this pass
+    // empties the ring for good.
+    bool stopping = state.stop.load(std::memory_order_acquire);
+    bool popped = false;
+    while (state.ring.pop(record)) {
+      popped = true;
+      std::string_view text(record.text, record.length);
+      std::string line;
+      if (record.truncated) {
+        line.assign(text).append(" [truncated]");
+        text = line;
+      }
+      appendLine(console, file, record.level, formatTimestamp(record.timeUs),
+                 text);
+      state.written.fetch_add(1, std::memory_order_relaxed);
+      if (console.size() + file.size() >= Constants::LOG_WRITE_BATCH)
+        writeOut(console, file);
+    }
+
+    size_t dropped = state.dropped.load(std::memory_order_relaxed);
+    if (dropped != reportedDrops) {
+      std::string message = "Log buffer full: dropped " +
+                            std::to_string(dropped - reportedDrops) +
+                            " records (" + std::to_string(dropped) +
+                            " total)";
+      appendLine(console, file, LogLevel::WARN, getCurrentTime(), message);
+      reportedDrops = dropped;
+    }
+
+    std::chrono::steady_clock::time_point now =
+        std::chrono::steady_clock::now();
+    if (stopping || now - lastWrite >= interval) {
+      writeOut(console, file);
+      lastWrite = now;
+    }
+    if (stopping)
+      break;
+    if (!popped)
+      std::this_thread::sleep_for(idle);
   }
+}
 
-  if (_logToFile && _logFile.is_open()) {
-    _logFile << "[" << timestamp << "] [" << levelStr << "] " << message
-             << std::endl;
-    _logFile.flush();
+void Logger::startAsync(const AsyncSettings &settings) {
+  stopAsync();
+  static bool registered = false;
+  if (!registered) {
+    // Whatever is still queued when the process exits gets written.
+    std::atexit(stopAsync);
+    registered = true;
+  }
+  _async = std::make_unique<AsyncState>(settings);
+  _async->writer = std::thread(runWriter, std::ref(*_async));
+}
+
+void Logger::stopAsync() {
+  if (!_async)
+    return;
+  _async->stop.store(true, std::memory_order_release);
+  _async->writer.join();
+  AsyncStats stats = asyncStats();
+  _async.reset();
+  logf<LogLevel::INFO>("Async log stats: written=%zu dropped=%zu blocked=%zu",
+                       stats.written, stats.dropped, stats.blocked);
+}
+
+Logger::AsyncStats Logger::asyncStats() {
+  AsyncStats stats;
+  if (_async) {
+    stats.written = _async->written.load(std::memory_order_relaxed);
+    stats.dropped = _async->dropped.load(std::memory_order_relaxed);
+    stats.blocked = _async->blocked.load(std::memory_order_relaxed);
   }
+  return stats;
 }
 
 #ifdef DEBUG_LOGGING
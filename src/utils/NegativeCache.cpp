@@ -0,0 +1,101 @@
+#include "utils/NegativeCache.hpp"
+#include "utils/Constants.hpp"
+#include <chrono>
+#include <list>
+#include <string_view>
+#include <unordered_map>
+
+using NegativeClock = std::chrono::steady_clock;
+
+struct MissingPath {
+  std::string path;
+  NegativeClock::time_point expiresAt;
+};
+
+// Oldest first, so the front is the next to expire or be evicted.
+struct RootSet {
+  std::list<MissingPath> order;
+  std::unordered_map<std::string_view, std::list<MissingPath>::iterator> index;
+};
+
+static std::unordered_map<std::string, RootSet> roots;
+static size_t maxEntries = Constants::DEFAULT_NEGATIVE_CACHE_ENTRIES;
+static std::chrono::milliseconds
+    validInterval(Constants::DEFAULT_NEGATIVE_CACHE_VALID_MS);
+static NegativeCache::Stats counters;
+
+static void eraseFront(RootSet &set) {
+  set.index.erase(set.order.front().path);
+  set.order.pop_front();
+}
+
+void NegativeCache::configure(size_t maxEntriesPerRoot, size_t validMs) {
+  maxEntries = maxEntriesPerRoot;
+  validInterval = std::chrono::milliseconds(validMs);
+  roots.clear();
+}
+
+bool NegativeCache::contains(const std::string &root, const std::string &path) {
+  if (maxEntries == 0)
+    return false;
+  auto rootIt = roots.find(root);
+  if (rootIt == roots.end()) {
+    ++counters.misses;
+    return false;
+  }
+  RootSet &set = rootIt->second;
+  auto it = set.index.find(path);
+  if (it == set.index.end()) {
+    ++counters.misses;
+    return false;
+  }
+  if (NegativeClock::now() >= it->second->expiresAt) {
+    set.order.erase(it->second);
+    set.index.erase(it);
+    ++counters.misses;
+    return false;
+  }
+  ++counters.hits;
+  return true;
+}
+
+void NegativeCache::insert(const std::string &root, const std::string &path) {
+  if (maxEntries == 0)
+    return;
+  RootSet &set = roots[root];
+  if (set.index.count(path))
+    return;
+
+  NegativeClock::time_point now = NegativeClock::now();
+  while (!set.order.empty() && set.order.front().expiresAt <= now)
+    eraseFront(set);
+  while (set.order.size() >= maxEntries) {
+    eraseFront(set);
+    ++counters.evictions;
+  }
+  set.order.push_back(MissingPath{path, now + validInterval});
+  set.index[set.order.back().path] = std::prev(set.order.end());
+  ++counters.inserts;
+}
+
+void NegativeCache::invalidatePath(const std::string &path) {
+  for (auto &[root, set] : roots) {
+    if (set.order.empty())
+      continue;
+    if (path.size() > root.size() && path.compare(0, root.size(), root) == 0 &&
+        (path[root.size()] == '/' || root.back() == '/')) {
+      counters.invalidations += set.order.size();
+      set.index.clear();
+      set.order.clear();
+    }
+  }
+}
+
+void NegativeCache::clear() { roots.clear(); }
+
+NegativeCache::Stats NegativeCache::stats() {
+  Stats current = counters;
+  for (const auto &[root, set] : roots)
+    current.entries += set.order.size();
+  return current;
+}
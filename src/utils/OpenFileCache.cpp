@@ -0,0 +1,143 @@
+#include "utils/OpenFileCache.hpp"
+#include "utils/Constants.hpp"
+#include <cerrno>
+#include <chrono>
+#include <fcntl.h>
+#include <list>
+#include <unistd.h>
+#include <unordered_map>
+
+using OpenFileClock = std::chrono::steady_clock;
+
+struct OpenFileSlot {
+  std::string path;
+  OpenFilePtr file;
+  OpenFileClock::time_point validatedAt;
+};
+
+static std::list<OpenFileSlot> lru;
+static std::unordered_map<std::string_view, std::list<OpenFileSlot>::iterator>
+    slots;
+static size_t maxEntries = Constants::DEFAULT_OPEN_FILE_CACHE_ENTRIES;
+static std::chrono::milliseconds
+    validInterval(Constants::DEFAULT_CACHE_REVALIDATE_MS);
+static bool cacheErrors = true;
+static OpenFileCache::Stats counters;
+
+OpenFile::~OpenFile() {
+  if (fd >= 0)
+    close(fd);
+}
+
+static OpenFilePtr openPath(const std::string &path) {
+  auto file = std::make_shared<OpenFile>();
+  struct stat st;
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+  if (fd < 0) {
+    // Directories we cannot open for reading are still directories.
+    if (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+      file->isDirectory = true;
+      file->stamp = FileCache::FileStamp::fromStat(st);
+      return file;
+    }
+    file->error = errno;
+    return file;
+  }
+  if (fstat(fd, &st) != 0) {
+    file->error = errno;
+    close(fd);
+    return file;
+  }
+  file->stamp = FileCache::FileStamp::fromStat(st);
+  file->size = static_cast<size_t>(st.st_size);
+  if (S_ISDIR(st.st_mode)) {
+    file->isDirectory = true;
+    close(fd);
+  } else if (!S_ISREG(st.st_mode)) {
+    file->error = EACCES;
+    close(fd);
+  } else
+    file->fd = fd;
+  return file;
+}
+
+// Failures worth remembering: the path stays missing or forbidden until
+// the tree changes. Running out of descriptors (EMFILE, ENFILE) and the
+// like pass, so caching them would fail files that exist.
+static bool isPersistentError(int error) {
+  return error == ENOENT || error == ENOTDIR || error == EACCES;
+}
+
+static bool isFresh(OpenFileSlot &slot) {
+  OpenFileClock::time_point now = OpenFileClock::now();
+  if (now - slot.validatedAt < validInterval)
+    return true;
+  if (!slot.file->ok())
+    return false;
+  struct stat st;
+  if (stat(slot.path.c_str(), &st) != 0 ||
+      !(FileCache::FileStamp::fromStat(st) == slot.file->stamp))
+    return false;
+  slot.validatedAt = now;
+  return true;
+}
+
+static void eraseSlot(std::list<OpenFileSlot>::iterator it) {
+  slots.erase(it->path);
+  lru.erase(it);
+}
+
+void OpenFileCache::configure(size_t newMaxEntries, size_t validMs,
+                              bool newCacheErrors) {
+  maxEntries = newMaxEntries;
+  validInterval = std::chrono::milliseconds(validMs);
+  cacheErrors = newCacheErrors;
+  while (lru.size() > maxEntries)
+    eraseSlot(std::prev(lru.end()));
+}
+
+OpenFilePtr OpenFileCache::lookup(const std::string &path) {
+  auto it = slots.find(path);
+  if (it != slots.end()) {
+    if (isFresh(*it->second)) {
+      lru.splice(lru.begin(), lru, it->second);
+      OpenFilePtr file = it->second->file;
+      if (file->ok())
+        ++counters.hits;
+      else
+        ++counters.errorHits;
+      return file;
+    }
+    eraseSlot(it->second);
+  }
+  ++counters.misses;
+
+  OpenFilePtr file = openPath(path);
+  if (maxEntries == 0 ||
+      (!file->ok() && (!cacheErrors || !isPersistentError(file->error))))
+    return file;
+  while (lru.size() >= maxEntries) {
+    eraseSlot(std::prev(lru.end()));
+    ++counters.evictions;
+  }
+  lru.push_front(OpenFileSlot{path, file, OpenFileClock::now()});
+  slots[lru.front().path] = lru.begin();
+  return file;
+}
+
+void OpenFileCache::invalidate(const std::string &path) {
+  auto it = slots.find(path);
+  if (it != slots.end())
+    eraseSlot(it->second);
+}
+
+void OpenFileCache::clear() {
+  slots.clear();
+  lru.clear();
+}
+
+OpenFileCache::Stats OpenFileCache::stats() {
+  Stats current = counters;
+  current.entries = lru.size();
+  return current;
+}
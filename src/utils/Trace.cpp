@@ -0,0 +1,120 @@
+#include "utils/Trace.hpp"
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRACE_HAVE_TSC 1
+#endif
+
+static thread_local Trace::Request *current = nullptr;
+static bool tscMode = false;
+static Trace::Settings settings;
+static double millisPerTick = 1e-6; // steady_clock ticks are nanoseconds
+
+static const char *const PHASE_NAMES[Trace::PHASE_COUNT] = {
+    "recv", "parse", "route", "cache", "file",
+    "cgi-spawn", "cgi-wait", "handler", "send"};
+
+static uint64_t steadyNanos() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+bool Trace::configure(const Settings &newSettings) {
+  settings = newSettings;
+  tscMode = false;
+  millisPerTick = 1e-6;
+  if (!settings.useTsc)
+    return true;
+#ifdef TRACE_HAVE_TSC
+  // Calibrate once against the monotonic clock; 20 ms keeps the error well
+  // below a percent on any invariant TSC.
+  uint64_t wallStart = steadyNanos();
+  uint64_t tscStart = __rdtsc();
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  uint64_t tscEnd = __rdtsc();
+  uint64_t wallEnd = steadyNanos();
+  if (tscEnd <= tscStart || wallEnd <= wallStart)
+    return false;
+  millisPerTick = static_cast<double>(wallEnd - wallStart) / 1e6 /
+                  static_cast<double>(tscEnd - tscStart);
+  tscMode = true;
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool Trace::usingTsc() { return tscMode; }
+
+bool Trace::enabled() {
+  return settings.serverTiming || settings.slowRequestMs > 0;
+}
+
+bool Trace::serverTimingEnabled() { return settings.serverTiming; }
+
+size_t Trace::slowRequestMs() { return settings.slowRequestMs; }
+
+uint64_t Trace::now() {
+#ifdef TRACE_HAVE_TSC
+  if (tscMode)
+    return __rdtsc();
+#endif
+  return steadyNanos();
+}
+
+double Trace::toMillis(uint64_t ticks) {
+  return static_cast<double>(ticks) * millisPerTick;
+}
+
+Trace::Span::Span(Phase phase)
+    : _request(current), _phase(phase), _start(_request ? now() : 0) {}
+
+void Trace::Span::finish() {
+  if (_request)
+    _request->ticks[_phase] += now() - _start;
+  _request = nullptr;
+}
+
+Trace::Scope::Scope(Request *request) : _previous(current) {
+  current = request;
+}
+
+Trace::Scope::~Scope() { current = _previous; }
+
+static void appendMillis(std::string &out, double millis) {
+  char number[32];
+  std::snprintf(number, sizeof(number), "%.3f", millis);
+  out += number;
+}
+
+std::string Trace::serverTiming(const Request &request) {
+  std::string out;
+  for (size_t i = 0; i < PHASE_COUNT; ++i) {
+    if (!request.ticks[i])
+      continue;
+    out.append(PHASE_NAMES[i]).append(";dur=");
+    appendMillis(out, toMillis(request.ticks[i]));
+    out.append(", ");
+  }
+  out.append("total;dur=");
+  appendMillis(out, toMillis(now() - request.startedAt));
+  return out;
+}
+
+std::string Trace::summary(const Request &request) {
+  std::string out = "total=";
+  appendMillis(out, toMillis(now() - request.startedAt));
+  out += "ms";
+  for (size_t i = 0; i < PHASE_COUNT; ++i) {
+    if (!request.ticks[i])
+      continue;
+    out.append(" ").append(PHASE_NAMES[i]).append("=");
+    appendMillis(out, toMillis(request.ticks[i]));
+    out += "ms";
+  }
+  return out;
+}
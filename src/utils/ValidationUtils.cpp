@@ -1,8 +1,5 @@
 #include "utils/ValidationUtils.hpp"
 #include "HTTP/core/HTTPTypes.hpp"
-#include "HTTP/routing/RequestRouter.hpp"
-#include "config/LocationBlock.hpp"
-#include "config/ServerBlock.hpp"
 #include "utils/Logger.hpp"
 #include "utils/Utils.hpp"
 #include <string_view>
@@ -32,38 +29,6 @@ bool ValidationUtils::validateContentLength(const std::string &length,
   }
 }
 
-bool ValidationUtils::validateContentLengthWithRouter(const std::string &length, const std::string &uri, size_t &result, const RequestRouter *router) {
-  try {
-    result = std::stoull(length);
-    size_t maxSize = getMaxBodySize(uri, router);
-    if (!validateLimit(result, maxSize, "HTTP/1.1 Error: Body size too large")) {
-      return false;
-    }
-    return true;
-  } catch (...) {
-    Logger::error("HTTP/1.1 Error: Invalid Content-Length format");
-    return false;
-  }
-}
-
-size_t ValidationUtils::getMaxBodySize(const std::string &uri, const RequestRouter *router) {
-  if (!router) {
-    return Constants::MAX_TOTAL_SIZE;
-  }
-  
-  const LocationBlock *location = router->findLocation(uri);
-  if (location && location->clientMaxBodySize > 0) {
-    return location->clientMaxBodySize;
-  }
-  
-  const ServerBlock *serverConfig = router->getConfig();
-  if (serverConfig && serverConfig->clientMaxBodySize > 0) {
-    return serverConfig->clientMaxBodySize;
-  }
-  
-  return Constants::MAX_TOTAL_SIZE;
-}
-
 bool ValidationUtils::validateHeaderSize(const std::string &data,
                                          size_t maxSize) {
   size_t headerEnd = data.find("\r\n\r\n");
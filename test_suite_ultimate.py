@@ -24,9 +24,13 @@ import tempfile
 import json
 import statistics
 import signal
+import hashlib
+import random
+import re
 from concurrent.futures import ThreadPoolExecutor, as_completed
 from datetime import datetime
 from typing import Dict, List, Tuple, Optional, Any
+from urllib.parse import quote
 
 class Colors:
     """ANSI color codes for terminal output"""
@@ -1427,6 +1431,1640 @@ print("</body></html>")
             except:
                 pass  # Virtual host errors are acceptable
 
+    # ========== DEDICATED SERVER HELPERS ==========
+
+    def _start_dedicated_server(self, port: int, server_body: str,
+                                global_directives: str = "",
+                                in_root: bool = False,
+                                files: Optional[Dict[str, bytes]] = None
+                                ) -> Tuple[subprocess.Popen, str]:
+        """Start ./webserv on its own port with a generated config, for
+        features the main config leaves off. Returns the process and the
+        document root, a fresh temporary directory, which {root} in
+        server_body stands for; files are written there before the start.
+        With in_root the server runs from that directory, so relative paths
+        resolve inside it. The server's output goes to webserv.log there."""
+        binary = os.path.abspath(os.environ.get("WEBSERV_BIN", "./webserv"))
+        if not os.access(binary, os.X_OK):
+            raise Exception(f"webserv binary not found at {binary}")
+
+        root = tempfile.mkdtemp(prefix="webserv_test_")
+        for name, content in (files or {}).items():
+            self._write_file(root, name, content)
+        config_path = os.path.join(root, "test.conf")
+        with open(config_path, "w") as f:
+            f.write(f"""{global_directives}
+server {{
+    listen {port};
+    host 127.0.0.1;
+    root {root};
+{server_body.replace("{root}", root)}
+}}
+""")
+        with open(os.path.join(root, "webserv.log"), "w") as log:
+            process = subprocess.Popen([binary, config_path],
+                                       stdout=log, stderr=subprocess.STDOUT,
+                                       cwd=root if in_root else None)
+        for _ in range(50):
+            try:
+                socket.create_connection(("127.0.0.1", port), timeout=1).close()
+                return process, root
+            except OSError:
+                if process.poll() is not None:
+                    break
+                time.sleep(0.1)
+        self._stop_dedicated_server(process, root)
+        raise Exception(f"Dedicated webserv on port {port} did not start")
+
+    def _stop_dedicated_server(self, process: subprocess.Popen, root: str) -> None:
+        """Stop a server from _start_dedicated_server and remove its root"""
+        import shutil
+        if process.poll() is None:
+            process.send_signal(signal.SIGINT)
+            try:
+                process.wait(timeout=5)
+            except subprocess.TimeoutExpired:
+                process.kill()
+                process.wait()
+        shutil.rmtree(root, ignore_errors=True)
+
+    def _write_script(self, root: str, name: str, content: str) -> None:
+        """Write an executable CGI script below a dedicated server's root"""
+        path = os.path.join(root, name)
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        with open(path, "w") as f:
+            f.write(content)
+        os.chmod(path, 0o755)
+
+    # ========== LOCATION MATCHING TESTS ==========
+
+    def test_location_modifiers(self) -> None:
+        """Test =, ^~, ~ and ~* locations and their precedence"""
+        port = 8180
+        locations = """
+    location / {
+        return 301 /hit/root;
+    }
+    location /docs {
+        return 301 /hit/prefix;
+    }
+    location /docs/deep {
+        return 301 /hit/longer-prefix;
+    }
+    location = /docs {
+        return 301 /hit/exact;
+    }
+    location ^~ /static {
+        return 301 /hit/no-regex-prefix;
+    }
+    location ~ \\.txt$ {
+        return 301 /hit/regex;
+    }
+    location ~ both {
+        return 301 /hit/second-regex;
+    }
+    location ~* \\.png$ {
+        return 301 /hit/case-insensitive-regex;
+    }
+"""
+        process, root = self._start_dedicated_server(port, locations)
+        try:
+            cases = [
+                ("/", "/hit/root"),
+                ("/docs", "/hit/exact"),                    # = beats the prefix
+                ("/docs/", "/hit/prefix"),
+                ("/docs/page.html", "/hit/prefix"),
+                ("/docs/deep/page.html", "/hit/longer-prefix"),  # longest prefix
+                ("/docs/notes.txt", "/hit/regex"),          # regex beats prefix
+                ("/static/notes.txt", "/hit/no-regex-prefix"),  # ^~ skips regexes
+                ("/img/photo.png", "/hit/case-insensitive-regex"),
+                ("/img/PHOTO.PNG", "/hit/case-insensitive-regex"),
+                ("/upper/NOTES.TXT", "/hit/root"),          # ~ is case-sensitive
+                ("/both.txt", "/hit/regex"),                # first regex in file order
+                ("/x/both", "/hit/second-regex"),
+            ]
+            failures = []
+            for path, expected in cases:
+                response = requests.get(f"http://127.0.0.1:{port}{path}",
+                                        allow_redirects=False, timeout=5)
+                location = response.headers.get("Location", "")
+                if response.status_code != 301 or not location.endswith(expected):
+                    failures.append(f"{path}: {response.status_code} {location}")
+            if failures:
+                raise Exception(f"Wrong location matched: {failures}")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    def _raw_get(self, port: int, path: str) -> str:
+        """Status line of a GET sent verbatim, so the path is not normalized
+        on the way out"""
+        sock = socket.create_connection(("127.0.0.1", port), timeout=5)
+        sock.sendall(f"GET {path} HTTP/1.1\r\nHost: localhost\r\n"
+                     f"Connection: close\r\n\r\n".encode())
+        data = b""
+        while b"\r\n" not in data:
+            chunk = sock.recv(4096)
+            if not chunk:
+                break
+            data += chunk
+        sock.close()
+        return data.split(b"\r\n", 1)[0].decode("latin-1")
+
+    def test_response_cache_per_location(self) -> None:
+        """Test that URIs routed to different locations never share a
+        response cache entry"""
+        port = 8180
+        locations = """
+    location / {
+        methods GET;
+    }
+    location = /old.html {
+        return 301 /new.html;
+    }
+    location /private {
+        methods POST;
+    }
+"""
+        process, root = self._start_dedicated_server(port, locations)
+        try:
+            os.makedirs(os.path.join(root, "private"))
+            for name in ("old.html", "new.html", "private/page.html"):
+                with open(os.path.join(root, name), "w") as f:
+                    f.write(f"<p>{name}</p>")
+            cases = [
+                ("//old.html", "/old.html", "301"),
+                ("//private/page.html", "/private/page.html", "405"),
+            ]
+            for warm, target, expected in cases:
+                for _ in range(2):
+                    status = self._raw_get(port, warm)
+                    if " 200 " not in status:
+                        raise Exception(f"{warm} through location /: {status}")
+                for _ in range(2):
+                    status = self._raw_get(port, target)
+                    if f" {expected} " not in status:
+                        raise Exception(f"{target} after {warm} was cached: {status}")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    # ========== CGI STREAMING TESTS ==========
+
+    def _cgi_location(self, extra: str = "") -> str:
+        """A /scripts location running .py files from {root}/scripts"""
+        return f"""
+    location /scripts {{
+        root {{root}}/scripts;
+        methods GET POST;
+        cgi_extension .py;
+        cgi_path {sys.executable};
+        client_max_body_size 50000000;
+        cgi_timeout 30s;{extra}
+    }}
+"""
+
+    def _read_response_head(self, sock: socket.socket) -> Tuple[str, bytes]:
+        """Read up to the end of the header block; returns it and the body
+        bytes that came with it"""
+        data = b""
+        while b"\r\n\r\n" not in data:
+            chunk = sock.recv(4096)
+            if not chunk:
+                raise Exception(f"Connection closed before the head: {data[:200]!r}")
+            data += chunk
+        head, body = data.split(b"\r\n\r\n", 1)
+        return head.decode("latin-1"), body
+
+    def test_cgi_streaming_chunked(self) -> None:
+        """Test that CGI output is streamed as it is produced, chunked for
+        HTTP/1.1 and close-delimited for HTTP/1.0"""
+        port = 8181
+        process, root = self._start_dedicated_server(port, self._cgi_location())
+        try:
+            self._write_script(root, "scripts/stream.py", """import sys, time
+sys.stdout.write("Content-Type: text/plain\\r\\n\\r\\n")
+sys.stdout.flush()
+for i in range(5):
+    sys.stdout.write(f"part {i}\\n")
+    sys.stdout.flush()
+    time.sleep(0.3)
+""")
+            expected = b"".join(f"part {i}\n".encode() for i in range(5))
+
+            sock = socket.create_connection(("127.0.0.1", port), timeout=10)
+            start = time.time()
+            sock.sendall(b"GET /scripts/stream.py HTTP/1.1\r\nHost: localhost\r\n\r\n")
+            head, data = self._read_response_head(sock)
+            if "transfer-encoding: chunked" not in head.lower():
+                raise Exception(f"HTTP/1.1 CGI output not chunked: {head!r}")
+            body = b""
+            first_chunk_at = None
+            while True:
+                while b"\r\n" not in data:
+                    more = sock.recv(4096)
+                    if not more:
+                        raise Exception("Connection closed inside the chunked body")
+                    data += more
+                size_line, data = data.split(b"\r\n", 1)
+                size = int(size_line, 16)
+                while len(data) < size + 2:
+                    more = sock.recv(4096)
+                    if not more:
+                        raise Exception("Connection closed inside a chunk")
+                    data += more
+                if data[size:size + 2] != b"\r\n":
+                    raise Exception(f"Chunk of {size} bytes not followed by CRLF")
+                if size == 0:
+                    break
+                if first_chunk_at is None:
+                    first_chunk_at = time.time() - start
+                body += data[:size]
+                data = data[size + 2:]
+            sock.close()
+            if body != expected:
+                raise Exception(f"Chunked body mismatch: {body!r}")
+            if first_chunk_at is None or first_chunk_at > 1.0:
+                raise Exception(f"First chunk only after {first_chunk_at}s; output was buffered")
+
+            sock = socket.create_connection(("127.0.0.1", port), timeout=10)
+            sock.sendall(b"GET /scripts/stream.py HTTP/1.0\r\nHost: localhost\r\n\r\n")
+            head, body = self._read_response_head(sock)
+            if "transfer-encoding" in head.lower():
+                raise Exception("HTTP/1.0 client got a chunked response")
+            while True:
+                more = sock.recv(4096)
+                if not more:
+                    break
+                body += more
+            sock.close()
+            if body != expected:
+                raise Exception(f"HTTP/1.0 body mismatch: {body!r}")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    def test_cgi_streaming_backpressure(self) -> None:
+        """Test that a client that stops reading holds up a fast script
+        without stalling the server, and still gets every byte"""
+        port = 8181
+        total = 32 * 1024 * 1024
+        process, root = self._start_dedicated_server(port, self._cgi_location())
+        try:
+            self._write_script(root, "scripts/flood.py", f"""import os, sys
+out = sys.stdout.buffer
+out.write(b"Content-Type: application/octet-stream\\r\\n\\r\\n")
+block = b"x" * 65536
+for _ in range({total} // 65536):
+    out.write(block)
+out.flush()
+open(os.path.join(os.path.dirname(os.path.abspath(__file__)), "flood.done"), "w").close()
+""")
+            marker = os.path.join(root, "scripts", "flood.done")
+            with open(os.path.join(root, "index.html"), "w") as f:
+                f.write("still serving")
+
+            sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+            sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 65536)
+            sock.settimeout(10)
+            sock.connect(("127.0.0.1", port))
+            sock.sendall(b"GET /scripts/flood.py HTTP/1.0\r\nHost: localhost\r\n\r\n")
+            head, body = self._read_response_head(sock)
+            received = len(body)
+
+            time.sleep(1.5)
+            if os.path.exists(marker):
+                raise Exception("Script finished while the client was not reading")
+            start = time.time()
+            response = requests.get(f"http://127.0.0.1:{port}/index.html", timeout=5)
+            if response.status_code != 200 or time.time() - start > 1.0:
+                raise Exception("Server stalled behind a slow CGI client")
+
+            while True:
+                more = sock.recv(1 << 20)
+                if not more:
+                    break
+                received += len(more)
+            sock.close()
+            if received != total:
+                raise Exception(f"Received {received} of {total} bytes")
+            for _ in range(20):
+                if os.path.exists(marker):
+                    break
+                time.sleep(0.1)
+            else:
+                raise Exception("Script never finished after the client caught up")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    def test_cgi_streaming_client_disconnect(self) -> None:
+        """Test that a client disconnecting mid-stream kills the script and
+        leaves the server serving"""
+        port = 8181
+        process, root = self._start_dedicated_server(port, self._cgi_location())
+        try:
+            self._write_script(root, "scripts/endless.py", """import os, sys, time
+here = os.path.dirname(os.path.abspath(__file__))
+with open(os.path.join(here, "endless.pid"), "w") as f:
+    f.write(str(os.getpid()))
+sys.stdout.write("Content-Type: text/plain\\r\\n\\r\\n")
+for i in range(3000):
+    sys.stdout.write("y" * 1024 + "\\n")
+    sys.stdout.flush()
+    time.sleep(0.01)
+""")
+            sock = socket.create_connection(("127.0.0.1", port), timeout=10)
+            sock.sendall(b"GET /scripts/endless.py HTTP/1.1\r\nHost: localhost\r\n\r\n")
+            head, body = self._read_response_head(sock)
+            while len(body) < 4096:
+                body += sock.recv(4096)
+            sock.close()
+
+            with open(os.path.join(root, "scripts", "endless.pid")) as f:
+                pid = int(f.read())
+            for _ in range(30):
+                try:
+                    os.kill(pid, 0)
+                except ProcessLookupError:
+                    break
+                time.sleep(0.1)
+            else:
+                raise Exception(f"Script pid {pid} still running after the client left")
+
+            self._write_script(root, "scripts/ok.py", """import sys
+sys.stdout.write("Content-Type: text/plain\\r\\n\\r\\nok\\n")
+""")
+            response = requests.get(f"http://127.0.0.1:{port}/scripts/ok.py", timeout=5)
+            if response.status_code != 200 or response.text != "ok\n":
+                raise Exception(f"Server unhealthy after disconnect: {response.status_code}")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    def _half_closed_request(self, port: int, request: bytes) -> Tuple[str, bytes]:
+        """Send a request, shut down the sending side and read the response
+        until the server closes"""
+        sock = socket.create_connection(("127.0.0.1", port), timeout=15)
+        sock.sendall(request)
+        sock.shutdown(socket.SHUT_WR)
+        head, body = self._read_response_head(sock)
+        while True:
+            more = sock.recv(65536)
+            if not more:
+                break
+            body += more
+        sock.close()
+        return head, body
+
+    def test_cgi_half_closed_client(self) -> None:
+        """Test that a client that shuts down its sending side after the
+        request still gets the script's response, running or queued"""
+        port = 8181
+        process, root = self._start_dedicated_server(port, self._cgi_location(),
+                                                     self._CGI_LIMIT_GLOBALS)
+        try:
+            self._write_script(root, "scripts/sleep.py", self._SLEEP_SCRIPT)
+            self._write_script(root, "scripts/echo.py", """import sys
+data = sys.stdin.buffer.read()
+sys.stdout.buffer.write(b"Content-Type: text/plain\\r\\n\\r\\n" + data)
+""")
+            get = b"GET /scripts/sleep.py?0.5 HTTP/1.0\r\nHost: localhost\r\n\r\n"
+            head, body = self._half_closed_request(port, get)
+            if not head.startswith("HTTP/1.1 200") or body != b"slept\n":
+                raise Exception(f"Half-closed GET: {head.splitlines()[0]!r} {body!r}")
+
+            payload = b"z" * 200000
+            post = (b"POST /scripts/echo.py HTTP/1.0\r\nHost: localhost\r\n"
+                    b"Content-Type: application/octet-stream\r\n"
+                    b"Content-Length: " + str(len(payload)).encode() +
+                    b"\r\n\r\n" + payload)
+            head, body = self._half_closed_request(port, post)
+            if not head.startswith("HTTP/1.1 200") or body != payload:
+                raise Exception(f"Half-closed POST: {head.splitlines()[0]!r}, "
+                                f"{len(body)} of {len(payload)} bytes")
+
+            cut = (b"POST /scripts/echo.py HTTP/1.0\r\nHost: localhost\r\n"
+                   b"Content-Length: 1000\r\n\r\n")
+            sock = socket.create_connection(("127.0.0.1", port), timeout=15)
+            sock.sendall(cut)
+            time.sleep(0.3)
+            sock.sendall(b"y" * 400)
+            sock.shutdown(socket.SHUT_WR)
+            head, body = self._read_response_head(sock)
+            while True:
+                more = sock.recv(65536)
+                if not more:
+                    break
+                body += more
+            sock.close()
+            if not head.startswith("HTTP/1.1 200") or body != b"y" * 400:
+                raise Exception(f"Body cut short by a half-close: "
+                                f"{head.splitlines()[0]!r}, {len(body)} bytes")
+
+            slow = f"http://127.0.0.1:{port}/scripts/sleep.py?1"
+            with ThreadPoolExecutor(max_workers=2) as pool:
+                holders = [pool.submit(self._timed_get, slow) for _ in range(2)]
+                time.sleep(0.3)
+                head, body = self._half_closed_request(port, get)
+                if not head.startswith("HTTP/1.1 200") or body != b"slept\n":
+                    raise Exception(f"Half-closed queued GET: "
+                                    f"{head.splitlines()[0]!r} {body!r}")
+                for holder in holders:
+                    if holder.result()[0] != 200:
+                        raise Exception("Request holding a slot failed")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    _SH_SCRIPT = """printf 'Content-Type: text/plain\\r\\n\\r\\n'
+printf 'shell %s %s\\n' "$REQUEST_METHOD" "$QUERY_STRING"
+"""
+
+    def test_cgi_location_interpreters(self) -> None:
+        """Test that each location runs only its own cgi_extension list, each
+        extension with the interpreter cgi_path gives it"""
+        port = 8189
+        locations = f"""
+    location /mixed {{
+        root {{root}}/mixed;
+        methods GET;
+        cgi_extension .py .sh;
+        cgi_path {sys.executable} /bin/sh;
+    }}
+    location /pyonly {{
+        root {{root}}/pyonly;
+        methods GET;
+        cgi_extension .py;
+        cgi_path {sys.executable};
+    }}
+"""
+        py = """import sys
+sys.stdout.write("Content-Type: text/plain\\r\\n\\r\\npython\\n")
+"""
+        files = {}
+        for where in ("mixed", "pyonly"):
+            files[f"{where}/run.py"] = py.encode()
+            files[f"{where}/run.sh"] = self._SH_SCRIPT.encode()
+        process, root = self._start_dedicated_server(port, locations, files=files)
+        try:
+            cases = [
+                ("/mixed/run.py", "python\n"),
+                ("/mixed/run.sh?x=1", "shell GET x=1\n"),
+                ("/pyonly/run.py", "python\n"),
+                ("/pyonly/run.sh", self._SH_SCRIPT),   # not a script there
+            ]
+            for path, expected in cases:
+                response = requests.get(f"http://127.0.0.1:{port}{path}", timeout=5)
+                if response.status_code != 200 or response.text != expected:
+                    raise Exception(f"{path}: {response.status_code} {response.text!r}")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    def test_cgi_spawn_environment(self) -> None:
+        """Test that a CGI sees the request's meta-variables and nothing from
+        the server's own environment"""
+        port = 8189
+        locations = f"""
+    location /env {{
+        root {{root}}/env;
+        methods GET;
+        cgi_extension .py;
+        cgi_path {sys.executable};
+    }}
+"""
+        script = """import os, sys
+sys.stdout.write("Content-Type: text/plain\\r\\n\\r\\n")
+for name in sorted(os.environ):
+    sys.stdout.write(name + "=" + os.environ[name] + "\\n")
+"""
+        os.environ["WEBSERV_TEST_LEAK"] = "1"
+        try:
+            process, root = self._start_dedicated_server(
+                port, locations, files={"env/show.py": script.encode()})
+        finally:
+            del os.environ["WEBSERV_TEST_LEAK"]
+        try:
+            expected = {
+                "GATEWAY_INTERFACE": "CGI/1.1",
+                "REQUEST_METHOD": "GET",
+                "QUERY_STRING": "a=1&b=2",
+                "SERVER_PORT": str(port),
+                "SERVER_PROTOCOL": "HTTP/1.1",
+            }
+            for _ in range(2):   # the second spawn reuses the prebuilt block
+                response = requests.get(f"http://127.0.0.1:{port}/env/show.py?a=1&b=2", timeout=5)
+                if response.status_code != 200:
+                    raise Exception(f"Expected 200, got {response.status_code}")
+                env = dict(line.split("=", 1) for line in response.text.splitlines() if "=" in line)
+                for name, value in expected.items():
+                    if env.get(name) != value:
+                        raise Exception(f"{name}={env.get(name)!r}, expected {value!r}")
+                if not env.get("SCRIPT_NAME", "").endswith("/env/show.py"):
+                    raise Exception(f"SCRIPT_NAME={env.get('SCRIPT_NAME')!r}")
+                if "WEBSERV_TEST_LEAK" in env:
+                    raise Exception("Server environment leaked into the CGI")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    def test_cgi_does_not_block_others(self) -> None:
+        """Test that a slow script leaves the server answering other clients"""
+        port = 8181
+        process, root = self._start_dedicated_server(port, self._cgi_location())
+        try:
+            self._write_script(root, "scripts/sleep.py", self._SLEEP_SCRIPT)
+            with open(os.path.join(root, "index.html"), "w") as f:
+                f.write("not blocked")
+            with ThreadPoolExecutor(max_workers=1) as pool:
+                slow = pool.submit(self._timed_get,
+                                   f"http://127.0.0.1:{port}/scripts/sleep.py?2")
+                time.sleep(0.3)
+                status, elapsed, _ = self._timed_get(f"http://127.0.0.1:{port}/index.html")
+                if status != 200 or elapsed > 0.5:
+                    raise Exception(f"Static GET took {elapsed:.2f}s behind a running script")
+                if slow.done():
+                    raise Exception("Script finished before the static GET was checked")
+                status, elapsed, _ = slow.result()
+                if status != 200 or elapsed < 1.8:
+                    raise Exception(f"Slow script: {status} after {elapsed:.2f}s")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    # The header goes out on its own first, so the body takes the
+    # pipe-to-socket splice path instead of arriving along with the head.
+    _SIZED_SCRIPT = """import os, random, sys, time
+declared, sent = (int(n) for n in os.environ["QUERY_STRING"].split(","))
+out = sys.stdout.buffer
+out.write(b"Content-Type: application/octet-stream\\r\\n"
+          b"Content-Length: " + str(declared).encode() + b"\\r\\n\\r\\n")
+out.flush()
+time.sleep(0.2)
+body = random.Random(7).randbytes(sent)
+for pos in range(0, sent, 1 << 20):
+    out.write(body[pos:pos + (1 << 20)])
+out.flush()
+"""
+
+    def _read_to_close(self, port: int, path: str) -> Tuple[str, bytes]:
+        """Send a GET and read the response until the server closes"""
+        sock = socket.create_connection(("127.0.0.1", port), timeout=15)
+        sock.sendall(f"GET {path} HTTP/1.1\r\nHost: localhost\r\n"
+                     f"Connection: close\r\n\r\n".encode())
+        head, body = self._read_response_head(sock)
+        while True:
+            more = sock.recv(1 << 20)
+            if not more:
+                break
+            body += more
+        sock.close()
+        return head, body
+
+    def test_cgi_splice_content_length(self) -> None:
+        """Test that a large body with a Content-Length arrives byte-exact
+        through the splice path"""
+        port = 8187
+        process, root = self._start_dedicated_server(port, self._cgi_location())
+        try:
+            self._write_script(root, "scripts/sized.py", self._SIZED_SCRIPT)
+            size = 20 * 1024 * 1024
+            head, body = self._read_to_close(port, f"/scripts/sized.py?{size},{size}")
+            if not head.startswith("HTTP/1.1 200") or f"content-length: {size}" not in head.lower():
+                raise Exception(f"Unexpected head: {head!r}")
+            if "transfer-encoding" in head.lower():
+                raise Exception("Content-Length response was chunked")
+            expected = hashlib.md5(random.Random(7).randbytes(size)).hexdigest()
+            if len(body) != size or hashlib.md5(body).hexdigest() != expected:
+                raise Exception(f"Spliced body: {len(body)} bytes, md5 "
+                                f"{hashlib.md5(body).hexdigest()} instead of {expected}")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    def test_cgi_splice_short_body(self) -> None:
+        """Test that a script sending less than its Content-Length gets its
+        response cut short and leaves the server serving"""
+        port = 8187
+        process, root = self._start_dedicated_server(port, self._cgi_location())
+        try:
+            self._write_script(root, "scripts/sized.py", self._SIZED_SCRIPT)
+            declared, sent = 1000000, 300000
+            start = time.time()
+            head, body = self._read_to_close(port, f"/scripts/sized.py?{declared},{sent}")
+            if f"content-length: {declared}" not in head.lower():
+                raise Exception(f"Unexpected head: {head!r}")
+            if body != random.Random(7).randbytes(sent):
+                raise Exception(f"Got {len(body)} bytes, not the {sent} the script sent")
+            if time.time() - start > 5:
+                raise Exception("Short body left the connection hanging")
+            head, body = self._read_to_close(port, "/scripts/sized.py?1000,1000")
+            if not head.startswith("HTTP/1.1 200") or len(body) != 1000:
+                raise Exception("Server unhealthy after a short spliced body")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    def test_cgi_streaming_overrun(self) -> None:
+        """Test that output past a script's own Content-Length is dropped
+        rather than sent after the body it declared"""
+        port = 8181
+        process, root = self._start_dedicated_server(port, self._cgi_location())
+        try:
+            self._write_script(root, "scripts/overrun.py", """import sys
+sys.stdout.write("Content-Type: text/plain\\r\\nContent-Length: 10\\r\\n\\r\\n"
+                 "0123456789" + "EXCESS" * 5000)
+""")
+            head, body = self._read_to_close(port, "/scripts/overrun.py")
+            if "content-length: 10" not in head.lower() or body != b"0123456789":
+                raise Exception(f"Response does not match its framing: "
+                                f"{len(body)} body bytes, {body[:40]!r}")
+            if not self._wait_for_text(os.path.join(root, "webserv.log"),
+                                       "wrote past its Content-Length"):
+                raise Exception("Dropped excess output not logged")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    def test_cgi_lowercase_framing_headers(self) -> None:
+        """Test that a script's lowercase content-type and content-length
+        replace the server's own rather than going out alongside them"""
+        port = 8181
+        process, root = self._start_dedicated_server(port, self._cgi_location())
+        try:
+            # The header goes out first on its own (streamed), or together
+            # with the body (buffered).
+            self._write_script(root, "scripts/lower.py", """import os, sys, time
+out = sys.stdout.buffer
+out.write(b"content-type: text/plain\\r\\ncontent-length: 5\\r\\n\\r\\n")
+if os.environ["QUERY_STRING"] == "streamed":
+    out.flush()
+    time.sleep(0.2)
+out.write(b"hello")
+""")
+            for mode in ("streamed", "buffered"):
+                head, body = self._read_to_close(port, f"/scripts/lower.py?{mode}")
+                names = [line.split(":", 1)[0].lower()
+                         for line in head.split("\r\n")[1:] if ":" in line]
+                if (names.count("content-type") != 1 or names.count("content-length") != 1
+                        or "transfer-encoding" in names):
+                    raise Exception(f"{mode}: conflicting framing headers: {head!r}")
+                if "text/plain" not in head.lower() or body != b"hello":
+                    raise Exception(f"{mode}: unexpected response {head!r} {body!r}")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    _STDIN_DIGEST_SCRIPT = """import hashlib, os, sys
+here = os.path.dirname(os.path.abspath(__file__))
+open(os.path.join(here, "digest.started"), "w").close()
+out = sys.stdout.buffer
+if os.environ.get("QUERY_STRING") == "talk-first":
+    out.write(b"Content-Type: text/plain\\r\\n\\r\\n" + b"z" * 262144 + b"\\n")
+    out.flush()
+else:
+    out.write(b"Content-Type: text/plain\\r\\n\\r\\n")
+digest = hashlib.md5()
+length = 0
+while True:
+    block = sys.stdin.buffer.read(65536)
+    if not block:
+        break
+    digest.update(block)
+    length += len(block)
+out.write(f"{length} {digest.hexdigest()} {os.environ.get('CONTENT_LENGTH')}".encode())
+"""
+
+    def test_cgi_stdin_content_length(self) -> None:
+        """Test that a Content-Length body is fed to the script while it is
+        still arriving, including to a script that writes before reading"""
+        port = 8182
+        process, root = self._start_dedicated_server(port, self._cgi_location())
+        try:
+            self._write_script(root, "scripts/digest.py", self._STDIN_DIGEST_SCRIPT)
+            marker = os.path.join(root, "scripts", "digest.started")
+            payload = os.urandom(4 * 1024 * 1024)
+            expected = f"{len(payload)} {hashlib.md5(payload).hexdigest()} {len(payload)}"
+
+            sock = socket.create_connection(("127.0.0.1", port), timeout=15)
+            sock.sendall(f"POST /scripts/digest.py HTTP/1.1\r\nHost: localhost\r\n"
+                         f"Content-Type: application/octet-stream\r\n"
+                         f"Content-Length: {len(payload)}\r\nConnection: close\r\n\r\n".encode()
+                         + payload[:65536])
+            for _ in range(50):
+                if os.path.exists(marker):
+                    break
+                time.sleep(0.1)
+            else:
+                raise Exception("Script did not start until the whole body arrived")
+            sock.sendall(payload[65536:])
+            head, body = self._read_response_head(sock)
+            while True:
+                more = sock.recv(65536)
+                if not more:
+                    break
+                body += more
+            sock.close()
+            if "chunked" in head.lower():
+                body = self._decode_chunked(body)
+            if not head.startswith("HTTP/1.1 200") or body.decode() != expected:
+                raise Exception(f"Streamed upload mangled: {head.splitlines()[0]!r} {body[-120:]!r}")
+
+            response = requests.post(f"http://127.0.0.1:{port}/scripts/digest.py?talk-first",
+                                     data=payload, timeout=15)
+            if response.status_code != 200 or not response.text.endswith(expected):
+                raise Exception(f"Script writing before reading stdin: {response.status_code} "
+                                f"{response.text[-120:]!r}")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    def test_cgi_stdin_chunked(self) -> None:
+        """Test that a chunked upload reaches the script decoded, with its
+        decoded length as CONTENT_LENGTH"""
+        port = 8182
+        process, root = self._start_dedicated_server(port, self._cgi_location())
+        try:
+            self._write_script(root, "scripts/digest.py", self._STDIN_DIGEST_SCRIPT)
+            # Kept under the 64 KB request buffer that bounds chunked requests
+            payload = os.urandom(40000)
+            expected = f"{len(payload)} {hashlib.md5(payload).hexdigest()} {len(payload)}"
+
+            sock = socket.create_connection(("127.0.0.1", port), timeout=15)
+            sock.sendall(b"POST /scripts/digest.py HTTP/1.1\r\nHost: localhost\r\n"
+                         b"Transfer-Encoding: chunked\r\nConnection: close\r\n\r\n")
+            for offset in range(0, len(payload), 3000):
+                piece = payload[offset:offset + 3000]
+                sock.sendall(f"{len(piece):x}\r\n".encode() + piece + b"\r\n")
+                time.sleep(0.01)
+            sock.sendall(b"0\r\n\r\n")
+            head, body = self._read_response_head(sock)
+            while True:
+                more = sock.recv(65536)
+                if not more:
+                    break
+                body += more
+            sock.close()
+            if "chunked" in head.lower():
+                body = self._decode_chunked(body)
+            if not head.startswith("HTTP/1.1 200") or body.decode() != expected:
+                raise Exception(f"Chunked upload mangled: {head.splitlines()[0]!r} {body[-120:]!r}")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    def _decode_chunked(self, data: bytes) -> bytes:
+        """Decode a complete chunked body"""
+        body = b""
+        while True:
+            size_line, data = data.split(b"\r\n", 1)
+            size = int(size_line, 16)
+            if size == 0:
+                return body
+            body += data[:size]
+            data = data[size + 2:]
+
+    # ========== CGI LIMIT TESTS ==========
+
+    _SLEEP_SCRIPT = """import os, sys, time
+here = os.path.dirname(os.path.abspath(__file__))
+seconds = float(os.environ.get("QUERY_STRING") or "1")
+with open(os.path.join(here, "runs.log"), "a") as log:
+    log.write(f"start {time.time()}\\n")
+time.sleep(seconds)
+with open(os.path.join(here, "runs.log"), "a") as log:
+    log.write(f"end {time.time()}\\n")
+sys.stdout.write("Content-Type: text/plain\\r\\n\\r\\nslept\\n")
+"""
+
+    _CGI_LIMIT_GLOBALS = "cgi_max_concurrent 2;\ncgi_queue_size 2;\ncgi_queue_timeout 2s;"
+
+    def _max_overlap(self, log_path: str) -> int:
+        """Most scripts running at once according to a runs.log"""
+        events = []
+        with open(log_path) as f:
+            for line in f:
+                kind, stamp = line.split()
+                events.append((float(stamp), 1 if kind == "start" else -1))
+        running = peak = 0
+        for _, delta in sorted(events):
+            running += delta
+            peak = max(peak, running)
+        return peak
+
+    def _timed_get(self, url: str) -> Tuple[int, float, Dict[str, str]]:
+        """GET url; returns the status, seconds taken and headers"""
+        start = time.time()
+        response = requests.get(url, timeout=20)
+        return response.status_code, time.time() - start, dict(response.headers)
+
+    def test_cgi_queue_overflow(self) -> None:
+        """Test that requests over cgi_max_concurrent queue and the ones
+        beyond cgi_queue_size get 503 with Retry-After at once"""
+        port = 8183
+        process, root = self._start_dedicated_server(port, self._cgi_location(),
+                                                     self._CGI_LIMIT_GLOBALS)
+        try:
+            self._write_script(root, "scripts/sleep.py", self._SLEEP_SCRIPT)
+            url = f"http://127.0.0.1:{port}/scripts/sleep.py?1"
+            with ThreadPoolExecutor(max_workers=6) as pool:
+                results = list(pool.map(lambda _: self._timed_get(url), range(6)))
+
+            served = [r for r in results if r[0] == 200]
+            shed = [r for r in results if r[0] == 503]
+            if len(served) != 4 or len(shed) != 2:
+                raise Exception(f"Expected 4 served and 2 shed, got {[r[0] for r in results]}")
+            for _, elapsed, headers in shed:
+                if "Retry-After" not in headers:
+                    raise Exception("503 without Retry-After")
+                if elapsed > 0.8:
+                    raise Exception(f"Full queue answered only after {elapsed:.2f}s")
+            if max(r[1] for r in served) < 1.8:
+                raise Exception("No request waited for a slot")
+            peak = self._max_overlap(os.path.join(root, "scripts", "runs.log"))
+            if peak > 2:
+                raise Exception(f"{peak} scripts ran at once under cgi_max_concurrent 2")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    def test_cgi_queue_timeout(self) -> None:
+        """Test that a request still queued after cgi_queue_timeout gets 503"""
+        port = 8183
+        process, root = self._start_dedicated_server(port, self._cgi_location(),
+                                                     self._CGI_LIMIT_GLOBALS)
+        try:
+            self._write_script(root, "scripts/sleep.py", self._SLEEP_SCRIPT)
+            slow = f"http://127.0.0.1:{port}/scripts/sleep.py?5"
+            with ThreadPoolExecutor(max_workers=2) as pool:
+                holders = [pool.submit(self._timed_get, slow) for _ in range(2)]
+                time.sleep(0.5)
+                status, elapsed, headers = self._timed_get(
+                    f"http://127.0.0.1:{port}/scripts/sleep.py?0")
+                if status != 503 or "Retry-After" not in headers:
+                    raise Exception(f"Queued request past its timeout got {status}")
+                if not 1.5 <= elapsed <= 3.5:
+                    raise Exception(f"Queue timeout fired after {elapsed:.2f}s, not ~2s")
+                for holder in holders:
+                    if holder.result()[0] != 200:
+                        raise Exception("Request holding a slot failed")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    def test_cgi_location_limit(self) -> None:
+        """Test that a location's own cgi_max_concurrent serializes its
+        scripts below the server-wide limit"""
+        port = 8183
+        process, root = self._start_dedicated_server(
+            port, self._cgi_location("\n        cgi_max_concurrent 1;"),
+            self._CGI_LIMIT_GLOBALS)
+        try:
+            self._write_script(root, "scripts/sleep.py", self._SLEEP_SCRIPT)
+            url = f"http://127.0.0.1:{port}/scripts/sleep.py?0.5"
+            with ThreadPoolExecutor(max_workers=3) as pool:
+                results = list(pool.map(lambda _: self._timed_get(url), range(3)))
+            if [r[0] for r in results] != [200, 200, 200]:
+                raise Exception(f"Expected all served, got {[r[0] for r in results]}")
+            peak = self._max_overlap(os.path.join(root, "scripts", "runs.log"))
+            if peak != 1:
+                raise Exception(f"{peak} scripts ran at once under a location limit of 1")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    # ========== CGI CACHE TESTS ==========
+
+    _CACHED_SCRIPT = """import os, sys, time
+from urllib.parse import parse_qs
+here = os.path.dirname(os.path.abspath(__file__))
+query = {k: v[0] for k, v in parse_qs(os.environ.get("QUERY_STRING", "")).items()}
+with open(os.path.join(here, "runs.log"), "a") as log:
+    log.write(query.get("k", "") + "\\n")
+with open(os.path.join(here, "runs.log")) as log:
+    run = sum(1 for line in log if line.strip() == query.get("k", ""))
+time.sleep(float(query.get("sleep", "0")))
+sys.stdout.write("Content-Type: text/plain\\r\\n")
+if "cc" in query:
+    sys.stdout.write("Cache-Control: " + query["cc"] + "\\r\\n")
+if "cookie" in query:
+    sys.stdout.write("Set-Cookie: session=" + str(run) + "\\r\\n")
+sys.stdout.write("\\r\\nrun " + str(run) + "\\n")
+"""
+
+    def _start_cache_server(self) -> Tuple[subprocess.Popen, str]:
+        """A dedicated server with cgi_cache on and cached.py in place"""
+        port = 8184
+        process, root = self._start_dedicated_server(
+            port, self._cgi_location("\n        cgi_cache on;"))
+        self._write_script(root, "scripts/cached.py", self._CACHED_SCRIPT)
+        return process, root
+
+    def _cache_url(self, key: str, **params: str) -> str:
+        """URL of cached.py for key, with params as its settings"""
+        query = "&".join([f"k={key}"] + [f"{name}={quote(value)}" for name, value in params.items()])
+        return f"http://127.0.0.1:8184/scripts/cached.py?{query}"
+
+    def _script_runs(self, root: str, key: str) -> int:
+        """How often cached.py has run for key"""
+        with open(os.path.join(root, "scripts", "runs.log")) as f:
+            return sum(1 for line in f if line.strip() == key)
+
+    def test_cgi_cache_hit_and_expiry(self) -> None:
+        """Test that a cached CGI response is served with Age until its
+        max-age runs out"""
+        process, root = self._start_cache_server()
+        try:
+            url = self._cache_url("expiry", cc="max-age=2")
+            first = requests.get(url, timeout=5)
+            if first.status_code != 200 or first.text != "run 1\n":
+                raise Exception(f"First request: {first.status_code} {first.text!r}")
+            time.sleep(1.1)
+            hit = requests.get(url, timeout=5)
+            if hit.text != "run 1\n":
+                raise Exception(f"Expected a cache hit, got {hit.text!r}")
+            if int(hit.headers.get("Age", "-1")) < 1:
+                raise Exception(f"Cache hit with Age {hit.headers.get('Age')!r}")
+            time.sleep(1.5)
+            expired = requests.get(url, timeout=5)
+            if expired.text != "run 2\n":
+                raise Exception(f"Expected a fresh run after max-age, got {expired.text!r}")
+            if self._script_runs(root, "expiry") != 2:
+                raise Exception(f"Script ran {self._script_runs(root, 'expiry')} times, not 2")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    def test_cgi_cache_uncacheable(self) -> None:
+        """Test that no-store and Set-Cookie responses are never cached"""
+        process, root = self._start_cache_server()
+        try:
+            cases = {
+                "nostore": self._cache_url("nostore", cc="no-store"),
+                "cookie": self._cache_url("cookie", cc="max-age=60", cookie="1"),
+            }
+            for key, url in cases.items():
+                for expected in ("run 1\n", "run 2\n"):
+                    response = requests.get(url, timeout=5)
+                    if response.status_code != 200 or response.text != expected:
+                        raise Exception(f"{key}: expected {expected!r}, got {response.text!r}")
+                if self._script_runs(root, key) != 2:
+                    raise Exception(f"{key}: response was cached")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    def test_cgi_cache_request_headers(self) -> None:
+        """Test that Cookie requests skip the cache, Authorization ones only
+        share public responses and no-cache requests refresh the entry"""
+        process, root = self._start_cache_server()
+        try:
+            def expect(key: str, url: str, expected: str, **headers: str) -> None:
+                response = requests.get(url, headers=headers, timeout=5)
+                if response.status_code != 200 or response.text != expected:
+                    raise Exception(f"{key} {headers}: expected {expected!r}, "
+                                    f"got {response.text!r}")
+
+            url = self._cache_url("cookie", cc="max-age=60")
+            expect("cookie", url, "run 1\n")
+            expect("cookie", url, "run 2\n", Cookie="session=alice")
+            expect("cookie", url, "run 1\n")
+
+            url = self._cache_url("auth", cc="max-age=60")
+            expect("auth", url, "run 1\n")
+            expect("auth", url, "run 2\n", Authorization="Basic YWxpY2U6eA==")
+            expect("auth", url, "run 1\n")
+
+            url = self._cache_url("public", cc="public, max-age=60")
+            expect("public", url, "run 1\n", Authorization="Basic YWxpY2U6eA==")
+            expect("public", url, "run 1\n", Authorization="Basic Ym9iOng=")
+            expect("public", url, "run 1\n")
+
+            url = self._cache_url("nocache", cc="max-age=60")
+            expect("nocache", url, "run 1\n")
+            expect("nocache", url, "run 2\n", **{"Cache-Control": "no-cache"})
+            expect("nocache", url, "run 2\n")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    def test_cgi_cache_header_case(self) -> None:
+        """Test that a cached response keeps a single Content-Type and body
+        framing whatever case the script used, and that one without a
+        Content-Type gets the same fixed type on hits as on the miss"""
+        process, root = self._start_cache_server()
+        try:
+            self._write_script(root, "scripts/lower.py", """import sys
+sys.stdout.write("content-type: text/plain\\r\\ncontent-length: 6\\r\\n"
+                 "cache-control: max-age=60\\r\\n\\r\\nhello\\n")
+""")
+            self._write_script(root, "scripts/untyped.py", """import sys
+sys.stdout.write("Cache-Control: max-age=60\\r\\n\\r\\nversion 1.html\\n")
+""")
+            for path, body, content_type in (("/scripts/lower.py", b"hello\n", "text/plain"),
+                                             ("/scripts/untyped.py", b"version 1.html\n",
+                                              "application/octet-stream")):
+                for attempt in ("miss", "hit"):
+                    head, got = self._read_to_close(8184, path)
+                    headers = [line.split(":", 1) for line in head.split("\r\n")[1:] if ":" in line]
+                    names = [name.lower() for name, _ in headers]
+                    types = [value.strip() for name, value in headers
+                             if name.lower() == "content-type"]
+                    if "transfer-encoding" in names:
+                        got = self._decode_chunked(got)
+                    framing = names.count("content-length") + names.count("transfer-encoding")
+                    if types != [content_type] or framing != 1 or got != body:
+                        raise Exception(f"{path} {attempt}: {head!r} {got!r}")
+                    if attempt == "hit" and "age" not in names:
+                        raise Exception(f"{path}: second request was not a cache hit")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    def test_cgi_cache_stale_while_revalidate(self) -> None:
+        """Test that a stale response is served at once while the script
+        refreshes it in the background"""
+        process, root = self._start_cache_server()
+        try:
+            url = self._cache_url("stale", cc="max-age=1, stale-while-revalidate=30", sleep="1")
+            if requests.get(url, timeout=5).text != "run 1\n":
+                raise Exception("First request did not run the script")
+            time.sleep(1.5)
+            start = time.time()
+            stale = requests.get(url, timeout=5)
+            elapsed = time.time() - start
+            if stale.text != "run 1\n" or elapsed > 0.5:
+                raise Exception(f"Stale response {stale.text!r} took {elapsed:.2f}s")
+            time.sleep(1.5)
+            refreshed = requests.get(url, timeout=5)
+            if refreshed.text != "run 2\n":
+                raise Exception(f"Background refresh not stored: {refreshed.text!r}")
+            if self._script_runs(root, "stale") != 2:
+                raise Exception(f"Script ran {self._script_runs(root, 'stale')} times, not 2")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    def test_cgi_cache_collapsed_misses(self) -> None:
+        """Test that concurrent misses for one key run the script once"""
+        process, root = self._start_cache_server()
+        try:
+            url = self._cache_url("collapse", cc="max-age=60", sleep="1")
+            with ThreadPoolExecutor(max_workers=6) as pool:
+                responses = list(pool.map(lambda _: requests.get(url, timeout=10), range(6)))
+            bodies = {(r.status_code, r.text) for r in responses}
+            if bodies != {(200, "run 1\n")}:
+                raise Exception(f"Collapsed misses answered {bodies}")
+            if self._script_runs(root, "collapse") != 1:
+                raise Exception(f"Script ran {self._script_runs(root, 'collapse')} times, not once")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    # ========== CGI WORKER TESTS ==========
+
+    _PID_SCRIPT = """import os, sys, time
+query = os.environ.get("QUERY_STRING", "")
+if query == "exit":
+    os._exit(3)
+if query.startswith("sleep="):
+    time.sleep(float(query[6:]))
+sys.stdout.write("Content-Type: text/plain\\r\\n\\r\\n" + str(os.getpid()))
+"""
+
+    def _start_worker_server(self, port: int, max_requests: int
+                             ) -> Tuple[subprocess.Popen, str]:
+        """A dedicated server with one Python CGI worker for /scripts"""
+        process, root = self._start_dedicated_server(port, self._cgi_location(
+            f"\n        cgi_timeout 1s;\n        cgi_workers 1;"
+            f"\n        cgi_worker_max_requests {max_requests};"))
+        self._write_script(root, "scripts/pid.py", self._PID_SCRIPT)
+        return process, root
+
+    def _script_pid(self, port: int, query: str = "") -> int:
+        """Run pid.py and return the pid of the process that ran it"""
+        response = requests.get(f"http://127.0.0.1:{port}/scripts/pid.py?{query}", timeout=10)
+        if response.status_code != 200:
+            raise Exception(f"pid.py?{query} got {response.status_code}")
+        return int(response.text)
+
+    def _wait_for_exit(self, pid: int, seconds: float = 3.0) -> bool:
+        """Whether process pid is gone within seconds"""
+        deadline = time.time() + seconds
+        while time.time() < deadline:
+            try:
+                os.kill(pid, 0)
+            except ProcessLookupError:
+                return True
+            time.sleep(0.05)
+        return False
+
+    def test_cgi_workers_reuse_and_retire(self) -> None:
+        """Test that a worker runs request after request and is replaced
+        after cgi_worker_max_requests"""
+        port = 8186
+        process, root = self._start_worker_server(port, 3)
+        try:
+            pids = [self._script_pid(port) for _ in range(4)]
+            if len(set(pids[:3])) != 1:
+                raise Exception(f"Requests did not reuse the worker: {pids}")
+            if pids[3] == pids[0]:
+                raise Exception(f"Worker not retired after 3 requests: {pids}")
+            if not self._wait_for_exit(pids[0]):
+                raise Exception(f"Retired worker {pids[0]} still running")
+            if self._script_pid(port) != pids[3]:
+                raise Exception("Replacement worker not reused")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    def test_cgi_workers_failures(self) -> None:
+        """Test that a worker whose script exits or times out is killed and
+        replaced, and that requests finding it busy fork a process instead"""
+        port = 8186
+        process, root = self._start_worker_server(port, 1000)
+        try:
+            worker = self._script_pid(port)
+            response = requests.get(f"http://127.0.0.1:{port}/scripts/pid.py?exit", timeout=10)
+            if response.status_code == 200:
+                raise Exception("Script calling os._exit() answered 200")
+            if not self._wait_for_exit(worker):
+                raise Exception(f"Worker {worker} survived os._exit()")
+            worker = self._script_pid(port)
+
+            start = time.time()
+            response = requests.get(f"http://127.0.0.1:{port}/scripts/pid.py?sleep=3", timeout=10)
+            if response.status_code != 504 or time.time() - start > 2.5:
+                raise Exception(f"Timed-out worker script answered {response.status_code}")
+            if not self._wait_for_exit(worker):
+                raise Exception(f"Worker {worker} survived its script timing out")
+            worker = self._script_pid(port)
+
+            with ThreadPoolExecutor(max_workers=1) as pool:
+                holder = pool.submit(self._script_pid, port, "sleep=0.6")
+                time.sleep(0.2)
+                forked = self._script_pid(port)
+                if holder.result() != worker:
+                    raise Exception("Worker not used while idle")
+            if forked == worker:
+                raise Exception("Request ran on the busy worker")
+            if not self._wait_for_exit(forked):
+                raise Exception(f"Fallback process {forked} did not exit")
+            if self._script_pid(port) != worker:
+                raise Exception("Worker not reused after the fallback")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    # ========== FASTCGI TESTS ==========
+
+    _FASTCGI_LOCATIONS = """
+    location /fcgi {
+        root ./fcgi;
+        fastcgi_pass unix:{root}/fcgi.sock;
+        methods GET POST;
+        client_max_body_size 10000000;
+        cgi_timeout 1s;
+    }
+    location /down {
+        fastcgi_pass unix:{root}/missing.sock;
+    }
+"""
+
+    def _start_fastcgi(self, port: int, *backend_args: str
+                       ) -> Tuple[subprocess.Popen, subprocess.Popen, str]:
+        """A dedicated server passing /fcgi to tools/fcgi_backend.py on a
+        socket in its root, with the location's root given relative as in
+        the shipped config. Returns the server, the backend and the root;
+        the backend's output goes to backend.log there."""
+        process, root = self._start_dedicated_server(port, self._FASTCGI_LOCATIONS,
+                                                     in_root=True)
+        socket_path = os.path.join(root, "fcgi.sock")
+        with open(os.path.join(root, "backend.log"), "w") as log:
+            backend = subprocess.Popen(
+                [sys.executable, "-u", os.path.abspath("tools/fcgi_backend.py"),
+                 f"unix:{socket_path}", *backend_args],
+                stdout=log, stderr=subprocess.STDOUT)
+        for _ in range(50):
+            if os.path.exists(socket_path):
+                return process, backend, root
+            time.sleep(0.1)
+        self._stop_fastcgi(process, backend, root)
+        raise Exception("FastCGI test backend did not start")
+
+    def _stop_fastcgi(self, process: subprocess.Popen, backend: subprocess.Popen,
+                      root: str) -> None:
+        """Stop a server and backend from _start_fastcgi"""
+        backend.kill()
+        backend.wait()
+        self._stop_dedicated_server(process, root)
+
+    def _fastcgi_get(self, port: int, query: str = "", **kwargs: Any) -> Dict[str, str]:
+        """Request /fcgi/app.php (POST when data is given) and parse the
+        backend's key=value reply"""
+        method = requests.post if "data" in kwargs else requests.get
+        response = method(f"http://127.0.0.1:{port}/fcgi/app.php?{query}",
+                          timeout=10, **kwargs)
+        if response.status_code != 200:
+            raise Exception(f"FastCGI request {query!r} got {response.status_code}")
+        return dict(item.split("=", 1) for item in response.text.split())
+
+    def _count_text(self, path: str, text: str) -> int:
+        """How often text occurs in the file at path"""
+        with open(path) as f:
+            return f.read().count(text)
+
+    def _wait_for_text(self, path: str, text: str, count: int = 1,
+                       seconds: float = 3.0) -> bool:
+        """Whether text shows up count times in the file at path within
+        seconds"""
+        deadline = time.time() + seconds
+        while time.time() < deadline:
+            if self._count_text(path, text) >= count:
+                return True
+            time.sleep(0.1)
+        return False
+
+    def test_fastcgi_keepalive_and_params(self) -> None:
+        """Test that FastCGI connections are reused, that paths reach the
+        backend absolute, that bodies pass through and stderr is logged"""
+        port = 8185
+        process, backend, root = self._start_fastcgi(port)
+        try:
+            replies = [self._fastcgi_get(port, f"n={i}") for i in range(3)]
+            if len({reply["conn"] for reply in replies}) != 1:
+                raise Exception(f"Sequential requests used several connections: {replies}")
+            script = replies[0]["script"]
+            if not os.path.isabs(script):
+                raise Exception(f"SCRIPT_FILENAME sent relative: {script!r}")
+            if os.path.realpath(script) != os.path.join(os.path.realpath(root), "fcgi", "app.php"):
+                raise Exception(f"SCRIPT_FILENAME {script!r} is not the mapped file")
+
+            payload = os.urandom(1024 * 1024)
+            reply = self._fastcgi_get(port, "post=1", data=payload)
+            if (reply["method"] != "POST" or reply["body"] != str(len(payload)) or
+                    reply["content_length"] != str(len(payload)) or
+                    reply["md5"] != hashlib.md5(payload).hexdigest()):
+                raise Exception(f"Request body mangled on the way: {reply}")
+
+            self._fastcgi_get(port, "stderr=backend-warning-text")
+            if not self._wait_for_text(os.path.join(root, "webserv.log"),
+                                       "backend-warning-text"):
+                raise Exception("FastCGI stderr text not logged")
+        finally:
+            self._stop_fastcgi(process, backend, root)
+
+    def _concurrent_fastcgi(self, port: int, count: int) -> Tuple[List[Dict[str, str]], float]:
+        """Warm one connection, then send count half-second requests at once"""
+        self._fastcgi_get(port, "warm=1")
+        start = time.time()
+        with ThreadPoolExecutor(max_workers=count) as pool:
+            replies = list(pool.map(lambda i: self._fastcgi_get(port, f"sleep=0.5&i={i}"),
+                                    range(count)))
+        return replies, time.time() - start
+
+    def test_fastcgi_multiplexing(self) -> None:
+        """Test that a backend advertising FCGI_MPXS_CONNS gets concurrent
+        requests on one connection, and one that does not carries one
+        request per connection at a time"""
+        port = 8185
+        process, backend, root = self._start_fastcgi(port)
+        try:
+            replies, elapsed = self._concurrent_fastcgi(port, 3)
+            if len({reply["conn"] for reply in replies}) != 1:
+                raise Exception(f"Multiplexing backend got several connections: {replies}")
+            if len({reply["request"] for reply in replies}) != 3:
+                raise Exception("Multiplexed requests share a request id")
+            if elapsed > 1.2:
+                raise Exception(f"Multiplexed requests took {elapsed:.2f}s; not concurrent")
+        finally:
+            self._stop_fastcgi(process, backend, root)
+
+        process, backend, root = self._start_fastcgi(port, "--no-mpx")
+        try:
+            replies, elapsed = self._concurrent_fastcgi(port, 3)
+            if len({reply["conn"] for reply in replies}) != 3:
+                raise Exception(f"Non-multiplexing backend got requests sharing a "
+                                f"connection: {replies}")
+            if self._fastcgi_get(port, "after=1")["conn"] not in {r["conn"] for r in replies}:
+                raise Exception("Idle connection to a non-multiplexing backend not reused")
+        finally:
+            self._stop_fastcgi(process, backend, root)
+
+    def test_fastcgi_failures(self) -> None:
+        """Test 502 for an unreachable backend, 504 past cgi_timeout, and
+        FCGI_ABORT_REQUEST for requests that are cancelled"""
+        port = 8185
+        process, backend, root = self._start_fastcgi(port)
+        try:
+            response = requests.get(f"http://127.0.0.1:{port}/down/app.php", timeout=5)
+            if response.status_code != 502:
+                raise Exception(f"Unreachable backend answered {response.status_code}")
+
+            self._fastcgi_get(port, "warm=1")  # the connection learns to multiplex
+            backend_log = os.path.join(root, "backend.log")
+            start = time.time()
+            response = requests.get(f"http://127.0.0.1:{port}/fcgi/app.php?sleep=3",
+                                    timeout=10)
+            elapsed = time.time() - start
+            if response.status_code != 504 or not 0.8 <= elapsed <= 2.5:
+                raise Exception(f"cgi_timeout 1s: {response.status_code} after {elapsed:.2f}s")
+            if not self._wait_for_text(backend_log, "aborted request"):
+                raise Exception("Timed-out request not aborted on the backend")
+
+            sock = socket.create_connection(("127.0.0.1", port), timeout=5)
+            sock.sendall(b"GET /fcgi/app.php?sleep=0.8 HTTP/1.1\r\nHost: localhost\r\n\r\n")
+            time.sleep(0.3)
+            sock.close()
+            if not self._wait_for_text(backend_log, "aborted request", count=2):
+                raise Exception("Client hangup did not abort the FastCGI request")
+
+            if self._fastcgi_get(port, "after=1")["method"] != "GET":
+                raise Exception("Backend connection unusable after the aborts")
+        finally:
+            self._stop_fastcgi(process, backend, root)
+
+    # ========== STATIC FILE CACHE TESTS ==========
+
+    def _write_file(self, root: str, name: str, content: bytes) -> None:
+        """Write a file below a dedicated server's root"""
+        path = os.path.join(root, name)
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        with open(path, "wb") as f:
+            f.write(content)
+
+    def test_file_cache_revalidation(self) -> None:
+        """Test that a cached file changed on disk is served fresh once
+        file_cache_valid has passed"""
+        port = 8188
+        process, root = self._start_dedicated_server(
+            port, "\n    location / {\n        methods GET;\n    }\n",
+            "file_cache_valid 500ms;\nopen_file_cache_valid 500ms;")
+        try:
+            url = f"http://127.0.0.1:{port}/page.txt"
+            self._write_file(root, "page.txt", b"old contents\n")
+            for _ in range(2):
+                response = requests.get(url, timeout=5)
+                if response.status_code != 200 or response.content != b"old contents\n":
+                    raise Exception(f"Initial GET: {response.status_code} {response.content!r}")
+
+            fresh = b"new and longer contents\n"
+            self._write_file(root, "page.txt", fresh)
+            time.sleep(1.0)
+            response = requests.get(url, timeout=5)
+            if response.status_code != 200 or response.content != fresh:
+                raise Exception(f"Changed file served stale: {response.content!r}")
+            if response.headers.get("Content-Length") != str(len(fresh)):
+                raise Exception(f"Stale Content-Length {response.headers.get('Content-Length')}")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    def test_mmap_file_byte_exact(self) -> None:
+        """Test that a cached file above the mmap threshold (64k) is served
+        byte-exact, alone and to concurrent clients"""
+        port = 8188
+        process, root = self._start_dedicated_server(
+            port, "\n    location / {\n        methods GET;\n    }\n")
+        try:
+            content = random.Random(28).randbytes(300 * 1024)
+            self._write_file(root, "mapped.bin", content)
+            url = f"http://127.0.0.1:{port}/mapped.bin"
+            responses = [requests.get(url, timeout=5)]
+            with ThreadPoolExecutor(max_workers=4) as pool:
+                responses += list(pool.map(lambda _: requests.get(url, timeout=5), range(4)))
+            for response in responses:
+                if response.status_code != 200 or response.content != content:
+                    raise Exception(f"{response.status_code}: {len(response.content)} bytes, "
+                                    f"md5 {hashlib.md5(response.content).hexdigest()}")
+                if response.headers.get("Content-Length") != str(len(content)):
+                    raise Exception(f"Content-Length {response.headers.get('Content-Length')}")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    def test_sendfile_download(self) -> None:
+        """Test that a file over the cache's entry cap goes out whole with
+        the right Content-Length, also to a client that reads slowly"""
+        port = 8188
+        process, root = self._start_dedicated_server(
+            port, "\n    location / {\n        methods GET;\n    }\n",
+            "file_cache_max_entry_size 1m;")
+        try:
+            content = random.Random(30).randbytes(5 * 1024 * 1024 + 123)
+            self._write_file(root, "large.bin", content)
+            response = requests.get(f"http://127.0.0.1:{port}/large.bin", timeout=15)
+            if response.headers.get("Content-Length") != str(len(content)):
+                raise Exception(f"Content-Length {response.headers.get('Content-Length')}")
+            if response.status_code != 200 or response.content != content:
+                raise Exception(f"{response.status_code}: {len(response.content)} of "
+                                f"{len(content)} bytes")
+
+            sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+            sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 65536)
+            sock.settimeout(15)
+            sock.connect(("127.0.0.1", port))
+            sock.sendall(b"GET /large.bin HTTP/1.0\r\nHost: localhost\r\n\r\n")
+            head, body = self._read_response_head(sock)
+            time.sleep(0.5)  # let the server hit a full socket buffer
+            while True:
+                more = sock.recv(1 << 20)
+                if not more:
+                    break
+                body += more
+            sock.close()
+            if body != content:
+                raise Exception(f"Slow reader got {len(body)} of {len(content)} bytes")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    def test_cache_warmup(self) -> None:
+        """Test that with warmup on a file is served from the file cache on
+        its very first request"""
+        port = 8188
+        content = b"preloaded at startup\n"
+        process, root = self._start_dedicated_server(
+            port, self._STATUS_LOCATIONS, "warmup on;\nwarmup_background off;",
+            files={"warm/page.txt": content})
+        try:
+            before = self._status_json(port)["caches"]["file"]
+            response = requests.get(f"http://127.0.0.1:{port}/warm/page.txt", timeout=5)
+            if response.status_code != 200 or response.content != content:
+                raise Exception(f"Warmed file: {response.status_code} {response.content!r}")
+            after = self._status_json(port)["caches"]["file"]
+            if after["hits"] != before["hits"] + 1 or after["misses"] != before["misses"]:
+                raise Exception(f"First request was not a file cache hit: {before} -> {after}")
+            with open(os.path.join(root, "webserv.log")) as f:
+                if "Warm-up" not in f.read():
+                    raise Exception("No warm-up in the log")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    def test_negative_cache_forgets_uploads(self) -> None:
+        """Test that a remembered 404 is forgotten once the path is uploaded"""
+        port = 8188
+        locations = """
+    location /files {
+        root {root}/files;
+        methods GET POST;
+        upload_store {root}/files;
+        upload_enable on;
+    }
+"""
+        process, root = self._start_dedicated_server(
+            port, locations, "negative_cache_valid 60s;")
+        try:
+            os.makedirs(os.path.join(root, "files"), exist_ok=True)
+            url = f"http://127.0.0.1:{port}/files/late.txt"
+            for _ in range(2):
+                response = requests.get(url, timeout=5)
+                if response.status_code != 404:
+                    raise Exception(f"Missing file answered {response.status_code}")
+
+            body = b"uploaded after a 404\n"
+            response = requests.post(f"http://127.0.0.1:{port}/files",
+                                     files={"file": ("late.txt", body)}, timeout=5)
+            if response.status_code not in (200, 201):
+                raise Exception(f"Upload failed: {response.status_code}")
+            response = requests.get(url, timeout=5)
+            if response.status_code != 200 or response.content != body:
+                raise Exception(f"Uploaded file still missing: {response.status_code} "
+                                f"{response.content!r}")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    def _shutdown_log(self, process: subprocess.Popen, root: str) -> str:
+        """Stop a dedicated server and return its log, with the cache stats
+        it prints on the way out"""
+        process.send_signal(signal.SIGINT)
+        process.wait(timeout=5)
+        with open(os.path.join(root, "webserv.log")) as f:
+            return f.read()
+
+    def _log_stats(self, log: str, name: str) -> Dict[str, int]:
+        """The key=value counters of the last "<name> stats:" log line"""
+        lines = [line for line in log.splitlines() if f"{name} stats:" in line]
+        if not lines:
+            raise Exception(f"No {name} stats in the log")
+        fields = lines[-1].split(f"{name} stats:", 1)[1].split()
+        return {key: int(value) for key, value in (f.split("=") for f in fields)}
+
+    def test_file_cache_budget(self) -> None:
+        """Test that the file cache stays within file_cache_size by evicting,
+        and never keeps files over file_cache_max_entry_size"""
+        port = 8188
+        process, root = self._start_dedicated_server(
+            port, self._STATUS_LOCATIONS,
+            "file_cache_size 64k;\nfile_cache_max_entry_size 16k;\nresponse_cache_entries off;")
+        try:
+            files = {f"f{i}.bin": random.Random(i).randbytes(12 * 1024) for i in range(8)}
+            files["big.bin"] = random.Random(99).randbytes(32 * 1024)
+            for name, content in files.items():
+                self._write_file(root, name, content)
+
+            for _ in range(2):
+                for name in sorted(files):
+                    if name == "big.bin":
+                        continue
+                    response = requests.get(f"http://127.0.0.1:{port}/{name}", timeout=5)
+                    if response.status_code != 200 or response.content != files[name]:
+                        raise Exception(f"{name}: {response.status_code}, wrong body")
+
+            before = self._status_json(port)["caches"]["file"]
+            requests.get(f"http://127.0.0.1:{port}/f7.bin", timeout=5)
+            after = self._status_json(port)["caches"]["file"]
+            if after["hits"] != before["hits"] + 1:
+                raise Exception(f"Most recent file not served from the cache: "
+                                f"{before} -> {after}")
+
+            before = after
+            for _ in range(2):
+                response = requests.get(f"http://127.0.0.1:{port}/big.bin", timeout=5)
+                if response.status_code != 200 or response.content != files["big.bin"]:
+                    raise Exception(f"big.bin: {response.status_code}, wrong body")
+            after = self._status_json(port)["caches"]["file"]
+            if after != before:
+                raise Exception(f"File over the entry cap went through the cache: "
+                                f"{before} -> {after}")
+
+            stats = self._log_stats(self._shutdown_log(process, root), "File cache")
+            if stats["bytes"] > 64 * 1024:
+                raise Exception(f"File cache holds {stats['bytes']} bytes over a 64k budget")
+            if stats["evictions"] + stats["rejected"] == 0:
+                raise Exception(f"96k of files fit a 64k cache: {stats}")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    _STATUS_LOCATIONS = """
+    location / {
+        methods GET;
+    }
+    location = /_status {
+        stub_status on;
+        methods GET;
+    }
+"""
+
+    def _status_json(self, port: int) -> Dict[str, Any]:
+        """The server's /_status counters as JSON"""
+        response = requests.get(f"http://127.0.0.1:{port}/_status?format=json", timeout=5)
+        if response.status_code != 200:
+            raise Exception(f"/_status answered {response.status_code}")
+        return response.json()
+
+    def test_status_endpoint(self) -> None:
+        """Test that /_status counts requests and reports latency
+        percentiles, as JSON and as Prometheus text"""
+        port = 8188
+        process, root = self._start_dedicated_server(port, self._STATUS_LOCATIONS)
+        try:
+            self._write_file(root, "page.txt", b"counted\n")
+            before = self._status_json(port)
+            for _ in range(5):
+                if requests.get(f"http://127.0.0.1:{port}/page.txt", timeout=5).status_code != 200:
+                    raise Exception("Static GET failed")
+            requests.get(f"http://127.0.0.1:{port}/missing.txt", timeout=5)
+            after = self._status_json(port)
+
+            if after["requests"] < before["requests"] + 6:
+                raise Exception(f"requests went from {before['requests']} to {after['requests']}")
+            if after["responses"]["2xx"] < before["responses"]["2xx"] + 5:
+                raise Exception(f"2xx went from {before['responses']['2xx']} "
+                                f"to {after['responses']['2xx']}")
+            if after["responses"]["4xx"] < before["responses"]["4xx"] + 1:
+                raise Exception("404 not counted")
+            handler = after["latency_us"]["handler"]
+            for field in ("count", "p50", "p90", "p99", "p999", "max"):
+                if field not in handler:
+                    raise Exception(f"handler latency lacks {field}: {handler}")
+            if handler["count"] < 6 or handler["p50"] > handler["p99"] or handler["p99"] > handler["max"]:
+                raise Exception(f"Implausible handler latency: {handler}")
+
+            text = requests.get(f"http://127.0.0.1:{port}/_status", timeout=5).text
+            for needle in ("webserv_requests_total ",
+                           'webserv_phase_duration_seconds_bucket{phase="handler",le="+Inf"}',
+                           'webserv_phase_duration_seconds_count{phase="handler"}'):
+                if needle not in text:
+                    raise Exception(f"Prometheus output lacks {needle}")
+
+            # le is inclusive: every sample the earlier snapshot saw at or
+            # below a percentile or the max, which often sit right on a
+            # power-of-two boundary, is in the bucket whose le covers it.
+            buckets: Dict[str, Dict[int, int]] = {}
+            for match in re.finditer(r'webserv_phase_duration_seconds_bucket\{phase="(\w+)",'
+                                     r'le="([0-9.e+-]+)"\} (\d+)', text):
+                micros = round(float(match.group(2)) * 1e6)
+                buckets.setdefault(match.group(1), {})[micros] = int(match.group(3))
+            for phase, latency in after["latency_us"].items():
+                rank = {"p50": 0.5, "p90": 0.9, "p99": 0.99, "max": 1.0}
+                for field, quantile in rank.items():
+                    value = latency[field]
+                    le = min((b for b in buckets[phase] if b >= value), default=None)
+                    needed = max(1, int(quantile * latency["count"])) if latency["count"] else 0
+                    if le is not None and buckets[phase][le] < needed:
+                        raise Exception(f"{phase}: {field}={value}us but only "
+                                        f"{buckets[phase][le]} samples at le={le}us")
+        finally:
+            self._stop_dedicated_server(process, root)
+
+    def test_server_timing_header(self) -> None:
+        """Test that server_timing on adds a Server-Timing header with the
+        request's phases, and that it is absent by default"""
+        port = 8188
+        for directive, expected in (("server_timing on;", True), ("", False)):
+            process, root = self._start_dedicated_server(
+                port, "\n    location / {\n        methods GET;\n    }\n", directive,
+                files={"page.txt": b"timed\n"})
+            try:
+                response = requests.get(f"http://127.0.0.1:{port}/page.txt", timeout=5)
+                if response.status_code != 200:
+                    raise Exception(f"GET failed: {response.status_code}")
+                timing = response.headers.get("Server-Timing")
+                if not expected:
+                    if timing is not None:
+                        raise Exception(f"Server-Timing sent while off: {timing!r}")
+                    continue
+                if timing is None:
+                    raise Exception("No Server-Timing header with server_timing on")
+                metrics = dict(part.strip().split(";dur=", 1) for part in timing.split(","))
+                if "total" not in metrics or any(float(v) < 0 for v in metrics.values()):
+                    raise Exception(f"Malformed Server-Timing: {timing!r}")
+            finally:
+                self._stop_dedicated_server(process, root)
+
     # ========== MAIN TEST RUNNER ==========
     
     def run_all_tests(self) -> bool:
@@ -1502,10 +3140,23 @@ print("</body></html>")
             ("CGI environment variables", self.test_cgi_environment_variables),
             ("CGI POST data handling", self.test_cgi_post_data),
             ("CGI timeout handling", self.test_cgi_timeout_handling),
+            ("CGI does not block other clients", self.test_cgi_does_not_block_others),
+            ("CGI interpreters per location and extension", self.test_cgi_location_interpreters),
+            ("CGI environment", self.test_cgi_spawn_environment),
+            ("CGI streaming: chunked framing", self.test_cgi_streaming_chunked),
+            ("CGI streaming: slow client backpressure", self.test_cgi_streaming_backpressure),
+            ("CGI streaming: client disconnect", self.test_cgi_streaming_client_disconnect),
+            ("CGI with a half-closed client", self.test_cgi_half_closed_client),
+            ("CGI streaming: output past Content-Length", self.test_cgi_streaming_overrun),
+            ("CGI streaming: lowercase framing headers", self.test_cgi_lowercase_framing_headers),
+            ("CGI stdin: Content-Length upload", self.test_cgi_stdin_content_length),
+            ("CGI stdin: chunked upload", self.test_cgi_stdin_chunked),
+            ("CGI splice: Content-Length body", self.test_cgi_splice_content_length),
+            ("CGI splice: body shorter than Content-Length", self.test_cgi_splice_short_body),
         ]
         
         for name, func in cgi_tests:
-            self.test(name, func, timeout=15)
+            self.test(name, func, timeout=30)
         
         self.log("\n⚡ PERFORMANCE & LOAD TESTS", "HEADER")
         self.log("-" * 50, "INFO")
@@ -1555,6 +3206,93 @@ print("</body></html>")
         for name, func in server_tests:
             self.test(name, func, timeout=10)
         
+        self.log("\n🧭 LOCATION MATCHING TESTS", "HEADER")
+        self.log("-" * 50, "INFO")
+        
+        routing_tests = [
+            ("Location modifiers and precedence", self.test_location_modifiers),
+            ("Response cache keyed per location", self.test_response_cache_per_location),
+        ]
+        
+        for name, func in routing_tests:
+            self.test(name, func, timeout=20)
+        
+        self.log("\n🚦 CGI LIMIT TESTS", "HEADER")
+        self.log("-" * 50, "INFO")
+        
+        cgi_limit_tests = [
+            ("CGI queue overflow sheds with 503", self.test_cgi_queue_overflow),
+            ("CGI queue timeout", self.test_cgi_queue_timeout),
+            ("Per-location CGI limit", self.test_cgi_location_limit),
+        ]
+        
+        for name, func in cgi_limit_tests:
+            self.test(name, func, timeout=30)
+        
+        self.log("\n🗄️ CGI CACHE TESTS", "HEADER")
+        self.log("-" * 50, "INFO")
+        
+        cgi_cache_tests = [
+            ("CGI cache hit and expiry", self.test_cgi_cache_hit_and_expiry),
+            ("CGI cache skips no-store and Set-Cookie", self.test_cgi_cache_uncacheable),
+            ("CGI cache honors Cookie, Authorization and no-cache", self.test_cgi_cache_request_headers),
+            ("CGI cache header case and default type", self.test_cgi_cache_header_case),
+            ("CGI cache stale-while-revalidate", self.test_cgi_cache_stale_while_revalidate),
+            ("CGI cache collapses concurrent misses", self.test_cgi_cache_collapsed_misses),
+        ]
+        
+        for name, func in cgi_cache_tests:
+            self.test(name, func, timeout=20)
+        
+        self.log("\n👷 CGI WORKER TESTS", "HEADER")
+        self.log("-" * 50, "INFO")
+        
+        cgi_worker_tests = [
+            ("CGI workers reuse and retire", self.test_cgi_workers_reuse_and_retire),
+            ("CGI workers exit, timeout and busy fallback", self.test_cgi_workers_failures),
+        ]
+        
+        for name, func in cgi_worker_tests:
+            self.test(name, func, timeout=30)
+        
+        self.log("\n🔌 FASTCGI TESTS", "HEADER")
+        self.log("-" * 50, "INFO")
+        
+        fastcgi_tests = [
+            ("FastCGI keep-alive, params, body and stderr", self.test_fastcgi_keepalive_and_params),
+            ("FastCGI multiplexing", self.test_fastcgi_multiplexing),
+            ("FastCGI failures and aborts", self.test_fastcgi_failures),
+        ]
+        
+        for name, func in fastcgi_tests:
+            self.test(name, func, timeout=30)
+        
+        self.log("\n📦 STATIC FILE CACHE TESTS", "HEADER")
+        self.log("-" * 50, "INFO")
+        
+        static_cache_tests = [
+            ("File cache revalidates changed files", self.test_file_cache_revalidation),
+            ("File cache byte budget and entry cap", self.test_file_cache_budget),
+            ("Mapped file served byte-exact", self.test_mmap_file_byte_exact),
+            ("Large file sent with sendfile", self.test_sendfile_download),
+            ("Warmed file served from the cache at once", self.test_cache_warmup),
+            ("Remembered 404 forgotten after an upload", self.test_negative_cache_forgets_uploads),
+        ]
+        
+        for name, func in static_cache_tests:
+            self.test(name, func, timeout=20)
+        
+        self.log("\n📊 METRICS TESTS", "HEADER")
+        self.log("-" * 50, "INFO")
+        
+        metrics_tests = [
+            ("Status endpoint counters and percentiles", self.test_status_endpoint),
+            ("Server-Timing header", self.test_server_timing_header),
+        ]
+        
+        for name, func in metrics_tests:
+            self.test(name, func, timeout=20)
+        
         # Generate final report
         return self._generate_final_report()
     
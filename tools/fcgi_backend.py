@@ -0,0 +1,186 @@
+#!/usr/bin/env python3
+"""Minimal FastCGI responder for testing fastcgi_pass without php-fpm.
+
+    tools/fcgi_backend.py unix:/tmp/webserv-fcgi.sock
+    tools/fcgi_backend.py 127.0.0.1:9000 --no-mpx
+
+Connections are kept open between requests (FCGI_KEEP_CONN) and, unless
+--no-mpx is given, advertise FCGI_MPXS_CONNS so that several requests share
+one connection; each request is answered from its own thread. Every
+FCGI_ABORT_REQUEST received is reported on stdout.
+
+The response describes the request. Query parameters shape it:
+    sleep=SECONDS   wait before answering
+    status=CODE     send a Status header
+    size=BYTES      append that many bytes of body, in 16 KB records
+    stderr=TEXT     write TEXT to FCGI_STDERR
+    fail=1          end with application status 1 after the header
+"""
+import hashlib
+import os
+import socket
+import socketserver
+import struct
+import sys
+import threading
+import time
+from urllib.parse import parse_qs
+
+BEGIN_REQUEST, ABORT_REQUEST, END_REQUEST, PARAMS, STDIN, STDOUT, STDERR = (
+    1, 2, 3, 4, 5, 6, 7)
+GET_VALUES, GET_VALUES_RESULT, UNKNOWN_TYPE = 9, 10, 11
+KEEP_CONN = 1
+MULTIPLEX = True
+
+
+def encode_pairs(pairs):
+    out = b""
+    for name, value in pairs:
+        for item in (name, value):
+            n = len(item)
+            out += bytes([n]) if n < 128 else struct.pack(">I", n | 0x80000000)
+        out += name + value
+    return out
+
+
+def decode_pairs(data):
+    pairs, pos = {}, 0
+    while pos < len(data):
+        lengths = []
+        for _ in range(2):
+            if data[pos] < 128:
+                lengths.append(data[pos])
+                pos += 1
+            else:
+                lengths.append(struct.unpack(">I", data[pos:pos + 4])[0]
+                               & 0x7fffffff)
+                pos += 4
+        name = data[pos:pos + lengths[0]]
+        pos += lengths[0]
+        pairs[name.decode()] = data[pos:pos + lengths[1]].decode(
+            errors="replace")
+        pos += lengths[1]
+    return pairs
+
+
+class Connection(socketserver.BaseRequestHandler):
+    def setup(self):
+        self.lock = threading.Lock()
+        self.requests = {}
+        self.aborted = set()
+
+    def send(self, kind, rid, content=b""):
+        with self.lock:
+            for pos in range(0, max(len(content), 1), 65535):
+                chunk = content[pos:pos + 65535]
+                self.request.sendall(
+                    struct.pack(">BBHHBx", 1, kind, rid, len(chunk), 0)
+                    + chunk)
+
+    def read_exact(self, n):
+        data = b""
+        while len(data) < n:
+            chunk = self.request.recv(n - len(data))
+            if not chunk:
+                raise EOFError
+            data += chunk
+        return data
+
+    def handle(self):
+        try:
+            while True:
+                _, kind, rid, length, padding = struct.unpack(
+                    ">BBHHBx", self.read_exact(8))
+                content = self.read_exact(length + padding)[:length]
+                self.record(kind, rid, content)
+        except (EOFError, ConnectionError):
+            pass
+
+    def record(self, kind, rid, content):
+        if kind == GET_VALUES:
+            values = {"FCGI_MPXS_CONNS": b"1" if MULTIPLEX else b"0",
+                      "FCGI_MAX_REQS": b"32", "FCGI_MAX_CONNS": b"64"}
+            asked = decode_pairs(content)
+            self.send(GET_VALUES_RESULT, 0, encode_pairs(
+                [(k.encode(), values[k]) for k in asked if k in values]))
+        elif kind == BEGIN_REQUEST:
+            self.requests[rid] = {"params": b"", "stdin": b""}
+        elif kind == ABORT_REQUEST:
+            self.aborted.add(rid)
+            print("aborted request %d conn=%x" % (rid, id(self)), flush=True)
+        elif kind == PARAMS and rid in self.requests:
+            self.requests[rid]["params"] += content
+        elif kind == STDIN and rid in self.requests:
+            if content:
+                self.requests[rid]["stdin"] += content
+            else:
+                state = self.requests.pop(rid)
+                threading.Thread(target=self.respond,
+                                 args=(rid, state), daemon=True).start()
+        elif kind not in (PARAMS, STDIN):
+            self.send(UNKNOWN_TYPE, 0, bytes([kind]) + b"\0" * 7)
+
+    def respond(self, rid, state):
+        params = decode_pairs(state["params"])
+        query = {k: v[0] for k, v in
+                 parse_qs(params.get("QUERY_STRING", "")).items()}
+        body = state["stdin"]
+        time.sleep(float(query.get("sleep", 0)))
+        if rid in self.aborted:
+            self.aborted.discard(rid)
+            self.send(END_REQUEST, rid, struct.pack(">IB3x", 1, 0))
+            return
+        if "stderr" in query:
+            self.send(STDERR, rid, query["stderr"].encode() + b"\n")
+        head = "Content-Type: text/plain\r\n"
+        if "status" in query:
+            head += "Status: %s\r\n" % query["status"]
+        text = ("method=%s script=%s query=%s content_length=%s "
+                "body=%d md5=%s request=%d conn=%x pid=%d\n" % (
+                    params.get("REQUEST_METHOD"),
+                    params.get("SCRIPT_FILENAME"),
+                    params.get("QUERY_STRING"),
+                    params.get("CONTENT_LENGTH"), len(body),
+                    hashlib.md5(body).hexdigest(), rid, id(self),
+                    os.getpid()))
+        self.send(STDOUT, rid, (head + "\r\n" + text).encode())
+        for remaining in range(int(query.get("size", 0)), 0, -16384):
+            self.send(STDOUT, rid, b"x" * min(16384, remaining))
+        self.send(STDOUT, rid)
+        status = 1 if query.get("fail") == "1" else 0
+        self.send(END_REQUEST, rid, struct.pack(">IB3x", status, 0))
+
+
+class UnixServer(socketserver.ThreadingMixIn, socketserver.UnixStreamServer):
+    daemon_threads = True
+
+
+class TCPServer(socketserver.ThreadingMixIn, socketserver.TCPServer):
+    daemon_threads = True
+    allow_reuse_address = True
+
+
+def main():
+    global MULTIPLEX
+    args = [a for a in sys.argv[1:] if not a.startswith("--")]
+    MULTIPLEX = "--no-mpx" not in sys.argv
+    address = args[0] if args else "unix:/tmp/webserv-fcgi.sock"
+    if address.startswith("unix:"):
+        path = address[5:]
+        if os.path.exists(path):
+            os.unlink(path)
+        server = UnixServer(path, Connection)
+    else:
+        host, port = address.rsplit(":", 1)
+        server = TCPServer((host, int(port)), Connection)
+    print("FastCGI test backend on %s (%s)" % (
+        address, "multiplexed" if MULTIPLEX else "one request per connection"),
+        flush=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,164 @@
+// webserv-logcat: decodes the binary access log written by webserv.
+//
+//   webserv-logcat [--json] [file...]
+//
+// Reads standard input when no file is given. Text output has one request
+// per line; --json, anywhere on the command line, prints one JSON object per
+// line instead. Unknown options print the usage and exit with status 2.
+#include "HTTP/core/HTTPTypes.hpp"
+#include "server/AccessLogFormat.hpp"
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static std::string formatTime(int64_t timeUs) {
+  std::time_t seconds = static_cast<std::time_t>(timeUs / 1000000);
+  struct tm utc;
+  gmtime_r(&seconds, &utc);
+  char buffer[64];
+  size_t length =
+      std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &utc);
+  std::snprintf(buffer + length, sizeof(buffer) - length, ".%06dZ",
+                static_cast<int>(timeUs % 1000000));
+  return buffer;
+}
+
+static std::string formatClient(const AccessLogFormat::Record &record) {
+  std::ostringstream out;
+  out << static_cast<int>(record.clientAddr[0]) << '.'
+      << static_cast<int>(record.clientAddr[1]) << '.'
+      << static_cast<int>(record.clientAddr[2]) << '.'
+      << static_cast<int>(record.clientAddr[3]) << ':' << record.clientPort;
+  return out.str();
+}
+
+static std::string jsonEscape(std::string_view text) {
+  std::string out;
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out += escaped;
+    } else
+      out += c;
+  }
+  return out;
+}
+
+static void printRecord(const AccessLogFormat::Record &record,
+                        uint32_t sampleRate, bool json) {
+  std::string method =
+      HTTP::methodToString(static_cast<HTTP::Method>(record.method));
+  if (json) {
+    std::cout << "{\"time\":\"" << formatTime(record.timeUs)
+              << "\",\"client\":\"" << formatClient(record)
+              << "\",\"server_port\":" << record.serverPort
+              << ",\"method\":\"" << method << "\",\"target\":\""
+              << jsonEscape(record.target) << "\",\"status\":"
+              << record.status << ",\"bytes\":" << record.bytes
+              << ",\"parse_us\":" << record.parseUs
+              << ",\"handle_us\":" << record.handleUs
+              << ",\"send_us\":" << record.sendUs
+              << ",\"sample_rate\":" << sampleRate << "}\n";
+    return;
+  }
+  std::cout << formatTime(record.timeUs) << ' ' << formatClient(record)
+            << " :" << record.serverPort << ' ' << method << ' '
+            << record.target << ' ' << record.status << ' ' << record.bytes
+            << " parse=" << record.parseUs << "us handle=" << record.handleUs
+            << "us send=" << record.sendUs << "us\n";
+}
+
+static bool decode(const std::string &data, const std::string &name,
+                   bool json) {
+  uint32_t sampleRate = 1;
+  size_t offset = 0;
+  while (offset < data.size()) {
+    uint8_t type = static_cast<uint8_t>(data[offset]);
+    const char *block = data.data() + offset;
+    size_t remaining = data.size() - offset;
+    if (type == AccessLogFormat::HEADER_TYPE &&
+        remaining >= AccessLogFormat::HEADER_SIZE &&
+        std::string_view(block + 8, 4) ==
+            std::string_view(AccessLogFormat::MAGIC, 4)) {
+      if (static_cast<uint8_t>(block[1]) != AccessLogFormat::VERSION) {
+        std::cerr << name << ": unsupported version "
+                  << static_cast<int>(block[1]) << '\n';
+        return false;
+      }
+      sampleRate = AccessLogFormat::get<uint32_t>(block + 4);
+      offset += AccessLogFormat::HEADER_SIZE;
+      continue;
+    }
+    AccessLogFormat::Record record;
+    size_t used = type == AccessLogFormat::RECORD_TYPE
+                      ? AccessLogFormat::readRecord(block, remaining, record)
+                      : 0;
+    if (used == 0) {
+      std::cerr << name << ": corrupt or truncated record at offset "
+                << offset << '\n';
+      return false;
+    }
+    printRecord(record, sampleRate, json);
+    offset += used;
+  }
+  return true;
+}
+
+static void usage(std::ostream &out) {
+  out << "usage: webserv-logcat [--json] [file...]\n"
+         "Decodes webserv binary access logs, from standard input if no\n"
+         "file is given.\n"
+         "  --json      one JSON object per request instead of text\n"
+         "  -h, --help  show this help\n";
+}
+
+int main(int argc, char *argv[]) {
+  bool json = false;
+  std::vector<std::string> files;
+  bool options = true;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (options && arg == "--") {
+      options = false;
+    } else if (options && arg == "--json") {
+      json = true;
+    } else if (options && (arg == "-h" || arg == "--help")) {
+      usage(std::cout);
+      return 0;
+    } else if (options && arg.size() > 1 && arg[0] == '-') {
+      std::cerr << "webserv-logcat: unknown option " << arg << "\n";
+      usage(std::cerr);
+      return 2;
+    } else {
+      files.push_back(arg);
+    }
+  }
+
+  bool ok = true;
+  if (files.empty()) {
+    std::string data((std::istreambuf_iterator<char>(std::cin)),
+                     std::istreambuf_iterator<char>());
+    return decode(data, "<stdin>", json) ? 0 : 1;
+  }
+  for (const std::string &name : files) {
+    std::ifstream file(name, std::ios::binary);
+    if (!file) {
+      std::cerr << name << ": cannot open\n";
+      ok = false;
+      continue;
+    }
+    std::string data((std::istreambuf_iterator<char>(file)),
+                     std::istreambuf_iterator<char>());
+    ok = decode(data, name, json) && ok;
+  }
+  return ok ? 0 : 1;
+}
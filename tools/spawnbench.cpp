@@ -0,0 +1,119 @@
+// webserv-spawnbench: how CGI launch latency grows with the server's size.
+//
+//   webserv-spawnbench [--iterations N] [--program PATH] [MB...]
+//
+// For each size the process first grows its resident memory to that many
+// megabytes (default 0 64 256 1024), then starts PROGRAM (default /bin/true)
+// N times with fork()+execve() and with posix_spawn(), the way CGIHandler
+// used to and now does, waiting for each child. fork() copies the page
+// tables of the whole process; posix_spawn() does not.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <spawn.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static char *program;
+
+static pid_t forkExec() {
+  pid_t pid = fork();
+  if (pid == 0) {
+    char *args[] = {program, nullptr};
+    char *envp[] = {nullptr};
+    execve(program, args, envp);
+    _exit(127);
+  }
+  return pid;
+}
+
+static pid_t spawn() {
+  char *args[] = {program, nullptr};
+  char *envp[] = {nullptr};
+  pid_t pid;
+  if (posix_spawn(&pid, program, nullptr, nullptr, args, envp) != 0)
+    return -1;
+  return pid;
+}
+
+// Microseconds from the call until the child has been reaped: mean and
+// median.
+static std::pair<double, double> measure(pid_t (*start)(), size_t iterations) {
+  std::vector<double> samples;
+  for (size_t i = 0; i < iterations; ++i) {
+    Clock::time_point begin = Clock::now();
+    pid_t pid = start();
+    if (pid < 0) {
+      std::perror("spawn");
+      std::exit(1);
+    }
+    waitpid(pid, nullptr, 0);
+    samples.push_back(
+        std::chrono::duration<double, std::micro>(Clock::now() - begin)
+            .count());
+  }
+  std::sort(samples.begin(), samples.end());
+  double sum = 0;
+  for (double sample : samples)
+    sum += sample;
+  return {sum / samples.size(), samples[samples.size() / 2]};
+}
+
+static long residentKb() {
+  FILE *status = std::fopen("/proc/self/status", "r");
+  if (!status)
+    return -1;
+  char line[256];
+  long kb = -1;
+  while (std::fgets(line, sizeof(line), status))
+    if (std::sscanf(line, "VmRSS: %ld kB", &kb) == 1)
+      break;
+  std::fclose(status);
+  return kb;
+}
+
+int main(int argc, char **argv) {
+  size_t iterations = 200;
+  std::string programPath = "/bin/true";
+  std::vector<size_t> sizes;
+  for (int i = 1; i < argc; ++i) {
+    if (!std::strcmp(argv[i], "--iterations") && i + 1 < argc)
+      iterations = std::strtoul(argv[++i], nullptr, 10);
+    else if (!std::strcmp(argv[i], "--program") && i + 1 < argc)
+      programPath = argv[++i];
+    else
+      sizes.push_back(std::strtoul(argv[i], nullptr, 10));
+  }
+  if (sizes.empty())
+    sizes = {0, 64, 256, 1024};
+  if (iterations == 0)
+    iterations = 1;
+  program = &programPath[0];
+
+  std::printf("%-10s %-10s %22s %22s\n", "size MB", "RSS MB",
+              "fork+exec mean/p50 us", "posix_spawn mean/p50 us");
+  std::vector<char *> blocks;
+  size_t allocated = 0;
+  for (size_t size : sizes) {
+    while (allocated < size) {
+      char *block = static_cast<char *>(std::malloc(1 << 20));
+      std::memset(block, 1, 1 << 20); // resident, not just reserved
+      blocks.push_back(block);
+      ++allocated;
+    }
+    auto forked = measure(forkExec, iterations);
+    auto spawned = measure(spawn, iterations);
+    std::printf("%-10zu %-10ld %12.0f / %-7.0f %12.0f / %-7.0f\n", size,
+                residentKb() / 1024, forked.first, forked.second,
+                spawned.first, spawned.second);
+  }
+  for (char *block : blocks)
+    std::free(block);
+  return 0;
+}